@@ -8,12 +8,26 @@
 #include "Evaluator.h"
 #include "PerformanceTest.h"
 #include "SkillTest.h"
+#include "EvaluatorBenchmark.h"
+#include "EpdBenchmark.h"
 #include "StdOutLogger.h"
 #include "../tests/Test.h"
 #include "../tests/EpdTest.h"
+#include "../tests/EpdSuiteTest.h"
+#include "../tests/EpdAnalyzerTest.h"
+#include "../tests/SkillTestTest.h"
+#include "../tests/SearchBenchmarkTest.h"
 #include "../tests/GameStateTest.h"
 #include "../tests/MinMaxAITest.h"
 #include "../tests/EvaluatorTest.h"
+#include "../tests/NnueTest.h"
+#include "../tests/TunerTest.h"
+#include "../tests/PackedPositionTest.h"
+#include "../tests/PolyglotBookTest.h"
+#include "../tests/PgnTest.h"
+#include "../tests/TablebaseTest.h"
+#include "../tests/SyzygyTest.h"
+#include "../tests/EndgamesTest.h"
 #include "../tests/ScoresTest.h"
 #include "../tests/MoveListTest.h"
 #include "../tests/TreeGeneratorTest.h"
@@ -42,7 +56,10 @@ public:
 			std::cout << "2. Performance test" << std::endl;
 			std::cout << "3. Skill test: Easy positions" << std::endl;
 			std::cout << "4. Skill test: Zugzwang positions" << std::endl;
-			std::cout << "5. Exit" << std::endl;
+			std::cout << "5. Skill test: Mate positions" << std::endl;
+			std::cout << "6. Evaluator benchmark" << std::endl;
+			std::cout << "7. EPD parse benchmark" << std::endl;
+			std::cout << "8. Exit" << std::endl;
 			std::cout << "> ";
 
 			int cmd;
@@ -62,6 +79,15 @@ public:
 				runSkillTest(SkillTest::ZUGZWANG);
 				break;
 			case 5:
+				runMateSkillTest();
+				break;
+			case 6:
+				runEvaluatorBenchmark();
+				break;
+			case 7:
+				runEpdBenchmark();
+				break;
+			case 8:
 				return;
 			}
 		}
@@ -73,10 +99,22 @@ private:
 	{
 		Test().run();
 		EpdTest().run();
+		EpdSuiteTest().run();
+		EpdAnalyzerTest().run();
+		SkillTestTest().run();
+		SearchBenchmarkTest().run();
 		GameStateTest().run();
 		ScoresTest().run();
 		MoveListTest().run();
 		EvaluatorTest().run();
+		NnueTest().run();
+		TunerTest().run();
+		PackedPositionTest().run();
+		PolyglotBookTest().run();
+		PgnTest().run();
+		TablebaseTest().run();
+		SyzygyTest().run();
+		EndgamesTest().run();
 		MinMaxAITest().run();
 		TreeGeneratorTest().run();
 		UtilTest().run();
@@ -89,10 +127,28 @@ private:
 		pftest();
 	}
 
+	void runEvaluatorBenchmark()
+	{
+		EvaluatorBenchmark benchmark(mStdOutLogger, 2.0);
+		benchmark();
+	}
+
+	void runEpdBenchmark()
+	{
+		EpdBenchmark benchmark(mStdOutLogger);
+		benchmark();
+	}
+
 	void runSkillTest(const SkillTest& skillTest)
 	{
-		MinMaxAI ai;
-		skillTest.run(ai, TimeConstraint(10), mStdOutLogger);
+		skillTest.run(TimeConstraint(10), mStdOutLogger);
+	}
+
+	void runMateSkillTest()
+	{
+		TimeConstraint tc;
+		tc.mate = 5;
+		SkillTest::MATE.run(tc, mStdOutLogger);
 	}
 };
 
@@ -4,6 +4,7 @@
 #include "Piece.h"
 #include "Sqr.h"
 #include "Mask.h"
+#include "Intrinsics.h"
 #include <sstream>
 #include <cstdint>
 #include <string>
@@ -31,6 +32,8 @@ public:
 	BitBoard(const std::string& epd, size_t* idx = nullptr)
 	: BitBoard()
 	{
+		// Piece symbols in piece order, white before black.
+		const char* symbols = "KQRBNPkqrbnp";
 		unsigned i = idx ? *idx : 0;
 		for (unsigned row = 0, col = 0; row < 7 || col < 8; ++i) {
 			if (i >= epd.size())
@@ -42,12 +45,9 @@ public:
 					throw std::invalid_argument("Invalid position description.");
 				++row;
 				col = 0;
-			} else if (isalpha(epd[i])) {
-				Piece piece(epd.substr(i, 1));
-				if (!piece)
-					throw std::invalid_argument("Invalid position description.");
-				Player player(!!islower(epd[i]));
-				addPiece(player, piece, Sqr(row, col));
+			} else if (epd[i] && std::strchr(symbols, epd[i])) {
+				unsigned n = std::strchr(symbols, epd[i]) - symbols;
+				addPiece(Player(n >= Piece::COUNT), Piece(n % Piece::COUNT), Sqr(row, col));
 				++col;
 			} else {
 				throw std::invalid_argument("Invalid position description.");
@@ -142,6 +142,31 @@ public:
 		return Piece::NONE;
 	}
 
+	/* Piece counts of both players, 4 bits for each player and piece type. */
+	uint64_t materialKey() const
+	{
+		uint64_t key = 0;
+		for (unsigned player = 0; player < Player::COUNT; ++player) {
+			for (unsigned piece = 0; piece < Piece::COUNT; ++piece) {
+				key += bitCount((uint64_t) (*this)(Player(player), Piece(piece)))
+						* materialKeyUnit(Player(player), Piece(piece));
+			}
+		}
+		return key;
+	}
+
+	/* Change of the material key when a piece is added. */
+	static uint64_t materialKeyUnit(Player player, Piece piece)
+	{
+		return 1ull << 4 * (player * Piece::COUNT + piece);
+	}
+
+	/* Number of pieces in the material key. */
+	static unsigned pieceCount(uint64_t materialKey, Player player, Piece piece)
+	{
+		return (materialKey >> 4 * (player * Piece::COUNT + piece)) & 0xf;
+	}
+
 	Player getPlayer(Sqr sqr) const
 	{
 		assert(sqr);
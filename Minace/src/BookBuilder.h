@@ -0,0 +1,188 @@
+#pragma once
+
+#include "Pgn.h"
+#include "PolyglotBook.h"
+#include "GameState.h"
+#include "Logger.h"
+#include "Util.h"
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <ostream>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+
+namespace mnc {
+
+/**
+ * Builds a Polyglot opening book from PGN files. The files are processed in parallel threads, each
+ * game read one at a time, and the statistics of each (position, move) pair are collected in a
+ * hash map per thread. The maps are merged when all files are done.
+ *
+ * The weight of a move is 2 * wins + draws from the point of view of the player making the move,
+ * scaled down if needed to fit in 16 bits.
+ */
+class BookBuilder
+{
+private:
+
+	struct Key
+	{
+		uint64_t key;
+
+		uint16_t move;
+
+		bool operator==(const Key& rhs) const
+		{
+			return key == rhs.key && move == rhs.move;
+		}
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key& k) const
+		{
+			return k.key ^ (k.move * 0x9e3779b97f4a7c15ull);
+		}
+	};
+
+	struct Stats
+	{
+		uint32_t games = 0, wins = 0, draws = 0;
+	};
+
+	typedef std::unordered_map<Key, Stats, KeyHash> StatsMap;
+
+	Logger& mLogger;
+
+	unsigned mMaxPly, mMinGames, mThreadCount;
+
+public:
+
+	/* Moves after maxPly plies and moves played in fewer than minGames games are not included. */
+	BookBuilder(Logger& logger, unsigned maxPly = 30, unsigned minGames = 1,
+			unsigned threadCount = std::thread::hardware_concurrency())
+	: mLogger(logger), mMaxPly(maxPly), mMinGames(std::max(1u, minGames)),
+	mThreadCount(std::max(1u, threadCount))
+	{
+	}
+
+	void build(const std::vector<std::string>& pgnFiles, std::ostream& os)
+	{
+		std::vector<StatsMap> maps(mThreadCount);
+		std::vector<uint64_t> gameCounts(mThreadCount), errorCounts(mThreadCount);
+		std::atomic<size_t> nextFile(0);
+		std::vector<std::thread> threads;
+		for (unsigned t = 0; t < mThreadCount; ++t) {
+			threads.emplace_back([&, t] {
+				for (size_t i; (i = nextFile++) < pgnFiles.size();) {
+					std::ifstream ifs(pgnFiles[i]);
+					if (!ifs)
+						++errorCounts[t];
+					PgnReader reader(ifs, mMaxPly);
+					addGames(reader, maps[t], gameCounts[t], errorCounts[t]);
+				}
+			});
+		}
+		for (std::thread& th : threads)
+			th.join();
+
+		// Merge into the first map.
+		for (unsigned t = 1; t < mThreadCount; ++t) {
+			for (const auto& kv : maps[t]) {
+				Stats& s = maps[0][kv.first];
+				s.games += kv.second.games;
+				s.wins += kv.second.wins;
+				s.draws += kv.second.draws;
+			}
+			StatsMap().swap(maps[t]);
+		}
+
+		std::vector<PolyglotBook::Entry> entries = createEntries(maps[0]);
+		PolyglotBook::write(os, entries);
+
+		uint64_t games = 0, errors = 0;
+		for (unsigned t = 0; t < mThreadCount; ++t) {
+			games += gameCounts[t];
+			errors += errorCounts[t];
+		}
+		mLogger.logMessage(strFormat(200, "Read %llu games (%llu errors). Book has %zu entries.",
+				(unsigned long long) games, (unsigned long long) errors, entries.size()));
+	}
+
+private:
+
+	void addGames(PgnReader& reader, StatsMap& map, uint64_t& gameCount, uint64_t& errorCount)
+	{
+		PgnGame game;
+		for (;;) {
+			try {
+				if (!reader.next(game))
+					break;
+			} catch (const std::invalid_argument&) {
+				++errorCount;
+				continue;
+			}
+			++gameCount;
+			if (game.result == "*")
+				continue;
+			Player winner = game.result == "1-0" ? Player::WHITE
+					: game.result == "0-1" ? Player::BLACK : Player::NONE;
+
+			GameState state = game.startState;
+			size_t plies = std::min<size_t>(game.moves.size(), mMaxPly);
+			for (size_t i = 0; i < plies; ++i) {
+				Move move = game.moves[i];
+				Stats& s = map[Key{PolyglotBook::key(state), PolyglotBook::encodeMove(move)}];
+				++s.games;
+				s.wins += winner == state.activePlayer();
+				s.draws += winner == Player::NONE;
+				state.makeMove(move);
+			}
+		}
+	}
+
+	std::vector<PolyglotBook::Entry> createEntries(const StatsMap& map) const
+	{
+		std::vector<PolyglotBook::Entry> entries;
+		std::vector<uint32_t> weights;
+		for (const auto& kv : map) {
+			uint32_t weight = 2 * kv.second.wins + kv.second.draws;
+			if (kv.second.games >= mMinGames && weight > 0) {
+				entries.push_back(PolyglotBook::Entry{kv.first.key, kv.first.move, 0, 0});
+				weights.push_back(weight);
+			}
+		}
+
+		// Sort by key and then by weight (descending).
+		std::vector<size_t> order(entries.size());
+		for (size_t i = 0; i < order.size(); ++i)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [&entries, &weights](size_t a, size_t b) {
+			return entries[a].key != entries[b].key ? entries[a].key < entries[b].key
+					: weights[a] > weights[b];
+		});
+
+		// Scale the weights of each position to 16 bits.
+		std::vector<PolyglotBook::Entry> sorted(entries.size());
+		for (size_t begin = 0, end; begin < order.size(); begin = end) {
+			uint64_t key = entries[order[begin]].key;
+			uint32_t maxWeight = weights[order[begin]];
+			for (end = begin; end < order.size() && entries[order[end]].key == key; ++end)
+				;
+			for (size_t i = begin; i < end; ++i) {
+				sorted[i] = entries[order[i]];
+				uint64_t weight = weights[order[i]];
+				if (maxWeight > UINT16_MAX)
+					weight = std::max<uint64_t>(1, weight * UINT16_MAX / maxWeight);
+				sorted[i].weight = (uint16_t) weight;
+			}
+		}
+		return sorted;
+	}
+};
+
+}
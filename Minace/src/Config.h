@@ -1,4 +1,8 @@
 #pragma once
 
 // Gather additional information/statistics about hash table etc.
-#define CM_EXTRA_INFO 0
\ No newline at end of file
+#define CM_EXTRA_INFO 0
+
+// Check after each move during search that the incrementally updated evaluation equals the
+// evaluation calculated from scratch (asserts must be enabled).
+#define CM_CHECK_EVALUATOR 0
@@ -0,0 +1,245 @@
+#pragma once
+
+#include "PackedPosition.h"
+#include "MinMaxAI.h"
+#include "GameGenerator.h"
+#include "GameState.h"
+#include "TimeConstraint.h"
+#include "Scores.h"
+#include "Logger.h"
+#include "Intrinsics.h"
+#include "Util.h"
+#include <vector>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <cstdint>
+#include <stdexcept>
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace mnc {
+
+/**
+ * Generates training data by playing fixed-node self-play games in parallel threads. Each game
+ * starts from a random opening. Quiet positions (not in check, best move is not a capture or
+ * promotion, no mate score) are stored as PackedPosition with the search score and the game result.
+ *
+ * Each thread collects positions in its own buffer and appends it to the output file with
+ * pwrite() at an offset reserved with an atomic counter, so the threads never wait for each other.
+ */
+class DataGenerator
+{
+private:
+	static constexpr size_t BUFFER_POSITIONS = 1 << 15;
+
+	static constexpr size_t HASH_BYTES = 16 << 20;
+
+	static constexpr unsigned OPENING_PLIES = 8;
+
+	static constexpr unsigned MAX_GAME_PLY = 400;
+
+	// Games are adjudicated as won after ADJUDICATION_PLIES plies with at least this score.
+	static constexpr int ADJUDICATION_SCORE = 2000;
+
+	static constexpr unsigned ADJUDICATION_PLIES = 8;
+
+	// Games are adjudicated as drawn after DRAW_ADJUDICATION_PLIES plies with at most this score,
+	// but not before DRAW_ADJUDICATION_MIN_PLY.
+	static constexpr int DRAW_ADJUDICATION_SCORE = 10;
+
+	static constexpr unsigned DRAW_ADJUDICATION_PLIES = 20;
+
+	static constexpr unsigned DRAW_ADJUDICATION_MIN_PLY = 60;
+
+	static constexpr double PRINT_INTERVAL = 10.0;
+
+	Logger& mLogger;
+
+	int mFd;
+
+	unsigned mThreadCount;
+
+	unsigned long long mNodes;
+
+	uint64_t mSeed;
+
+	std::atomic<uint64_t> mPositionCount, mGameCount, mFileOffset;
+
+	std::atomic<bool> mWriteFailed;
+
+	uint64_t mTargetCount;
+
+public:
+
+	DataGenerator(Logger& logger, const std::string& outputFile, unsigned long long nodes = 5000,
+			unsigned threadCount = std::thread::hardware_concurrency(), uint64_t seed = 0)
+	: mLogger(logger), mThreadCount(std::max(1u, threadCount)), mNodes(nodes), mSeed(seed),
+	mPositionCount(0), mGameCount(0), mFileOffset(0), mWriteFailed(false), mTargetCount(0)
+	{
+		mFd = open(outputFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (mFd < 0)
+			throw std::runtime_error("Cannot open " + outputFile + ".");
+	}
+
+	~DataGenerator()
+	{
+		close(mFd);
+	}
+
+	DataGenerator(const DataGenerator&) = delete;
+
+	DataGenerator& operator=(const DataGenerator&) = delete;
+
+	/* Plays games until at least given number of positions have been written. Throws
+	 * std::runtime_error if writing the output file fails. */
+	void run(uint64_t positionCount)
+	{
+		mLogger.logMessage(strFormat(200, "Generating %llu positions with %u threads, %llu nodes "
+				"per move, seed %llu...", (unsigned long long) positionCount, mThreadCount, mNodes,
+				(unsigned long long) mSeed));
+		mTargetCount = positionCount;
+		auto start = std::chrono::high_resolution_clock::now();
+
+		std::vector<std::thread> threads;
+		std::atomic<unsigned> running(mThreadCount);
+		for (unsigned t = 0; t < mThreadCount; ++t) {
+			threads.emplace_back([this, t, &running] {
+				play(mSeed * mThreadCount + t);
+				--running;
+			});
+		}
+
+		double lastPrint = 0;
+		while (running) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			double t = elapsed(start);
+			if (t - lastPrint >= PRINT_INTERVAL) {
+				lastPrint = t;
+				printStats(t);
+			}
+		}
+		for (std::thread& th : threads)
+			th.join();
+		if (mWriteFailed)
+			throw std::runtime_error("Failed to write training data.");
+
+		printStats(elapsed(start));
+		mLogger.logMessage("Done.");
+	}
+
+private:
+
+	void play(uint64_t seed)
+	{
+		std::mt19937_64 rng(seed);
+		MinMaxAI ai(nullptr, HASH_BYTES);
+		TimeConstraint tc(0u, 0.0, mNodes);
+		std::vector<PackedPosition> buffer, game;
+		buffer.reserve(BUFFER_POSITIONS);
+
+		while (mPositionCount < mTargetCount && !mWriteFailed) {
+			GameState state = GameGenerator::createOpening(OPENING_PLIES, rng);
+			unsigned result = playGame(ai, tc, state, game);
+			for (PackedPosition& p : game) {
+				p.result = result;
+				buffer.push_back(p);
+			}
+			++mGameCount;
+			mPositionCount += game.size();
+			if (buffer.size() >= BUFFER_POSITIONS) {
+				if (!write(buffer))
+					return;
+				buffer.clear();
+			}
+		}
+		write(buffer);
+	}
+
+	/* Plays the game to the end and returns the result (see PackedPosition). */
+	unsigned playGame(MinMaxAI& ai, const TimeConstraint& tc, GameState& state,
+			std::vector<PackedPosition>& positions)
+	{
+		positions.clear();
+		unsigned adjudicationPlies = 0, drawPlies = 0;
+		int prevWhiteScore = 0;
+		for (;;) {
+			if (state.isCheckMate())
+				return state.activePlayer() == Player::WHITE ? 0 : 2;
+			// The search scores the first repetition as a draw, so the game is ended there too.
+			if (state.isStaleMate() || state.isRepeatedState() || state.halfMoveClock() >= 100
+					|| state.ply() >= MAX_GAME_PLY || bitCount((uint64_t) state.board()()) == 2)
+				return 1;
+
+			Move move = ai.getMove(state, tc);
+			int score = ai.getScore();
+			bool quiet = !move.isCapture() && !move.isPromotion()
+					&& !state.isKingChecked(state.activePlayer());
+			if (quiet && std::abs(score) < Scores::CHECK_MATE_THRESHOLD)
+				positions.push_back(PackedPosition::pack(state, score, 1));
+
+			// Adjudicate when one side has been clearly winning for several plies.
+			int whiteScore = state.activePlayer() == Player::WHITE ? score : -score;
+			if (std::abs(whiteScore) < ADJUDICATION_SCORE)
+				adjudicationPlies = 0;
+			else if (adjudicationPlies && (whiteScore > 0) != (prevWhiteScore > 0))
+				adjudicationPlies = 1;
+			else
+				++adjudicationPlies;
+			prevWhiteScore = whiteScore;
+			if (adjudicationPlies >= ADJUDICATION_PLIES)
+				return whiteScore > 0 ? 2 : 0;
+
+			// Adjudicate as drawn when the score has stayed near zero.
+			drawPlies = std::abs(score) <= DRAW_ADJUDICATION_SCORE ? drawPlies + 1 : 0;
+			if (drawPlies >= DRAW_ADJUDICATION_PLIES && state.ply() >= DRAW_ADJUDICATION_MIN_PLY)
+				return 1;
+
+			state.makeMove(move);
+		}
+	}
+
+	/* Writes the positions at a reserved file offset. Exceptions can't be thrown in the worker
+	 * threads, so a failure is recorded in mWriteFailed and reported by run(). */
+	bool write(const std::vector<PackedPosition>& positions)
+	{
+		size_t bytes = positions.size() * sizeof (PackedPosition);
+		off_t offset = mFileOffset.fetch_add(bytes);
+		const char* data = (const char*) positions.data();
+		while (bytes > 0) {
+			ssize_t n = pwrite(mFd, data, bytes, offset);
+			if (n < 0) {
+				mWriteFailed = true;
+				return false;
+			}
+			data += n;
+			offset += n;
+			bytes -= n;
+		}
+		return true;
+	}
+
+	void printStats(double time)
+	{
+		uint64_t positions = mPositionCount;
+		mLogger.logMessage(strFormat(200, "games=%llu positions=%llu time=%.1fs positions/s=%.0f "
+				"positions/s/thread=%.0f", (unsigned long long) mGameCount.load(),
+				(unsigned long long) positions, time, positions / time,
+				positions / time / mThreadCount));
+	}
+
+	static double elapsed(std::chrono::high_resolution_clock::time_point start)
+	{
+		auto dur = std::chrono::high_resolution_clock::now() - start;
+		return std::chrono::duration_cast<std::chrono::microseconds>(dur).count() * 1e-6;
+	}
+};
+
+}
+
+#endif
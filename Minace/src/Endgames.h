@@ -0,0 +1,413 @@
+#pragma once
+
+#include "BitBoard.h"
+#include "Scores.h"
+#include "Player.h"
+#include "Piece.h"
+#include "Sqr.h"
+#include "Intrinsics.h"
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+
+namespace mnc {
+
+/**
+ * Specialized evaluation of endgames that the piece-square evaluation misjudges. The evaluation
+ * function is selected by the material key of the position (see BitBoard::materialKey()).
+ *
+ * King and pawn against king is evaluated with a bitbase that is generated at startup by
+ * retrograde analysis: positions are classified by their successors until nothing changes, and
+ * the remaining unknown positions are draws. The bitbase has one bit (win or not) for each
+ * position with the pawn on files a-d, which is 24 KB.
+ *
+ * Scores of known draws are exact, so the search can stop in such positions. Known wins are scored
+ * above any normal evaluation (Scores::KNOWN_WIN), with a bonus for making progress towards mate.
+ */
+template<typename T>
+class Endgames_t
+{
+public:
+	// Positions with more pieces (including kings) don't have a specialized evaluation.
+	static constexpr unsigned MAX_PIECES = 5;
+
+private:
+	static constexpr unsigned KPK_SIZE = 2 * 24 * 64 * 64;
+
+	static constexpr unsigned BITS = 8 * sizeof(T);
+
+	static constexpr unsigned MAX_ENTRIES = 32;
+
+	// Results used while generating the KPK bitbase.
+	static constexpr uint8_t KPK_INVALID = 0, KPK_UNKNOWN = 1, KPK_DRAW = 2, KPK_WIN = 4;
+
+	/* Sets the score from the point of view of the strong side and whether it is exact. Returns
+	 * false if the function doesn't apply to the position. */
+	typedef bool (*Function)(const BitBoard& board, Player strong, Player activePlayer,
+			int& score, bool& exact);
+
+	struct Entry
+	{
+		uint64_t key;
+
+		Function function;
+
+		unsigned strong;
+	};
+
+	// Wins for the strong side by the side to move (0 = strong side), pawn square and king
+	// squares. Squares are relative to the strong side (rank * 8 + file, first rank is 0).
+	static T KPK[KPK_SIZE / BITS];
+
+	// Plain array instead of a map, because static members have no initialization order.
+	static Entry sEntries[MAX_ENTRIES];
+
+	static unsigned sEntryCount;
+
+	static Endgames_t sInit;
+
+	Endgames_t()
+	{
+		generateKpk();
+
+		add("KvK", evaluateDraw);
+		add("KNvK", evaluateDraw);
+		add("KBvK", evaluateDraw);
+		add("KNNvK", evaluateKnnk);
+		add("KPvK", evaluateKpk);
+		add("KQvK", evaluateKxk);
+		add("KRvK", evaluateKxk);
+		add("KBBvK", evaluateKbbk);
+		add("KBNvK", evaluateKbnk);
+		add("KBPvK", evaluateKbpk);
+		add("KBPPvK", evaluateKbpk);
+	}
+
+public:
+	// No specialized evaluation.
+	static constexpr int NONE = -1;
+
+	/* Finds the specialized evaluation for the material (see BitBoard::materialKey()). Returns
+	 * NONE if there is none. */
+	static int find(uint64_t materialKey)
+	{
+		for (unsigned i = 0; i < sEntryCount; ++i) {
+			if (sEntries[i].key == materialKey)
+				return i;
+		}
+		return NONE;
+	}
+
+	/* Evaluates the position with the function returned by find(). The score is from the point of
+	 * view of the active player, and it is exact if the result is known without search. Returns
+	 * false if the function doesn't apply to the position. */
+	static bool evaluate(int function, const BitBoard& board, Player activePlayer, int& score,
+			bool& exact)
+	{
+		const Entry& entry = sEntries[function];
+		exact = false;
+		if (!entry.function(board, Player(entry.strong), activePlayer, score, exact))
+			return false;
+		if (activePlayer != entry.strong)
+			score = -score;
+		return true;
+	}
+
+	/* Evaluates the position if there is a specialized evaluation for its material. */
+	static bool evaluate(const BitBoard& board, Player activePlayer, int& score, bool& exact)
+	{
+		if (bitCount((uint64_t) board()) > MAX_PIECES)
+			return false;
+		int function = find(board.materialKey());
+		return function != NONE && evaluate(function, board, activePlayer, score, exact);
+	}
+
+	/* Checks whether the strong side wins with king and pawn against king. */
+	static bool isKpkWin(Player strong, Sqr strongKing, Sqr pawn, Sqr weakKing,
+			Player activePlayer)
+	{
+		int sk = relativeSqr(strong, strongKing), p = relativeSqr(strong, pawn),
+				wk = relativeSqr(strong, weakKing);
+		if ((p & 7) >= 4) {
+			sk ^= 7;
+			p ^= 7;
+			wk ^= 7;
+		}
+		unsigned idx = kpkIndex(activePlayer != strong, sk, p, wk);
+		return (KPK[idx / BITS] >> (idx % BITS)) & 1;
+	}
+
+private:
+
+	/* Material key of a name like "KBNvK" with the first side as the given player. */
+	static uint64_t materialKey(const std::string& name, Player first)
+	{
+		uint64_t key = 0;
+		Player player = first;
+		for (char c : name) {
+			// Not Piece(std::string), because its symbols may not be initialized yet.
+			if (c == 'v')
+				player = ~player;
+			else
+				key += BitBoard::materialKeyUnit(player, Piece(std::string("KQRBNP").find(c)));
+		}
+		return key;
+	}
+
+	static void add(const std::string& name, Function function)
+	{
+		for (unsigned player = 0; player < Player::COUNT; ++player) {
+			uint64_t key = materialKey(name, Player(player));
+			bool found = false;
+			for (unsigned i = 0; i < sEntryCount; ++i)
+				found |= sEntries[i].key == key;
+			if (!found)
+				sEntries[sEntryCount++] = Entry{key, function, player};
+		}
+	}
+
+	/* Square from the point of view of the player: rank * 8 + file, the first rank is 0. */
+	static int relativeSqr(Player player, Sqr sqr)
+	{
+		int rank = player == Player::WHITE ? 7 - sqr.row() : sqr.row();
+		return rank * 8 + sqr.col();
+	}
+
+	static int distance(int sqr1, int sqr2)
+	{
+		return std::max(std::abs((sqr1 >> 3) - (sqr2 >> 3)), std::abs((sqr1 & 7) - (sqr2 & 7)));
+	}
+
+	static Sqr findSqr(const BitBoard& board, Player player, Piece piece)
+	{
+		return Sqr(countTrailingZeros((uint64_t) board(player, piece)));
+	}
+
+	static int material(const BitBoard& board, Player player)
+	{
+		int result = 0;
+		for (unsigned piece = Piece::QUEEN; piece < Piece::COUNT; ++piece)
+			result += bitCount((uint64_t) board(player, Piece(piece)))
+					* Scores::PIECE_VALUES[piece];
+		return result;
+	}
+
+	/* Known win with a bonus for driving the weak king to the edge and approaching it. */
+	static int knownWin(const BitBoard& board, Player strong, int edgeBonus)
+	{
+		Sqr strongKing = findSqr(board, strong, Piece::KING),
+				weakKing = findSqr(board, ~strong, Piece::KING);
+		return Scores::KNOWN_WIN + material(board, strong) + edgeBonus
+				+ 10 * (7 - distance(strongKing, weakKing));
+	}
+
+	/* Insufficient material to force a mate. */
+	static bool evaluateDraw(const BitBoard&, Player, Player, int& score, bool& exact)
+	{
+		score = Scores::DRAW;
+		exact = true;
+		return true;
+	}
+
+	/* Two knights can't force a mate, but the weak side can still walk into one. */
+	static bool evaluateKnnk(const BitBoard&, Player, Player, int& score, bool&)
+	{
+		score = Scores::DRAW;
+		return true;
+	}
+
+	static bool evaluateKpk(const BitBoard& board, Player strong, Player activePlayer,
+			int& score, bool& exact)
+	{
+		Sqr pawn = findSqr(board, strong, Piece::PAWN);
+		if (!isKpkWin(strong, findSqr(board, strong, Piece::KING), pawn,
+				findSqr(board, ~strong, Piece::KING), activePlayer)) {
+			score = Scores::DRAW;
+			exact = true;
+		} else {
+			score = Scores::KNOWN_WIN + Scores::PIECE_VALUES[Piece::PAWN]
+					+ 10 * (relativeSqr(strong, pawn) >> 3);
+		}
+		return true;
+	}
+
+	/* Mate with queen or rook: the weak king is driven to any edge. */
+	static bool evaluateKxk(const BitBoard& board, Player strong, Player, int& score, bool&)
+	{
+		int weakKing = findSqr(board, ~strong, Piece::KING);
+		int row = weakKing >> 3, col = weakKing & 7;
+		int centerDistance = std::min(row, 7 - row) + std::min(col, 7 - col);
+		score = knownWin(board, strong, 20 * (6 - centerDistance));
+		return true;
+	}
+
+	/* Bishops of the same color can't mate. */
+	static bool evaluateKbbk(const BitBoard& board, Player strong, Player activePlayer,
+			int& score, bool& exact)
+	{
+		int colors = 0;
+		for (Sqr sqr : board(strong, Piece::BISHOP))
+			colors |= 1 << ((sqr.row() + sqr.col()) & 1);
+		if (colors != 3)
+			return evaluateDraw(board, strong, activePlayer, score, exact);
+		return evaluateKxk(board, strong, activePlayer, score, exact);
+	}
+
+	/* Mate with bishop and knight: the weak king is driven to a corner of the bishop's color. */
+	static bool evaluateKbnk(const BitBoard& board, Player strong, Player, int& score, bool&)
+	{
+		Sqr bishop = findSqr(board, strong, Piece::BISHOP);
+		int weakKing = findSqr(board, ~strong, Piece::KING);
+		int row = weakKing >> 3, col = weakKing & 7;
+		// a8 and h1 are light squares, a1 and h8 dark squares.
+		int cornerDistance = (bishop.row() + bishop.col()) & 1
+				? std::min(7 - row + col, row + 7 - col) : std::min(row + col, 14 - row - col);
+		score = knownWin(board, strong, 20 * (14 - cornerDistance));
+		return true;
+	}
+
+	/* Rook pawns with a bishop that doesn't control the promotion square are drawn when the weak
+	 * king reaches the corner. Not exact, because the king might still be driven away. */
+	static bool evaluateKbpk(const BitBoard& board, Player strong, Player, int& score, bool&)
+	{
+		Mask pawns = board(strong, Piece::PAWN);
+		uint64_t fileA = 0x0101010101010101ull, fileH = fileA << 7;
+		if (((uint64_t) pawns & ~fileA) && ((uint64_t) pawns & ~fileH))
+			return false;
+		int promotionSqr = 7 * 8 + (findSqr(board, strong, Piece::PAWN).col());
+		Sqr bishop = findSqr(board, strong, Piece::BISHOP);
+		int bishopSqr = relativeSqr(strong, bishop);
+		if ((((bishopSqr >> 3) + bishopSqr) & 1) == (((promotionSqr >> 3) + promotionSqr) & 1)
+				|| distance(relativeSqr(strong, findSqr(board, ~strong, Piece::KING)),
+						promotionSqr) > 1)
+			return false;
+		score = Scores::DRAW;
+		return true;
+	}
+
+	static unsigned kpkIndex(unsigned weakToMove, int strongKing, int pawn, int weakKing)
+	{
+		return ((weakToMove * 24 + ((pawn >> 3) - 1) * 4 + (pawn & 7)) * 64 + strongKing) * 64
+				+ weakKing;
+	}
+
+	/* Calls f(sqr) for each square adjacent to the given square. */
+	template<typename F>
+	static void forEachAdjacent(int sqr, F f)
+	{
+		for (int row = std::max(0, (sqr >> 3) - 1); row <= std::min(7, (sqr >> 3) + 1); ++row) {
+			for (int col = std::max(0, (sqr & 7) - 1); col <= std::min(7, (sqr & 7) + 1); ++col) {
+				if (row * 8 + col != sqr)
+					f(row * 8 + col);
+			}
+		}
+	}
+
+	static bool pawnAttacks(int pawn, int sqr)
+	{
+		return (sqr >> 3) == (pawn >> 3) + 1 && std::abs((sqr & 7) - (pawn & 7)) == 1;
+	}
+
+	static uint8_t initialKpkResult(unsigned weakToMove, int strongKing, int pawn, int weakKing)
+	{
+		if (distance(strongKing, weakKing) <= 1 || strongKing == pawn || weakKing == pawn
+				|| (!weakToMove && pawnAttacks(pawn, weakKing)))
+			return KPK_INVALID;
+
+		int promotionSqr = pawn + 8;
+		if (!weakToMove && (pawn >> 3) == 6 && strongKing != promotionSqr
+				&& weakKing != promotionSqr && (distance(weakKing, promotionSqr) > 1
+						|| distance(strongKing, promotionSqr) == 1))
+			return KPK_WIN;
+
+		if (weakToMove) {
+			// Captures the undefended pawn.
+			if (distance(weakKing, pawn) == 1 && distance(strongKing, pawn) > 1)
+				return KPK_DRAW;
+			// Stalemate (mate is not possible with one pawn).
+			bool canMove = false;
+			forEachAdjacent(weakKing, [&](int sqr) {
+				canMove |= distance(strongKing, sqr) > 1 && !pawnAttacks(pawn, sqr);
+			});
+			if (!canMove)
+				return KPK_DRAW;
+		}
+		return KPK_UNKNOWN;
+	}
+
+	/* Combines the results of the successors: the side to move picks the best one. */
+	static uint8_t kpkResult(const std::vector<uint8_t>& results, unsigned weakToMove,
+			int strongKing, int pawn, int weakKing)
+	{
+		uint8_t result = KPK_INVALID;
+		if (weakToMove) {
+			forEachAdjacent(weakKing, [&](int sqr) {
+				result |= results[kpkIndex(0, strongKing, pawn, sqr)];
+			});
+			return result & KPK_DRAW ? KPK_DRAW : result & KPK_UNKNOWN ? KPK_UNKNOWN : KPK_WIN;
+		}
+
+		forEachAdjacent(strongKing, [&](int sqr) {
+			if (sqr != pawn)
+				result |= results[kpkIndex(1, sqr, pawn, weakKing)];
+		});
+		int push = pawn + 8;
+		if ((pawn >> 3) < 6 && push != strongKing && push != weakKing) {
+			result |= results[kpkIndex(1, strongKing, push, weakKing)];
+			push += 8;
+			if ((pawn >> 3) == 1 && push != strongKing && push != weakKing)
+				result |= results[kpkIndex(1, strongKing, push, weakKing)];
+		}
+		return result & KPK_WIN ? KPK_WIN : result & KPK_UNKNOWN ? KPK_UNKNOWN : KPK_DRAW;
+	}
+
+	/* Calls f(idx, weakToMove, strongKing, pawn, weakKing) for each bitbase index. */
+	template<typename F>
+	static void forEachKpkIndex(F f)
+	{
+		for (unsigned idx = 0; idx < KPK_SIZE; ++idx) {
+			unsigned pawnIdx = (idx >> 12) % 24;
+			f(idx, idx >> 12 >= 24, (idx >> 6) & 63, (pawnIdx / 4 + 1) * 8 + pawnIdx % 4,
+					idx & 63);
+		}
+	}
+
+	static void generateKpk()
+	{
+		std::vector<uint8_t> results(KPK_SIZE);
+		forEachKpkIndex([&results](unsigned idx, unsigned weakToMove, int strongKing, int pawn,
+				int weakKing) {
+			results[idx] = initialKpkResult(weakToMove, strongKing, pawn, weakKing);
+		});
+		for (bool changed = true; changed;) {
+			changed = false;
+			forEachKpkIndex([&results, &changed](unsigned idx, unsigned weakToMove, int strongKing,
+					int pawn, int weakKing) {
+				if (results[idx] == KPK_UNKNOWN) {
+					results[idx] = kpkResult(results, weakToMove, strongKing, pawn, weakKing);
+					changed |= results[idx] != KPK_UNKNOWN;
+				}
+			});
+		}
+		for (unsigned idx = 0; idx < KPK_SIZE; ++idx)
+			KPK[idx / BITS] |= (T) (results[idx] == KPK_WIN) << (idx % BITS);
+	}
+};
+
+template<typename T>
+T Endgames_t<T>::KPK[KPK_SIZE / BITS];
+
+template<typename T>
+typename Endgames_t<T>::Entry Endgames_t<T>::sEntries[MAX_ENTRIES];
+
+template<typename T>
+unsigned Endgames_t<T>::sEntryCount;
+
+template<typename T>
+Endgames_t<T> Endgames_t<T>::sInit;
+
+typedef Endgames_t<uint32_t> Endgames;
+
+}
@@ -4,18 +4,33 @@
 #include "Mask.h"
 #include "Sqr.h"
 #include "Player.h"
+#include "Util.h"
 #include <string>
+#include <cstdint>
+#include <cstdlib>
+#include <climits>
+#include <algorithm>
 
 namespace mnc {
 
 /**
- * Parses an Extended Position Description from string. Currently only supports the initial data
- * fields and rest of the string is ignored. Also recognizes Forsyth-Edwards Notation (FEN).
+ * Parses an Extended Position Description from string. The data fields may be followed by FEN move
+ * counters and EPD operations, e.g. "bm Nf3 e4; id \"test.001\";".
  */
 class Epd
 {
+public:
+
+	static constexpr unsigned MAX_OPERATIONS = 16;
+
 private:
 
+	/* Position of an operation in the string. The operand range covers all operands. */
+	struct Operation
+	{
+		uint32_t opcode, opcodeLength, operand, operandLength;
+	};
+
 	std::string mString;
 
 	BitBoard mBoard;
@@ -28,6 +43,12 @@ private:
 
 	unsigned mHalfMoveClock, mFullMoveNumber;
 
+	// EPD operations as offsets into mString, so parsing doesn't allocate per token. Operations
+	// beyond MAX_OPERATIONS are ignored.
+	Operation mOperations[MAX_OPERATIONS];
+
+	unsigned mOperationCount;
+
 public:
 
 	Epd(const std::string& s)
@@ -78,11 +99,63 @@ public:
 		return mFullMoveNumber;
 	}
 
+	unsigned operationCount() const
+	{
+		return mOperationCount;
+	}
+
+	StringView opcode(unsigned idx) const
+	{
+		return StringView(mString.data() + mOperations[idx].opcode, mOperations[idx].opcodeLength);
+	}
+
+	/* Operands of the operation as they appear in the string, e.g. "Nf3 e4" or "\"test.001\"". */
+	StringView operand(unsigned idx) const
+	{
+		return StringView(mString.data() + mOperations[idx].operand,
+				mOperations[idx].operandLength);
+	}
+
+	bool hasOperation(StringView opcode) const
+	{
+		return findOperation(opcode) < mOperationCount;
+	}
+
+	/* Operands of given operation without the surrounding quotes of a single string operand, or
+	 * an empty view if the operation is missing. The view is valid as long as this object. */
+	StringView operation(StringView opcode) const
+	{
+		unsigned idx = findOperation(opcode);
+		if (idx >= mOperationCount)
+			return StringView();
+		StringView r = operand(idx);
+		if (r.size() >= 2 && r[0] == '"' && r[r.size() - 1] == '"'
+				&& std::find(r.begin() + 1, r.end() - 1, '"') == r.end() - 1)
+			return StringView(r.data() + 1, r.size() - 2);
+		return r;
+	}
+
+	/* Reads an integer operand, e.g. of "acd", "ce" or "dm". Returns false if the operation is
+	 * missing or the operand isn't an integer. */
+	bool intOperation(StringView opcode, int& value) const
+	{
+		StringView op = operation(opcode);
+		if (op.empty())
+			return false;
+		// The operand is followed by a semicolon, space or the end of mString.
+		char* e;
+		long v = std::strtol(op.data(), &e, 10);
+		if (e != op.end() || v < INT_MIN || v > INT_MAX)
+			return false;
+		value = (int) v;
+		return true;
+	}
+
 private:
 
 	Epd()
 	: mString(), mBoard(), mStartingPlayer(Player::WHITE), mCastlingRights(Mask()),
-	mEnPassantSqr(Sqr::NONE), mHalfMoveClock(0), mFullMoveNumber(1)
+	mEnPassantSqr(Sqr::NONE), mHalfMoveClock(0), mFullMoveNumber(1), mOperationCount(0)
 	{
 	}
 
@@ -101,7 +174,49 @@ private:
 		// FEN
 		parseFenMoveCounters(s, idx);
 
-		//TODO parse EPD operations
+		parseOperations(s, idx);
+	}
+
+	unsigned findOperation(StringView opcode) const
+	{
+		unsigned idx = 0;
+		while (idx < mOperationCount && this->opcode(idx) != opcode)
+			++idx;
+		return idx;
+	}
+
+	/* Parses operations until the end of the string. Each operation is an opcode followed by
+	 * operands and terminated by a semicolon (or the end of the string). Semicolons in string
+	 * operands don't end the operation. */
+	void parseOperations(const std::string& s, size_t& idx)
+	{
+		for (;;) {
+			while (idx < s.size() && s[idx] == ' ')
+				++idx;
+			if (idx >= s.size())
+				break;
+			Operation op;
+			op.opcode = idx;
+			while (idx < s.size() && s[idx] != ' ' && s[idx] != ';')
+				++idx;
+			op.opcodeLength = idx - op.opcode;
+
+			while (idx < s.size() && s[idx] == ' ')
+				++idx;
+			op.operand = idx;
+			size_t end = idx;
+			for (bool quoted = false; idx < s.size() && (quoted || s[idx] != ';'); ++idx) {
+				if (s[idx] == '"')
+					quoted = !quoted;
+				if (s[idx] != ' ')
+					end = idx + 1;
+			}
+			op.operandLength = end - op.operand;
+			if (idx < s.size())
+				++idx; // Semicolon
+			if (mOperationCount < MAX_OPERATIONS)
+				mOperations[mOperationCount++] = op;
+		}
 	}
 
 	bool parseFenMoveCounters(const std::string& s, size_t& idx)
@@ -0,0 +1,196 @@
+#pragma once
+
+#include "EpdSuite.h"
+#include "MinMaxAI.h"
+#include "GameState.h"
+#include "Epd.h"
+#include "Pgn.h"
+#include "Scores.h"
+#include "Logger.h"
+#include "TimeConstraint.h"
+#include "Util.h"
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+
+namespace mnc {
+
+/**
+ * Analyzes the positions of an EPD file with a pool of threads (see EpdSuite). Results are written
+ * as JSON lines in input order as soon as all earlier positions are done. If the position has "bm"
+ * or "am" operations, the result tells whether the chosen move solves it.
+ */
+class EpdAnalyzer
+{
+	/* Collects the depth, node count and principal variation of the latest iteration. */
+	class SearchInfo : public InfoCallback
+	{
+	public:
+
+		unsigned depth = 0, selDepth = 0;
+
+		uint64_t nodes = 0;
+
+		std::vector<Move> pv;
+
+		virtual void notifyPv(unsigned multiPv, unsigned depth, unsigned selDepth, int score,
+				uint64_t nodes, double time, const std::vector<Move>& pv) override
+		{
+			this->depth = depth;
+			this->selDepth = selDepth;
+			this->nodes = nodes;
+			this->pv = pv;
+		}
+
+		virtual void notifyIterDone(unsigned depth, int score, uint64_t nodes, size_t hashEntries,
+				size_t hashCapacity) override
+		{
+			this->nodes = nodes;
+		}
+	};
+
+	Logger& mLogger;
+
+	std::ostream& mOut;
+
+	TimeConstraint mTimeConstraint;
+
+	size_t mHashBytes;
+
+	unsigned mThreadCount;
+
+	std::mutex mMutex;
+
+	// Output lines of finished positions that are waiting for earlier positions.
+	std::vector<std::string> mResults;
+
+	std::vector<bool> mDone;
+
+	size_t mNextOutput;
+
+public:
+
+	EpdAnalyzer(Logger& logger, std::ostream& out, const TimeConstraint& tc,
+			size_t hashBytes = EpdSuite::DEFAULT_HASH_BYTES,
+			unsigned threadCount = std::thread::hardware_concurrency())
+	: mLogger(logger), mOut(out), mTimeConstraint(tc), mHashBytes(hashBytes),
+	mThreadCount(std::max(1u, threadCount)), mNextOutput(0)
+	{
+	}
+
+	/* Analyzes the positions of the input, one per line. Empty lines and lines starting with '#'
+	 * are skipped. Returns the number of solved positions. */
+	size_t run(std::istream& is)
+	{
+		EpdSuite suite(is);
+		mResults.assign(suite.size(), std::string());
+		mDone.assign(suite.size(), false);
+		mNextOutput = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+
+		std::atomic<size_t> solved(0), tested(0);
+		unsigned threadCount = suite.run<SearchInfo>(mThreadCount, mHashBytes,
+				[&](size_t i, MinMaxAI& ai, SearchInfo& info) {
+			int result = -1;
+			std::string json = analyze(ai, info, i, suite[i], result);
+			tested += result >= 0;
+			solved += result > 0;
+			output(i, json);
+		});
+
+		std::chrono::duration<double> time = std::chrono::high_resolution_clock::now() - start;
+		std::string msg = strFormat(200, "Analyzed %zu positions in %.2fs with %u threads "
+				"(%.2f positions/s).", suite.size(), time.count(), threadCount,
+				suite.size() / std::max(time.count(), 1e-3));
+		if (tested)
+			msg += strFormat(100, " Solved %zu/%zu.", (size_t) solved, (size_t) tested);
+		mLogger.logMessage(msg);
+		return solved;
+	}
+
+	/* Returns a string literal in JSON format. */
+	static std::string jsonString(const std::string& s)
+	{
+		std::string r = "\"";
+		for (char c : s) {
+			if (c == '"' || c == '\\')
+				r += '\\';
+			if ((unsigned char) c < 0x20)
+				r += strFormat(8, "\\u%04x", c);
+			else
+				r += c;
+		}
+		return r + "\"";
+	}
+
+private:
+
+	/* Analyzes a single position. The result is 1 if the position was solved, 0 if not and -1 if
+	 * the position doesn't have a best move or a move to avoid. */
+	std::string analyze(MinMaxAI& ai, SearchInfo& info, size_t index, const std::string& line,
+			int& result)
+	{
+		std::stringstream ss;
+		ss << "{\"index\":" << index;
+		try {
+			Epd epd(line);
+			GameState state(epd);
+			if (epd.hasOperation("id"))
+				ss << ",\"id\":" << jsonString(epd.operation("id").str());
+
+			// Solutions are parsed first so that an invalid move is reported without a search.
+			std::vector<Move> bestMoves = EpdSuite::parseSanMoves(state, epd.operation("bm"));
+			std::vector<Move> avoidMoves = EpdSuite::parseSanMoves(state, epd.operation("am"));
+
+			auto start = std::chrono::high_resolution_clock::now();
+			Move move = ai.getMove(state, mTimeConstraint);
+			std::chrono::duration<double> time = std::chrono::high_resolution_clock::now() - start;
+			int score = ai.getScore();
+
+			ss << ",\"bestmove\":" << jsonString(move ? move.toStr(true) : "0000");
+			if (move)
+				ss << ",\"san\":" << jsonString(PgnWriter::toSan(state, move));
+			if (std::abs(score) > Scores::CHECK_MATE_THRESHOLD)
+				ss << ",\"score\":{\"mate\":" << Scores::toStr(score).substr(5) << "}";
+			else
+				ss << ",\"score\":{\"cp\":" << score << "}";
+			ss << ",\"depth\":" << info.depth << ",\"seldepth\":" << info.selDepth;
+			ss << ",\"nodes\":" << info.nodes;
+			ss << ",\"time\":" << (uint64_t) (time.count() * 1e3);
+			ss << ",\"pv\":[";
+			for (size_t i = 0; i < info.pv.size(); ++i)
+				ss << (i ? "," : "") << jsonString(info.pv[i].toStr(true));
+			ss << "]";
+
+			if (!bestMoves.empty() || !avoidMoves.empty()) {
+				result = EpdSuite::isSolution(bestMoves, avoidMoves, move);
+				ss << ",\"solved\":" << (result ? "true" : "false");
+			}
+		} catch (const std::exception& e) {
+			ss << ",\"error\":" << jsonString(e.what());
+		}
+		ss << "}";
+		return ss.str();
+	}
+
+	/* Stores the result and writes all results that are ready in input order. */
+	void output(size_t index, const std::string& json)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mResults[index] = json;
+		mDone[index] = true;
+		for (; mNextOutput < mDone.size() && mDone[mNextOutput]; ++mNextOutput) {
+			mOut << mResults[mNextOutput] << std::endl;
+			std::string().swap(mResults[mNextOutput]);
+		}
+	}
+};
+
+}
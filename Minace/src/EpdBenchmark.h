@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Epd.h"
+#include "Pgn.h"
+#include "Logger.h"
+#include "GameGenerator.h"
+#include "GameState.h"
+#include "Util.h"
+#include "Intrinsics.h"
+#include <vector>
+#include <string>
+#include <sstream>
+#include <chrono>
+#include <cstdint>
+
+namespace mnc {
+
+/**
+ * Measures lines per second of reading and parsing an EPD suite. The suite is generated from random
+ * positions with "bm", "ce", "acd" and "id" operations, so the results are reproducible. Each line
+ * is parsed and its operations are looked up like the skill test and the EPD analyzer do.
+ */
+class EpdBenchmark
+{
+private:
+	static constexpr unsigned POSITIONS = 1000;
+
+	Logger& mLogger;
+
+	size_t mLines;
+
+	std::string mSuite;
+
+public:
+
+	EpdBenchmark(Logger& logger, size_t lines = 1000000)
+	: mLogger(logger), mLines(lines)
+	{
+		std::vector<std::string> positions;
+		for (unsigned i = 0; i < POSITIONS; ++i) {
+			GameState state = GameGenerator::createGame(i);
+			std::vector<Move> moves;
+			state.getLegalMoves(moves);
+			std::ostringstream ss;
+			ss << state << " bm " << PgnWriter::toSan(state, moves[i % moves.size()]) << "; ce "
+					<< (int) (i % 200) - 100 << "; acd " << i % 30 << "; id \"bench.";
+			positions.push_back(ss.str());
+		}
+		std::ostringstream ss;
+		for (size_t i = 0; i < mLines; ++i)
+			ss << positions[i % POSITIONS] << i << "\";\n";
+		mSuite = ss.str();
+	}
+
+	void operator ()()
+	{
+		mLogger.logMessage("Running EPD parse benchmark...");
+		std::istringstream is(mSuite);
+		std::string line;
+		uint64_t lines = 0;
+		int64_t checksum = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		while (std::getline(is, line)) {
+			Epd epd(line);
+			int ce = 0, acd = 0;
+			epd.intOperation("ce", ce);
+			epd.intOperation("acd", acd);
+			checksum += ce + acd + epd.operation("bm").size() + epd.operation("id").size()
+					+ bitCount((uint64_t) epd.board()()) + epd.halfMoveClock();
+			++lines;
+		}
+		auto dur = std::chrono::high_resolution_clock::now() - start;
+		double time = std::chrono::duration_cast<std::chrono::nanoseconds>(dur).count() * 1e-9;
+		mLogger.logMessage(strFormat(200, "lines=%llu bytes=%llu time=%.3fs lines/s=%.3g "
+				"checksum=%lld", (unsigned long long) lines, (unsigned long long) mSuite.size(),
+				time, lines / time, (long long) checksum));
+	}
+};
+
+}
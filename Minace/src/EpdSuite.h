@@ -0,0 +1,107 @@
+#pragma once
+
+#include "MinMaxAI.h"
+#include "GameState.h"
+#include "Pgn.h"
+#include "Move.h"
+#include "Util.h"
+#include <vector>
+#include <string>
+#include <sstream>
+#include <istream>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <initializer_list>
+
+namespace mnc {
+
+/**
+ * Positions of an EPD file, searched with a pool of threads. Each position gets a new MinMaxAI, so
+ * that the transposition table starts empty and the results don't depend on the order of the
+ * positions or on the thread count.
+ */
+class EpdSuite
+{
+public:
+
+	static constexpr size_t DEFAULT_HASH_BYTES = 16 << 20;
+
+private:
+
+	std::vector<std::string> mLines;
+
+public:
+
+	EpdSuite(std::initializer_list<std::string> lines)
+	: mLines(lines)
+	{
+	}
+
+	/* Reads positions from EPD lines. Empty lines and lines starting with '#' are skipped. */
+	EpdSuite(std::istream& is)
+	{
+		std::string line;
+		while (std::getline(is, line)) {
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+			if (!line.empty() && line[0] != '#')
+				mLines.push_back(line);
+		}
+	}
+
+	size_t size() const
+	{
+		return mLines.size();
+	}
+
+	const std::string& operator [](size_t idx) const
+	{
+		return mLines[idx];
+	}
+
+	/* Calls func(index, ai, info) for each position from the given number of threads. The AI has
+	 * a new TInfo as its info callback. Returns the number of threads used. */
+	template<typename TInfo, typename TFunc>
+	unsigned run(unsigned threadCount, size_t hashBytes, TFunc func) const
+	{
+		threadCount = std::min<size_t>(std::max(1u, threadCount), std::max<size_t>(size(), 1));
+		std::atomic<size_t> nextIdx(0);
+		std::vector<std::thread> threads;
+		for (unsigned t = 0; t < threadCount; ++t) {
+			threads.emplace_back([&] {
+				for (size_t i; (i = nextIdx++) < size();) {
+					TInfo info;
+					MinMaxAI ai(&info, hashBytes);
+					func(i, ai, info);
+				}
+			});
+		}
+		for (std::thread& th : threads)
+			th.join();
+		return threadCount;
+	}
+
+	/* Parses moves in standard algebraic notation, e.g. the "bm" and "am" operations. Throws
+	 * std::invalid_argument if a move is not legal. */
+	static std::vector<Move> parseSanMoves(GameState& state, StringView sanMoves)
+	{
+		std::vector<Move> moves;
+		std::stringstream ss(sanMoves.str());
+		std::string san;
+		while (ss >> san)
+			moves.push_back(PgnReader::parseSan(state, san));
+		return moves;
+	}
+
+	/* Checks whether the move is one of the best moves (if any) and none of the moves to avoid. */
+	static bool isSolution(const std::vector<Move>& bestMoves, const std::vector<Move>& avoidMoves,
+			Move move)
+	{
+		return (bestMoves.empty()
+				|| std::find(bestMoves.begin(), bestMoves.end(), move) != bestMoves.end())
+				&& std::find(avoidMoves.begin(), avoidMoves.end(), move) == avoidMoves.end();
+	}
+};
+
+}
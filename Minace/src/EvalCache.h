@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Util.h"
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+
+namespace mnc {
+
+/**
+ * Direct-mapped cache of static evaluation scores by the zobrist code of the position. The low
+ * bits of the code select the entry and the high 32 bits are stored for verification, so each
+ * entry takes only 8 bytes.
+ */
+class EvalCache
+{
+private:
+
+	struct Entry
+	{
+		uint32_t check;
+
+		int32_t score;
+	};
+
+	std::vector<Entry> mEntries;
+
+	size_t mMask;
+
+	uint64_t mLookups, mHits;
+
+public:
+
+	explicit EvalCache(size_t capacityBytes)
+	: mLookups(0), mHits(0)
+	{
+		size_t capacity = roundUpToPowerOfTwo(capacityBytes / sizeof (Entry) + 1) / 2;
+		if (capacity == 0)
+			throw std::invalid_argument("Capacity too small.");
+		mEntries = std::vector<Entry>(capacity, Entry{0, 0});
+		mMask = capacity - 1;
+	}
+
+	/* Gets the score for given zobrist code. Returns false if not found. */
+	bool get(uint64_t id, int& score)
+	{
+		++mLookups;
+		const Entry& entry = mEntries[id & mMask];
+		if (entry.check != (uint32_t) (id >> 32))
+			return false;
+		++mHits;
+		score = entry.score;
+		return true;
+	}
+
+	void put(uint64_t id, int score)
+	{
+		mEntries[id & mMask] = Entry{(uint32_t) (id >> 32), score};
+	}
+
+	void clear()
+	{
+		std::fill(mEntries.begin(), mEntries.end(), Entry{0, 0});
+	}
+
+	size_t capacity() const
+	{
+		return mEntries.size();
+	}
+
+	uint64_t lookups() const
+	{
+		return mLookups;
+	}
+
+	uint64_t hits() const
+	{
+		return mHits;
+	}
+};
+
+}
@@ -3,6 +3,14 @@
 #include "Scores.h"
 #include "Player.h"
 #include "GameState.h"
+#include "PawnHashTable.h"
+#include "EvalCache.h"
+#include "Nnue.h"
+#include "Endgames.h"
+#include "MaterialTable.h"
+#include "MoveMasks.h"
+#include "Intrinsics.h"
+#include <memory>
 
 namespace mnc {
 
@@ -11,58 +19,368 @@ namespace mnc {
  * incrementally by notifying about each move (makeMove/makeNullMove/undoMove). Scores is
  * calculated based on piece values and locations, and it is symmetric in the sense that the score
  * for one player is the additive inverse of the other player's score.
+ *
+ * Middle game and end game scores are updated together as a packed score, and the material key
+ * is updated from captures and promotions. The scores are interpolated by the game phase only in
+ * getScore(). The phase and the other terms that depend only on the material (imbalance, scale
+ * factors and specialized endgame evaluation) are cached in a material hash table.
+ *
+ * Pawn structure is not updated incrementally, but evaluated only when needed (evaluate()) and
+ * cached in a pawn hash table.
+ *
+ * If NNUE weights are set, evaluate() returns the NNUE score instead. The piece-square score is
+ * still updated and available from getScore().
+ *
+ * Mobility and king attacks are evaluated lazily: they are skipped if the score without them is
+ * far enough outside the search window.
+ *
+ * Results of evaluate() are cached by the zobrist code of the position, because the same
+ * positions are often reached through transpositions, e.g. in quiescence search.
+ *
+ * Endgames with a specialized evaluation (see Endgames.h) are scored by it instead.
  */
 class Evaluator
 {
 private:
+	static constexpr uint64_t FILE_MASK = 0x0101010101010101ull;
+
+	static constexpr size_t PAWN_HASH_TABLE_BYTES = 1 << 22;
+
+	static constexpr size_t EVAL_CACHE_BYTES = 1 << 20;
+
+	static constexpr size_t MATERIAL_TABLE_BYTES = 1 << 16;
+
+	// Maximum expected effect of the lazily evaluated terms.
+	static constexpr int LAZY_EVAL_MARGIN = 150;
+
 	unsigned mPly;
 
+	// Packed middle game and end game scores.
 	std::vector<int> mScores;
 
+	std::vector<uint64_t> mMaterialKeys;
+
+	// Material table entry of each ply, inherited from the previous ply. It is fetched again from
+	// the table when its key doesn't match, i.e. when the material changes or the entry has been
+	// replaced by a colliding key.
+	std::vector<const MaterialTable::Entry*> mMaterialEntries;
+
 	Player mPlayer;
+
+	PawnHashTable mPawnHashTable;
+
+	MaterialTable mMaterialTable;
+
+	EvalCache mEvalCache;
+
+	std::unique_ptr<Nnue> mNnue;
+
+	uint64_t mEvaluations, mLazyEvaluations;
 public:
 
 	Evaluator(size_t maxDepth)
-	: mPly(0), mScores(maxDepth + 1), mPlayer(Player::NONE)
+	: mPly(0), mScores(maxDepth + 1), mMaterialKeys(maxDepth + 1),
+	mMaterialEntries(maxDepth + 1), mPlayer(Player::NONE),
+	mPawnHashTable(PAWN_HASH_TABLE_BYTES),
+	mMaterialTable(MATERIAL_TABLE_BYTES),
+	mEvalCache(EVAL_CACHE_BYTES),
+	mEvaluations(0),
+	mLazyEvaluations(0)
 	{
 	}
 
 	void reset(const GameState& state)
 	{
 		mPly = 0;
-		mScores[mPly] = 0;
 		mPlayer = state.activePlayer();
+		mScores[mPly] = calculate(state);
+		mMaterialKeys[mPly] = state.materialId();
+		mMaterialEntries[mPly] = nullptr;
+		if (mNnue)
+			mNnue->reset(state.board());
+	}
+
+	/* Enables NNUE evaluation with given weights, or disables it if null. */
+	void setNnue(std::shared_ptr<const NnueWeights> weights)
+	{
+		mNnue.reset(weights ? new Nnue(weights, mScores.size() - 1) : nullptr);
+		mEvalCache.clear();
+	}
+
+	Nnue* nnue()
+	{
+		return mNnue.get();
+	}
+
+	/* Checks that the incrementally updated score equals the score calculated from scratch. */
+	bool isConsistent(const GameState& state) const
+	{
+		return mPlayer == state.activePlayer() && calculate(state) == mScores[mPly]
+				&& mMaterialKeys[mPly] == state.board().materialKey()
+				&& (!mNnue || mNnue->isConsistent(state.board()));
+	}
 
+	int getScore()
+	{
+		assert(mPlayer);
+		return Scores::taperedScore(mScores[mPly], material().phase);
+	}
+
+	/* Game phase from 0 (end game) to Scores::MAX_PHASE (middle game). */
+	int getPhase()
+	{
+		return material().phase;
+	}
+
+	const MaterialTable::Entry& material()
+	{
+		const MaterialTable::Entry* entry = mMaterialEntries[mPly];
+		if (!entry || entry->key != mMaterialKeys[mPly])
+			entry = mMaterialEntries[mPly] = &mMaterialTable.get(mMaterialKeys[mPly]);
+		return *entry;
+	}
+
+	/* Score of the specialized endgame evaluation from the active player's point of view (see
+	 * Endgames). Returns false if there is none. */
+	bool evaluateEndgame(const GameState& state, int& score, bool& exact)
+	{
+		assert(state.activePlayer() == mPlayer);
+		int endgame = material().endgame;
+		return endgame != Endgames::NONE
+				&& Endgames::evaluate(endgame, state.board(), mPlayer, score, exact);
+	}
+
+	/* Score including pawn structure, mobility and king attacks. The state must match the current
+	 * position of the evaluator. If the score without mobility and king attacks is more than
+	 * LAZY_EVAL_MARGIN below alpha or above beta, it is returned as such. */
+	int evaluate(const GameState& state, int alpha = -Scores::INF, int beta = Scores::INF)
+	{
+		assert(state.activePlayer() == mPlayer);
+
+		int score;
+		if (mEvalCache.get(state.id(), score))
+			return score;
+
+		++mEvaluations;
+		bool exact;
+		if (evaluateEndgame(state, score, exact)) {
+			// Exact or known result, no need for the other terms.
+		} else if (mNnue) {
+			score = mNnue->evaluate(state.board(), mPlayer);
+		} else {
+			score = getScore() + pawnScore(state) + relativeScore(material().imbalance);
+			int scaled = scaledScore(score);
+			if (scaled + LAZY_EVAL_MARGIN <= alpha || scaled - LAZY_EVAL_MARGIN >= beta) {
+				// Not cached, because the score is not exact.
+				++mLazyEvaluations;
+				return scaled;
+			}
+			score = scaledScore(score + relativeScore(evaluateActivity(state.board())));
+		}
+		mEvalCache.put(state.id(), score);
+		return score;
+	}
+
+	/* Full evaluation without the cache and lazy evaluation. */
+	int evaluateUncached(const GameState& state)
+	{
+		assert(state.activePlayer() == mPlayer);
+
+		int score;
+		bool exact;
+		if (evaluateEndgame(state, score, exact))
+			return score;
+		if (mNnue)
+			return mNnue->evaluate(state.board(), mPlayer);
+		return scaledScore(getScore() + pawnScore(state) + relativeScore(material().imbalance)
+				+ relativeScore(evaluateActivity(state.board())));
+	}
+
+	const PawnHashTable& pawnHashTable() const
+	{
+		return mPawnHashTable;
+	}
+
+	const MaterialTable& materialTable() const
+	{
+		return mMaterialTable;
+	}
+
+	const EvalCache& evalCache() const
+	{
+		return mEvalCache;
+	}
+
+	uint64_t evaluations() const
+	{
+		return mEvaluations;
+	}
+
+	uint64_t lazyEvaluations() const
+	{
+		return mLazyEvaluations;
+	}
+
+	/* Evaluates mobility and attacks against the enemy king. Score is from white's point of
+	 * view. */
+	static int evaluateActivity(const BitBoard& board)
+	{
+		uint64_t occupied = (uint64_t) board();
+		uint64_t whitePawns = (uint64_t) board(Player::WHITE, Piece::PAWN);
+		uint64_t blackPawns = (uint64_t) board(Player::BLACK, Piece::PAWN);
+		uint64_t pawnAttacks[Player::COUNT] = {
+			(whitePawns & ~FILE_MASK) >> 9 | (whitePawns & ~(FILE_MASK << 7)) >> 7,
+			(blackPawns & ~FILE_MASK) << 7 | (blackPawns & ~(FILE_MASK << 7)) << 9
+		};
+
+		int score = 0;
+		for (unsigned i = 0; i < Player::COUNT; ++i) {
+			Player player(i);
+			uint64_t safe = ~(uint64_t) board(player) & ~pawnAttacks[~player];
+			uint64_t enemyKing = (uint64_t) board(~player, Piece::KING);
+			uint64_t kingZone = enemyKing ? (uint64_t) MoveMasks::KING_MOVES[
+					countTrailingZeros(enemyKing)] | enemyKing : 0;
+
+			int playerScore = 0;
+			unsigned attackers = 0, attackWeight = 0;
+			for (unsigned pieceType = Piece::QUEEN; pieceType < Piece::PAWN; ++pieceType) {
+				for (Sqr sqr : board(player, Piece(pieceType))) {
+					uint64_t attacks = attackedSquares(Piece(pieceType), sqr, occupied);
+					playerScore += Scores::MOBILITY_VALUES[pieceType] * bitCount(attacks & safe);
+					if (unsigned kingAttacks = bitCount(attacks & kingZone)) {
+						++attackers;
+						attackWeight += Scores::KING_ATTACK_WEIGHTS[pieceType] * kingAttacks;
+					}
+				}
+			}
+			if (attackers >= 2)
+				playerScore += Scores::KING_ATTACK_VALUES[std::min(attackWeight, 15u)];
+
+			score += player == Player::WHITE ? playerScore : -playerScore;
+		}
+
+		return score;
+	}
+
+	/* Evaluates passed, isolated, doubled and backward pawns. Score is from white's point of
+	 * view. */
+	static int evaluatePawns(const BitBoard& board)
+	{
+		int score = 0;
+
+		for (unsigned i = 0; i < Player::COUNT; ++i) {
+			Player player(i);
+			uint64_t ownPawns = (uint64_t) board(player, Piece::PAWN);
+			uint64_t enemyPawns = (uint64_t) board(~player, Piece::PAWN);
+			int playerScore = 0;
+
+			for (Sqr sqr : board(player, Piece::PAWN)) {
+				unsigned row = sqr.row();
+				unsigned col = sqr.col();
+				uint64_t file = FILE_MASK << col;
+				uint64_t adjacentFiles = (col > 0 ? FILE_MASK << (col - 1) : 0)
+						| (col < 7 ? FILE_MASK << (col + 1) : 0);
+
+				// Rows in front of the pawn (white moves towards row 0).
+				uint64_t front = player == Player::WHITE ? (1ull << 8 * row) - 1
+						: ~((2ull << (8 * row + 7)) - 1);
+
+				bool doubled = ownPawns & file & front;
+				bool isolated = !(ownPawns & adjacentFiles);
+
+				if (doubled)
+					playerScore -= Scores::DOUBLED_PAWN_PENALTY;
+				if (isolated)
+					playerScore -= Scores::ISOLATED_PAWN_PENALTY;
+
+				if (!doubled && !(enemyPawns & (file | adjacentFiles) & front)) {
+					unsigned rank = player == Player::WHITE ? 7 - row : row;
+					playerScore += Scores::PASSED_PAWN_VALUES[rank];
+				} else if (!isolated && !(ownPawns & adjacentFiles & ~front)) {
+					// Backward if an enemy pawn controls the square in front.
+					int attackRow = player == Player::WHITE ? (int) row - 2 : row + 2;
+					if (attackRow >= 0 && attackRow < 8
+							&& (enemyPawns & adjacentFiles & (0xffull << 8 * attackRow)))
+						playerScore -= Scores::BACKWARD_PAWN_PENALTY;
+				}
+			}
+
+			score += player == Player::WHITE ? playerScore : -playerScore;
+		}
+
+		return score;
+	}
+
+	static uint64_t attackedSquares(Piece pieceType, Sqr sqr, uint64_t occupied)
+	{
+		switch (pieceType) {
+		case Piece::QUEEN:
+			return (uint64_t) MoveMasks::getQueenMoves(sqr, occupied);
+		case Piece::ROOK:
+			return (uint64_t) MoveMasks::getRookMoves(sqr, occupied);
+		case Piece::BISHOP:
+			return (uint64_t) MoveMasks::getBishopMoves(sqr, occupied);
+		default:
+			return (uint64_t) MoveMasks::KNIGHT_MOVES[sqr];
+		}
+	}
+
+	/* Pawn structure score from the active player's point of view. */
+	int pawnScore(const GameState& state)
+	{
+		int score;
+		if (!mPawnHashTable.get(state.pawnId(), score)) {
+			score = evaluatePawns(state.board());
+			mPawnHashTable.put(state.pawnId(), score);
+		}
+		return relativeScore(score);
+	}
+
+	/* Scales the score down by the material scale factor of the player who is ahead. */
+	int scaledScore(int score)
+	{
+		Player player = score > 0 ? mPlayer : ~mPlayer;
+		return score * material().scales[player] / MaterialTable::SCALE_NORMAL;
+	}
+
+	/* Converts score from white's point of view to the active player's point of view. */
+	int relativeScore(int score) const
+	{
+		return mPlayer == Player::WHITE ? score : -score;
+	}
+
+	/* Calculates packed score from scratch. */
+	static int calculate(const GameState& state)
+	{
+		int score = 0;
 		for (unsigned playerOffset = 0; playerOffset < 2; ++playerOffset) {
 			for (unsigned pieceType = 0; pieceType < Piece::COUNT; ++pieceType) {
-				Player player((mPlayer + playerOffset) % 2);
+				Player player((state.activePlayer() + playerOffset) % 2);
 				Mask pieces = state.board()(player, Piece(pieceType));
 				for (Sqr sqr : pieces) {
-					int value = Scores::POSITIONAL_PIECE_VALUES[player][pieceType][sqr];
-					mScores[mPly] += (1 - 2 * playerOffset) * value;
+					int value = Scores::PACKED_POSITIONAL_PIECE_VALUES[player][pieceType][sqr];
+					score += (1 - 2 * playerOffset) * value;
 				}
 			}
 		}
-	}
-
-	int getScore()
-	{
-		assert(mPlayer);
-		return mScores[mPly];
+		return score;
 	}
 
 	int getRelativeScore()
 	{
 		assert(mPlayer);
-		return mScores[mPly] - (1 - 2 * (mPly & 1)) * mScores[0];
+		return Scores::taperedScore(mScores[mPly] - (1 - 2 * (mPly & 1)) * mScores[0],
+				material().phase);
 	}
 
-	void makeMove(Move move)
+	/* Updates score after move. En passant square must be the one before the move. */
+	void makeMove(Move move, Sqr enPassantSqr = Sqr::NONE)
 	{
 		assert(mPlayer);
 		assert(mPly < mScores.size());
 
 		int score = mScores[mPly];
+		uint64_t materialKey = mMaterialKeys[mPly];
 
 		Sqr fromSqr = move.fromSqr();
 		Sqr toSqr = move.toSqr();
@@ -70,14 +388,34 @@ public:
 		Piece capturedType = move.capturedType();
 		Piece newType = move.newType();
 
-		score -= Scores::POSITIONAL_PIECE_VALUES[mPlayer][pieceType][fromSqr];
-		score += Scores::POSITIONAL_PIECE_VALUES[mPlayer][newType][toSqr];
-		if (capturedType)
-			score += Scores::POSITIONAL_PIECE_VALUES[~mPlayer][capturedType][toSqr];
+		score -= Scores::PACKED_POSITIONAL_PIECE_VALUES[mPlayer][pieceType][fromSqr];
+		score += Scores::PACKED_POSITIONAL_PIECE_VALUES[mPlayer][newType][toSqr];
+		materialKey += BitBoard::materialKeyUnit(mPlayer, newType)
+				- BitBoard::materialKeyUnit(mPlayer, pieceType);
+		if (capturedType) {
+			Sqr capturedSqr = toSqr;
+			if (pieceType == Piece::PAWN && toSqr == enPassantSqr)
+				capturedSqr = Sqr(toSqr + 8 - 16 * mPlayer);
+			score += Scores::PACKED_POSITIONAL_PIECE_VALUES[~mPlayer][capturedType][capturedSqr];
+			materialKey -= BitBoard::materialKeyUnit(~mPlayer, capturedType);
+		}
+
+		// Move rook when castling.
+		if (pieceType == Piece::KING && ((fromSqr - toSqr) & 3) == 2) {
+			bool queenSide = toSqr.col() == 2;
+			Sqr rookFromSqr(8 * toSqr.row() + (queenSide ? 0 : 7));
+			Sqr rookToSqr(8 * toSqr.row() + (queenSide ? 3 : 5));
+			score -= Scores::PACKED_POSITIONAL_PIECE_VALUES[mPlayer][Piece::ROOK][rookFromSqr];
+			score += Scores::PACKED_POSITIONAL_PIECE_VALUES[mPlayer][Piece::ROOK][rookToSqr];
+		}
 
-		//TODO handle castling and en passant
+		if (mNnue)
+			mNnue->makeMove(mPlayer, move, enPassantSqr);
 
+		const MaterialTable::Entry* materialEntry = mMaterialEntries[mPly];
 		mScores[++mPly] = -score;
+		mMaterialEntries[mPly] = materialEntry;
+		mMaterialKeys[mPly] = materialKey;
 		mPlayer = ~mPlayer;
 	}
 
@@ -85,14 +423,22 @@ public:
 	{
 		assert(mPlayer);
 		int score = mScores[mPly];
+		uint64_t materialKey = mMaterialKeys[mPly];
+		const MaterialTable::Entry* materialEntry = mMaterialEntries[mPly];
 		mScores[++mPly] = -score;
+		mMaterialKeys[mPly] = materialKey;
+		mMaterialEntries[mPly] = materialEntry;
 		mPlayer = ~mPlayer;
+		if (mNnue)
+			mNnue->makeNullMove();
 	}
 
 	void undoMove()
 	{
 		assert(mPly >= 0);
 		--mPly;
+		if (mNnue)
+			mNnue->undoMove();
 		mPlayer = ~mPlayer;
 	}
 };
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Evaluator.h"
+#include "Nnue.h"
+#include "Logger.h"
+#include "GameGenerator.h"
+#include "GameState.h"
+#include "Util.h"
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+namespace mnc {
+
+/**
+ * Measures evaluations per second of the piece-square evaluation and of the NNUE evaluation with
+ * scalar and SIMD code. Each evaluation is done after making a move from a randomly generated
+ * position, so the cost of the incremental update is included.
+ */
+class EvaluatorBenchmark
+{
+private:
+	static constexpr unsigned POSITIONS = 1000;
+
+	Logger& mLogger;
+
+	double mLength;
+
+	std::vector<GameState> mStates;
+
+	std::vector<std::vector<Move>> mMoves;
+
+public:
+
+	EvaluatorBenchmark(Logger& logger, double length)
+	: mLogger(logger), mLength(length)
+	{
+		for (unsigned i = 0; i < POSITIONS; ++i) {
+			mStates.push_back(GameGenerator::createGame(i));
+			mMoves.emplace_back();
+			mStates.back().getLegalMoves(mMoves.back());
+		}
+	}
+
+	void operator ()()
+	{
+		mLogger.logMessage("Running evaluator benchmark...");
+
+		Evaluator evaluator(1);
+		run("PST", evaluator);
+
+		evaluator.setNnue(NnueWeights::random(1234));
+		evaluator.nnue()->setSimd(false);
+		run("NNUE scalar", evaluator);
+		evaluator.nnue()->setSimd(true);
+		run("NNUE SIMD", evaluator);
+
+		mLogger.logMessage("Benchmark done.");
+	}
+
+private:
+
+	void run(const char* name, Evaluator& evaluator)
+	{
+		uint64_t evals = 0;
+		int64_t checksum = 0;
+		double time = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		while (time < mLength) {
+			for (unsigned i = 0; i < POSITIONS; ++i) {
+				GameState& state = mStates[i];
+				evaluator.reset(state);
+				for (Move move : mMoves[i]) {
+					Sqr enPassantSqr = state.enPassantSqr();
+					state.makeMove(move);
+					evaluator.makeMove(move, enPassantSqr);
+					checksum += evaluator.evaluateUncached(state);
+					evaluator.undoMove();
+					state.undoMove(move);
+				}
+				evals += mMoves[i].size();
+			}
+			auto dur = std::chrono::high_resolution_clock::now() - start;
+			time = std::chrono::duration_cast<std::chrono::nanoseconds>(dur).count() * 1e-9;
+		}
+		mLogger.logMessage(strFormat(200, "%-12s evals=%llu time=%.3fs evals/s=%.3g checksum=%lld",
+				name, (unsigned long long) evals, time, evals / time, (long long) checksum));
+	}
+};
+
+}
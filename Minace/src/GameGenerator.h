@@ -5,6 +5,7 @@
 #include "BitBoard.h"
 #include "Player.h"
 #include <random>
+#include <vector>
 #include <cstdint>
 
 namespace mnc {
@@ -20,6 +21,7 @@ namespace mnc {
  * - Number of pieces of each type (except king) is between 0 and n, where n is the number in the
  * standard starting position.
  * - The position is not guaranteed to be balanced.
+ * The same seed gives the same game state with every standard library.
  */
 class GameGenerator
 {
@@ -43,26 +45,52 @@ public:
 		return state;
 	}
 
+	/* Plays given number of random legal moves from the standard starting position. Moves that
+	 * end the game are not chosen. */
+	static GameState createOpening(unsigned plies, std::mt19937_64& rng)
+	{
+		GameState state;
+		std::vector<Move> moves;
+		for (unsigned i = 0; i < plies; ++i) {
+			moves.clear();
+			state.getLegalMoves(moves);
+			for (;;) {
+				Move move = moves[randomInt(rng, 0, moves.size() - 1)];
+				state.makeMove(move);
+				if (!state.isCheckMate() && !state.isStaleMate())
+					break;
+				state.undoMove(move);
+			}
+		}
+
+		return state;
+	}
+
 private:
 
 	static void addRandomizedPieces(BitBoard& board, unsigned min, unsigned max, Piece pieceType,
 			std::mt19937_64& rng)
 	{
-		std::uniform_int_distribution<unsigned> distr0_63(0, 63);
-		std::uniform_int_distribution<unsigned> distr8_55(8, 55);
-
 		for (unsigned player = 0; player < 2; ++player) {
-			unsigned n = std::uniform_int_distribution<unsigned>(min, max)(rng);
+			unsigned n = randomInt(rng, min, max);
 			for (unsigned i = 0; i < n; ++i) {
 				Sqr sqr;
 				do {
 					// No soldiers on first/last row.
-					sqr = Sqr(pieceType != Piece::PAWN ? distr0_63(rng) : distr8_55(rng));
+					sqr = Sqr(pieceType != Piece::PAWN ? randomInt(rng, 0, 63)
+							: randomInt(rng, 8, 55));
 				} while (board(sqr));
 				board.addPiece(Player(player), pieceType, sqr);
 			}
 		}
 	}
+
+	/* Random integer in range [min, max]. Unlike std::uniform_int_distribution, the result
+	 * doesn't depend on the standard library. The modulo bias is negligible for small ranges. */
+	static unsigned randomInt(std::mt19937_64& rng, unsigned min, unsigned max)
+	{
+		return min + rng() % (max - min + 1);
+	}
 };
 
 }
\ No newline at end of file
@@ -3,12 +3,15 @@
 #include "Sqr.h"
 #include "Mask.h"
 #include "Move.h"
+#include "PackedMove.h"
 #include "Piece.h"
 #include "BitBoard.h"
 #include "MoveMasks.h"
 #include "Zobrist.h"
 #include "Epd.h"
 #include <string>
+#include <algorithm>
+#include <iterator>
 #include <iosfwd>
 #include <cstdint>
 
@@ -22,14 +25,20 @@ public:
 	struct HistoryEntry
 	{
 		uint64_t zobristCode;
+		uint64_t pawnZobristCode;
+		uint64_t materialKey;
 		Mask castlingRights;
 		Sqr enPassantSqr;
 		unsigned halfMoveClock;
+		unsigned pliesFromNull;
 	};
 
 private:
 	BitBoard mBoard;
 
+	// Piece type + 1 of each square, or zero if the square is empty.
+	uint8_t mMailbox[Sqr::COUNT];
+
 	Player mPlayer;
 
 	unsigned mPly;
@@ -72,9 +81,12 @@ public:
 			throw std::invalid_argument("Invalid en passant square.");
 
 		mHist[0].zobristCode = Zobrist::EMPTY_RND;
+		mHist[0].pawnZobristCode = Zobrist::EMPTY_RND;
+		mHist[0].materialKey = mBoard.materialKey();
 		mHist[0].enPassantSqr = enPassantSqr;
 		mHist[0].castlingRights = 0;
 		mHist[0].halfMoveClock = halfMoveClock;
+		mHist[0].pliesFromNull = 0;
 
 		if (startingPlayer == Player::BLACK)
 			mHist[0].zobristCode ^= Zobrist::PLAYER_RND;
@@ -91,11 +103,17 @@ public:
 		if (enPassantSqr)
 			mHist[0].zobristCode ^= Zobrist::EN_PASSANT_RND[enPassantSqr];
 
+		std::fill(std::begin(mMailbox), std::end(mMailbox), 0);
+
 		for (unsigned player = 0; player < Player::COUNT; ++player) {
 			for (unsigned sqr = 0; sqr < Sqr::COUNT; ++sqr) {
 				Piece piece = mBoard.getPieceType(Player(player), Sqr(sqr));
-				if (piece)
+				if (piece) {
+					mMailbox[sqr] = piece + 1;
 					mHist[0].zobristCode ^= Zobrist::PIECE_SQR_RND[player][piece][sqr];
+				}
+				if (piece == Piece::PAWN)
+					mHist[0].pawnZobristCode ^= Zobrist::PIECE_SQR_RND[player][piece][sqr];
 			}
 		}
 	}
@@ -110,6 +128,27 @@ public:
 		return mBoard;
 	}
 
+	/* Piece type on given square (of either player) or NONE. */
+	Piece getPieceType(Sqr sqr) const
+	{
+		return Piece((unsigned) mMailbox[sqr] - 1);
+	}
+
+	/* Restores the piece types of a move that was packed in this position. */
+	Move unpackMove(PackedMove move) const
+	{
+		if (!move)
+			return Move();
+		Sqr fromSqr = move.fromSqr(), toSqr = move.toSqr();
+		Piece pieceType = getPieceType(fromSqr);
+		Piece capturedType = getPieceType(toSqr);
+		assert(pieceType);
+		if (pieceType == Piece::PAWN && fromSqr.col() != toSqr.col() && !capturedType)
+			capturedType = Piece::PAWN; // En passant
+		Piece newType = move.promotionType() ? move.promotionType() : pieceType;
+		return Move(fromSqr, toSqr, pieceType, capturedType, newType);
+	}
+
 	unsigned ply() const
 	{
 		return mPly;
@@ -134,8 +173,11 @@ public:
 	{
 		growArrays();
 		mHist[mPly + 1].zobristCode = mHist[mPly].zobristCode;
+		mHist[mPly + 1].pawnZobristCode = mHist[mPly].pawnZobristCode;
+		mHist[mPly + 1].materialKey = mHist[mPly].materialKey;
 		++mPly;
 		updateHalfMoveClock(move);
+		mHist[mPly].pliesFromNull = mHist[mPly - 1].pliesFromNull + 1;
 		if (move.isCapture())
 			removeCapturedPiece(move);
 		handleCastlingMove(move);
@@ -161,8 +203,11 @@ public:
 	{
 		growArrays();
 		mHist[mPly + 1].zobristCode = mHist[mPly].zobristCode;
+		mHist[mPly + 1].pawnZobristCode = mHist[mPly].pawnZobristCode;
+		mHist[mPly + 1].materialKey = mHist[mPly].materialKey;
 		++mPly;
 		mHist[mPly].halfMoveClock = mHist[mPly - 1].halfMoveClock + 1;
+		mHist[mPly].pliesFromNull = 0;
 		if (mHist[mPly - 1].enPassantSqr)
 			mHist[mPly].zobristCode ^= Zobrist::EN_PASSANT_RND[mHist[mPly - 1].enPassantSqr];
 		mHist[mPly].enPassantSqr = Sqr::NONE;
@@ -332,6 +377,18 @@ public:
 		return mHist[ply].zobristCode;
 	}
 
+	/* Zobrist code of the pawns only. */
+	uint64_t pawnId() const
+	{
+		return mHist[mPly].pawnZobristCode;
+	}
+
+	/* Piece counts of both players (see BitBoard::materialKey()). */
+	uint64_t materialId() const
+	{
+		return mHist[mPly].materialKey;
+	}
+
 	bool operator==(const GameState_t& rhs) const
 	{
 		bool result = mBoard == rhs.mBoard
@@ -401,7 +458,7 @@ public:
 	{
 		// Unlike half move clock the "repetition clock" is also reset by moves that change castling
 		// rights, so this loop may do some extra work (but still works correctly).
-		int start = std::max((int) mPly - (int) mHist[mPly].halfMoveClock, 0);
+		int start = mPly - reversiblePlies();
 		for (int i = mPly - 2; i >= start; i -= 2) {
 			if (mHist[i].zobristCode == mHist[mPly].zobristCode)
 				return true;
@@ -409,6 +466,37 @@ public:
 		return false;
 	}
 
+	/* Checks whether the active player has a reversible move to a position that occurred earlier,
+	 * i.e. can force a repetition. Finds the move with cuckoo hashing from the zobrist code
+	 * difference instead of generating moves. */
+	bool hasUpcomingRepetition() const
+	{
+		unsigned plies = reversiblePlies();
+		for (unsigned i = 3; i <= plies; i += 2) {
+			uint64_t key = mHist[mPly].zobristCode ^ mHist[mPly - i].zobristCode;
+			unsigned j = Zobrist::cuckooHash1(key);
+			if (Zobrist::CUCKOO_KEYS[j] != key) {
+				j = Zobrist::cuckooHash2(key);
+				if (Zobrist::CUCKOO_KEYS[j] != key)
+					continue;
+			}
+			PackedMove move = Zobrist::CUCKOO_MOVES[j];
+			Sqr fromSqr = move.fromSqr(), toSqr = move.toSqr();
+			if (!(MoveMasks::KNIGHT_MOVES[fromSqr] & Mask(toSqr))
+					&& !(MoveMasks::getQueenMoves(fromSqr, mBoard()) & Mask(toSqr)))
+				continue; // Path blocked.
+			if (mBoard(mPlayer, getPieceType(fromSqr) ? fromSqr : toSqr))
+				return true;
+		}
+		return false;
+	}
+
+	/* Number of plies since the last irreversible move or null move. */
+	unsigned reversiblePlies() const
+	{
+		return std::min(mHist[mPly].halfMoveClock, mHist[mPly].pliesFromNull);
+	}
+
 private:
 
 	void changeNextMovingPlayer()
@@ -420,13 +508,21 @@ private:
 	void addPiece(Player player, Piece piece, Sqr sqr)
 	{
 		mBoard.addPiece(player, piece, sqr);
+		mMailbox[sqr] = piece + 1;
+		mHist[mPly].materialKey += BitBoard::materialKeyUnit(player, piece);
 		mHist[mPly].zobristCode ^= Zobrist::PIECE_SQR_RND[player][piece][sqr];
+		if (piece == Piece::PAWN)
+			mHist[mPly].pawnZobristCode ^= Zobrist::PIECE_SQR_RND[player][piece][sqr];
 	}
 
 	void removePiece(Player player, Piece piece, Sqr sqr)
 	{
 		mBoard.removePiece(player, piece, sqr);
+		mMailbox[sqr] = 0;
+		mHist[mPly].materialKey -= BitBoard::materialKeyUnit(player, piece);
 		mHist[mPly].zobristCode ^= Zobrist::PIECE_SQR_RND[player][piece][sqr];
+		if (piece == Piece::PAWN)
+			mHist[mPly].pawnZobristCode ^= Zobrist::PIECE_SQR_RND[player][piece][sqr];
 	}
 
 	void removeCapturedPiece(Move move)
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "BitBoard.h"
+#include "Endgames.h"
+#include "Scores.h"
+#include "Player.h"
+#include "Piece.h"
+#include "Util.h"
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+
+namespace mnc {
+
+/**
+ * Hash table for the evaluation terms that depend only on the material of the position (see
+ * BitBoard::materialKey()): game phase, material imbalance, scale factors for drawish material and
+ * the specialized endgame evaluation. An entry is calculated from the material key when it is not
+ * found, so the work is done once per material configuration instead of once per node. Material
+ * changes rarely during search, so the table can be very small.
+ */
+class MaterialTable
+{
+public:
+	// Scale factor that keeps the score as such.
+	static constexpr int SCALE_NORMAL = 64;
+
+	struct Entry
+	{
+		uint64_t key;
+
+		// Score from white's point of view.
+		int16_t imbalance;
+
+		// Game phase from 0 (end game) to Scores::MAX_PHASE (middle game).
+		uint8_t phase;
+
+		// Scale factor of the score when the player is ahead.
+		uint8_t scales[Player::COUNT];
+
+		// Specialized endgame evaluation or Endgames::NONE.
+		int8_t endgame;
+	};
+
+private:
+
+	std::vector<Entry> mEntries;
+
+	size_t mMask;
+
+	uint64_t mLookups, mHits;
+
+public:
+
+	explicit MaterialTable(size_t capacityBytes)
+	: mLookups(0), mHits(0)
+	{
+		size_t capacity = roundUpToPowerOfTwo(capacityBytes / sizeof (Entry) + 1) / 2;
+		if (capacity == 0)
+			throw std::invalid_argument("Capacity too small.");
+		Entry empty;
+		calculate(0, empty); // No valid position has key 0.
+		mEntries = std::vector<Entry>(capacity, empty);
+		mMask = capacity - 1;
+	}
+
+	/* Gets the entry for the material key, calculating it if not found. */
+	const Entry& get(uint64_t key)
+	{
+		++mLookups;
+		Entry& entry = mEntries[(key * 0x9e3779b97f4a7c15ull >> 32) & mMask];
+		if (entry.key == key)
+			++mHits;
+		else
+			calculate(key, entry);
+		return entry;
+	}
+
+	size_t capacity() const
+	{
+		return mEntries.size();
+	}
+
+	uint64_t lookups() const
+	{
+		return mLookups;
+	}
+
+	uint64_t hits() const
+	{
+		return mHits;
+	}
+
+	static void calculate(uint64_t key, Entry& entry)
+	{
+		int counts[Player::COUNT][Piece::COUNT];
+		int phase = 0, imbalance = 0, material[Player::COUNT] = {};
+		for (unsigned player = 0; player < Player::COUNT; ++player) {
+			int* c = counts[player];
+			for (unsigned piece = 0; piece < Piece::COUNT; ++piece) {
+				c[piece] = BitBoard::pieceCount(key, Player(player), Piece(piece));
+				phase += c[piece] * Scores::PHASE_WEIGHTS[piece];
+				if (piece != Piece::KING && piece != Piece::PAWN)
+					material[player] += c[piece] * Scores::PIECE_VALUES[piece];
+			}
+
+			int playerImbalance = (c[Piece::BISHOP] >= 2) * Scores::BISHOP_PAIR_BONUS
+					+ (c[Piece::PAWN] - 5) * (c[Piece::KNIGHT] * Scores::KNIGHT_PAWN_BONUS
+							- c[Piece::ROOK] * Scores::ROOK_PAWN_PENALTY);
+			imbalance += player == Player::WHITE ? playerImbalance : -playerImbalance;
+		}
+
+		entry.key = key;
+		entry.imbalance = imbalance;
+		entry.phase = std::min(phase, (int) Scores::MAX_PHASE);
+		for (unsigned player = 0; player < Player::COUNT; ++player)
+			entry.scales[player] = scale(counts[player][Piece::PAWN], material[player],
+					material[1 - player]);
+		entry.endgame = Endgames::find(key);
+	}
+
+private:
+
+	/* Without pawns, a small material advantage is usually not enough to win. */
+	static int scale(int pawns, int material, int enemyMaterial)
+	{
+		if (pawns > 1 || material - enemyMaterial > Scores::PIECE_VALUES[Piece::BISHOP])
+			return SCALE_NORMAL;
+		if (pawns == 1)
+			return SCALE_NORMAL * 3 / 4;
+		if (material < Scores::PIECE_VALUES[Piece::ROOK])
+			return 0;
+		return enemyMaterial <= Scores::PIECE_VALUES[Piece::BISHOP] ? 4 : 14;
+	}
+};
+
+}
@@ -11,6 +11,8 @@
 #include "GameState.h"
 #include "Move.h"
 #include "Config.h"
+#include "Tablebase.h"
+#include "Syzygy.h"
 #include <algorithm>
 #include <string>
 #include <vector>
@@ -18,6 +20,7 @@
 #include <exception>
 #include <cmath>
 #include <atomic>
+#include <array>
 
 namespace mnc {
 
@@ -25,7 +28,8 @@ class InfoCallback
 {
 public:
 
-	virtual void notifyPv(unsigned depth, int score, const std::vector<Move>& pv)
+	virtual void notifyPv(unsigned multiPv, unsigned depth, unsigned selDepth, int score,
+			uint64_t nodes, double time, const std::vector<Move>& pv)
 	{
 	}
 
@@ -56,6 +60,12 @@ private:
 
 	static constexpr unsigned MAX_SEARCH_DEPTH = 100;
 
+	// Minimum depth for trying singular extension.
+	static constexpr int SINGULAR_EXTENSION_DEPTH = 8;
+
+	// Score margin below the transposition table score that other moves must fail to reach.
+	static constexpr int SINGULAR_EXTENSION_MARGIN = 50;
+
 	// Don't let clock run lower than this because of timing inaccuracies, random delays etc.
 	static constexpr double CLOCK_SAFETY_MARGIN = 0.1;
 
@@ -64,6 +74,24 @@ private:
 
 	static constexpr unsigned REP_TBL_MASK = REP_TBL_SIZE - 1;
 
+	static constexpr unsigned MAX_MULTI_PV = 64;
+
+	// Mate search results are stored in the transposition table with keys that are xor'ed with
+	// this value, because a failed mate search doesn't give a valid bound for normal search.
+	static constexpr uint64_t MATE_SEARCH_KEY = 0x9e3779b97f4a7c15ull;
+
+	/* Root move with statistics from the latest iteration that are used for ordering. */
+	struct RootMove
+	{
+		Move move;
+
+		// Score if the move was the best one at some point of the search, otherwise -INF.
+		int score;
+
+		// Number of nodes in the subtree of the move.
+		uint64_t nodes;
+	};
+
 	unsigned mQuiescenceSearchDepth;
 
 	TranspositionTable<StateInfo> mTrposTbl;
@@ -100,13 +128,62 @@ private:
 	int mScore;
 
 	// Moves from sibling nodes that cause beta cutoff.
-	std::vector<std::array<Move, 2 >> mKillerMoves;
+	std::vector<std::array<PackedMove, 2 >> mKillerMoves;
 
 	// Simple hash table for doing a quick preliminary check of repeated positions. Each entry
 	// holds the number of positions in that bucket. If zero, it is not necessary to call
 	// GameState::isRepeatedState().
 	uint8_t mRepetitionTable[REP_TBL_SIZE];
 
+	// Game positions before the root that are counted in the repetition table, and the ply of the
+	// first one. The counts are updated for the next root instead of rebuilding the table.
+	std::vector<uint64_t> mRepetitionIds;
+
+	unsigned mRepetitionStart;
+
+	// Set when a search is stopped. The path of the stopped search is then left in the
+	// repetition table, so it has to be rebuilt.
+	bool mRepetitionTableDirty;
+
+	// Number of principal variations searched and reported.
+	unsigned mMultiPv;
+
+	// Index of the PV line that is currently being searched.
+	unsigned mPvIdx;
+
+	// Triangular table for collecting the principal variation during search. Row n holds the PV
+	// of the current node at ply n, starting from column n.
+	std::vector<std::array<Move, MAX_SEARCH_DEPTH + 1 >> mPvTable;
+
+	std::vector<unsigned> mPvLengths;
+
+	// Maximum ply reached in current iteration.
+	unsigned mSelDepth;
+
+	// Depth of current iteration. Check and singular extensions are done only below ply
+	// 2 * mRootDepth, so that they can't extend a line without bound.
+	unsigned mRootDepth;
+
+	// Legal moves at root. After each PV line has been searched the remaining moves are sorted
+	// by score and node count, so that the first mPvIdx moves are the best moves of the previous
+	// lines and the rest are in a good order for the next line or iteration.
+	std::vector<RootMove> mRootMoves;
+
+	// Move that is skipped at each ply. Set only during singular extension searches.
+	std::vector<Move> mExcludedMoves;
+
+	// Endgame tablebases probed during search, or null.
+	std::shared_ptr<const Tablebases> mTablebases;
+
+	// Syzygy tablebases, or null.
+	std::shared_ptr<const Syzygy> mSyzygy;
+
+	unsigned mSyzygyProbeLimit;
+
+	// Maximum number of pieces for probing Syzygy WDL tables in current search. Zero if the root
+	// moves were already filtered with DTZ tables.
+	unsigned mSyzygyPieces;
+
 public:
 
 	MinMaxAI(InfoCallback* infoCallback = nullptr, size_t transpositionTableBytes = 32 * (1 << 20),
@@ -124,11 +201,30 @@ public:
 	mBestMove(),
 	mStopped(ATOMIC_FLAG_INIT),
 	mScore(0),
-	mKillerMoves(MAX_SEARCH_DEPTH + 1)
+	mKillerMoves(MAX_SEARCH_DEPTH + 1),
+	mRepetitionStart(0),
+	mRepetitionTableDirty(true),
+	mMultiPv(1),
+	mPvIdx(0),
+	mPvTable(MAX_SEARCH_DEPTH + 1),
+	mPvLengths(MAX_SEARCH_DEPTH + 1),
+	mSelDepth(0),
+	mRootDepth(0),
+	mExcludedMoves(MAX_SEARCH_DEPTH + 1),
+	mSyzygyProbeLimit(Syzygy::MAX_PIECES),
+	mSyzygyPieces(0)
 	{
 	}
 
 	virtual Move getMove(const GameState& state, const TimeConstraint& tc) override
+	{
+		return getMove(state, tc, std::vector<Move>());
+	}
+
+	/* Restricts the search to the given root moves. All legal moves are searched if the list is
+	 * empty. */
+	Move getMove(const GameState& state, const TimeConstraint& tc,
+			const std::vector<Move>& searchMoves)
 	{
 		mTree = SearchTreeNode();
 		mEvaluator.reset(state);
@@ -138,12 +234,35 @@ public:
 		mNodeCount = 0;
 		mEffectiveBranchingFactor = 0.0;
 		mBestMove = Move(); // none
+		std::fill(mExcludedMoves.begin(), mExcludedMoves.end(), Move());
 		GameState stateCopy = state;
 		mStopped = false;
 		mTotalNodeCount = 0;
 		mScore = 0;
 		setupTimeConstraint(tc, state.activePlayer());
 
+		initRootMoves(stateCopy, searchMoves);
+		if (mRootMoves.empty()) {
+			mScore = state.isKingChecked(state.activePlayer()) ? -Scores::MATE : Scores::DRAW;
+			return Move();
+		}
+		mSyzygyPieces = mSyzygy ? std::min(mSyzygyProbeLimit, mSyzygy->maxPieces()) : 0;
+		if (bitCount((uint64_t) state.board()()) <= mSyzygyPieces && filterRootMoves(stateCopy))
+			mSyzygyPieces = 0;
+
+		// In mate search mode fall back to a normal search of the same length if no mate is found
+		// with checking moves.
+		if (mTimeConstraint.mate) {
+			try {
+				if (findMate(stateCopy))
+					return mBestMove;
+			} catch (StoppedException& e) {
+				return mBestMove;
+			}
+			if (!mTimeConstraint.depth)
+				mTimeConstraint.depth = 2 * mTimeConstraint.mate - 1;
+		}
+
 		unsigned maxDepth = std::min((unsigned) MAX_SEARCH_DEPTH,
 				mTimeConstraint.depth ? mTimeConstraint.depth : (unsigned) - 1);
 		maxDepth = std::max(1u + (mQuiescenceSearchDepth == 0), maxDepth);
@@ -165,6 +284,12 @@ public:
 		return mNodeCount;
 	}
 
+	/* Number of nodes searched by the latest getMove() in all iterations. */
+	uint64_t totalNodeCount() const
+	{
+		return mTotalNodeCount;
+	}
+
 	double effectiveBranchingFactor() const
 	{
 		return mEffectiveBranchingFactor;
@@ -180,6 +305,37 @@ public:
 		mStopped = true;
 	}
 
+	/* Sets the number of best lines searched at root. Lines after the first one are searched with
+	 * the root moves of earlier lines excluded. */
+	void setMultiPv(unsigned multiPv)
+	{
+		mMultiPv = std::max(1u, std::min(multiPv, (unsigned) MAX_MULTI_PV));
+	}
+
+	unsigned multiPv() const
+	{
+		return mMultiPv;
+	}
+
+	/* Uses NNUE evaluation with given weights, or the piece-square evaluation if null. */
+	void setNnue(std::shared_ptr<const NnueWeights> weights)
+	{
+		mEvaluator.setNnue(weights);
+	}
+
+	/* Uses exact scores from the tablebases for positions they contain, or none if null. */
+	void setTablebases(std::shared_ptr<const Tablebases> tablebases)
+	{
+		mTablebases = tablebases;
+	}
+
+	/* Uses Syzygy tablebases (or none if null) for positions with at most probeLimit pieces. */
+	void setSyzygy(std::shared_ptr<const Syzygy> syzygy, unsigned probeLimit = Syzygy::MAX_PIECES)
+	{
+		mSyzygy = syzygy;
+		mSyzygyProbeLimit = probeLimit;
+	}
+
 	virtual bool cmd(const std::string& c)
 	{
 		if (c == "hashinfo") {
@@ -191,7 +347,18 @@ public:
 						<< " hashcap " << mTrposTbl.capacity()
 						<< " hashcutoffs " << mTrposTblCutoffs
 						<< " hashlookups " << mTrposTbl.lookups()
-						<< " hashwrites " << mTrposTbl.writes();
+						<< " hashhits " << mTrposTbl.hits()
+						<< " hashwrites " << mTrposTbl.writes()
+						<< " pawnhashcap " << mEvaluator.pawnHashTable().capacity()
+						<< " pawnhashlookups " << mEvaluator.pawnHashTable().lookups()
+						<< " pawnhashhits " << mEvaluator.pawnHashTable().hits()
+						<< " materialhashlookups " << mEvaluator.materialTable().lookups()
+						<< " materialhashhits " << mEvaluator.materialTable().hits()
+						<< " evalcachecap " << mEvaluator.evalCache().capacity()
+						<< " evalcachelookups " << mEvaluator.evalCache().lookups()
+						<< " evalcachehits " << mEvaluator.evalCache().hits()
+						<< " evals " << mEvaluator.evaluations()
+						<< " lazyevals " << mEvaluator.lazyEvaluations();
 				mInfoCallback->notifyString(ss.str());
 			}
 			return true;
@@ -206,28 +373,195 @@ private:
 		unsigned prevNodeCount = mNodeCount;
 		mNodeCount = 0;
 		mPly = 0;
-		mResults[0].bestMove = Move();
+		mSelDepth = 0;
+		mRootDepth = depth;
 		mTreeGenerator.clear();
 		mEvaluator.reset(state);
 
-		try {
-			createNodeAndSearch<false>(depth, -Scores::INF, Scores::INF, state, Move());
-		} catch (StoppedException& e) {
-			return false;
+		for (RootMove& rm : mRootMoves) {
+			rm.score = -Scores::INF;
+			rm.nodes = 0;
 		}
 
+		// Each PV line is searched separately, excluding the root moves of the previous lines.
+		// Later lines are cheap because they share the transposition table with the first one.
+		unsigned lineCount = std::min<size_t>(mMultiPv, mRootMoves.size());
+		for (mPvIdx = 0; mPvIdx < lineCount; ++mPvIdx) {
+			mResults[0].bestMove = Move();
+			try {
+				createNodeAndSearch<false>(depth, -Scores::INF, Scores::INF, state, Move());
+			} catch (StoppedException& e) {
+				return false;
+			}
+			sortRootMoves(mPvIdx);
+		}
+		mPvIdx = 0;
+
 		mTotalNodeCount += mNodeCount;
 		mTree = mTreeGenerator.getTree();
 		mEffectiveBranchingFactor = (double) mNodeCount / (prevNodeCount ? prevNodeCount : 1);
 
 		if (mInfoCallback) {
-			mInfoCallback->notifyIterDone(depth, mResults[0].score, mTotalNodeCount,
+			mInfoCallback->notifyIterDone(depth, mRootMoves[0].score, mTotalNodeCount,
 					mTrposTbl.size(), mTrposTbl.capacity());
 		}
 
 		return true;
 	}
 
+	/* Searches mate by increasing the number of moves one at a time. Returns true if a mate was
+	 * found within the limit of the time constraint. */
+	bool findMate(GameState& state)
+	{
+		// Allow stopping at any time.
+		mBestMove = mRootMoves[0].move;
+
+		unsigned maxMoves = std::min(mTimeConstraint.mate, (MAX_SEARCH_DEPTH + 1) / 2);
+		for (unsigned moves = 1; moves <= maxMoves; ++moves) {
+			mPly = 0;
+			mSelDepth = 0;
+			int depth = 2 * moves - 1;
+			if (mateSearch(depth, Scores::getCheckMateScore(moves), state)
+					>= Scores::getCheckMateScore(moves)) {
+				notifyNewPv(depth, mResults[0].score);
+				mTotalNodeCount += mNodeCount;
+				return true;
+			}
+		}
+
+		mTotalNodeCount += mNodeCount;
+		return false;
+	}
+
+	/* Zero window search for proving a mate, i.e. a score of at least beta. The attacker (player
+	 * to move at root) only plays checking moves, so the score is a valid bound only if it is a
+	 * mate score. */
+	int mateSearch(int depth, int beta, GameState& state)
+	{
+		assert(Scores::isValid(beta));
+
+		mPvLengths[mPly] = mPly;
+		mSelDepth = std::max(mSelDepth, mPly);
+
+		// Check time limit periodically.
+		if ((mNodeCount & 0xfff) == 0)
+			checkTimeLimit();
+		++mNodeCount;
+
+		if (mRepetitionTable[state.id() & REP_TBL_MASK] && state.isRepeatedState() && mPly > 0)
+			return Scores::DRAW;
+
+		// A proven mate is valid for any depth but other bounds only for the same or lower depth.
+		uint64_t id = state.id() ^ MATE_SEARCH_KEY;
+		const StateInfo* info = mTrposTbl.get(id);
+		if (info && mPly > 0) {
+			bool lower = info->nodeType == NodeType::LOWER_BOUND;
+			bool proof = lower ? info->score > Scores::CHECK_MATE_THRESHOLD
+					: info->score < -Scores::CHECK_MATE_THRESHOLD;
+			if ((proof || info->depth >= depth) && (lower == (info->score >= beta))) {
+#if CM_EXTRA_INFO
+				++mTrposTblCutoffs;
+#endif
+				return info->score;
+			}
+		}
+		Move tpTblMove = info ? state.unpackMove(info->bestMove) : Move();
+
+		// Adjust search window due to mate delay penalty.
+		beta += beta > Scores::CHECK_MATE_THRESHOLD;
+
+		mResults[mPly].id = id;
+		mResults[mPly].nodeType = NodeType::UPPER_BOUND;
+		mResults[mPly].score = -Scores::INF;
+		mResults[mPly].bestMove = Move();
+
+		++mRepetitionTable[state.id() & REP_TBL_MASK];
+
+		bool legalMoves = false;
+		searchMateMoves(depth, beta, state, tpTblMove, legalMoves);
+
+		--mRepetitionTable[state.id() & REP_TBL_MASK];
+
+		// Check mate and stale mate recognition. Attacker without checking moves gets a draw
+		// score, which is not a real bound but means that there is no mate.
+		if (!legalMoves) {
+			mResults[mPly].score = state.isKingChecked(state.activePlayer()) ? -Scores::MATE
+					: Scores::DRAW;
+		} else if (!mResults[mPly].bestMove) {
+			mResults[mPly].score = Scores::DRAW;
+		}
+
+		// Delay penalty for mates.
+		mResults[mPly].score -= mResults[mPly].score > Scores::CHECK_MATE_THRESHOLD;
+
+		addTranspositionTableEntry(depth, mResults[mPly]);
+
+		return mResults[mPly].score;
+	}
+
+	/* Searches the moves of a mate search node until beta cutoff. */
+	void searchMateMoves(int depth, int beta, GameState& state, Move tpTblMove, bool& legalMoves)
+	{
+		if (mPly == 0) {
+			for (const RootMove& rm : mRootMoves) {
+				if (searchMateMove(depth, beta, state, rm.move, legalMoves))
+					return;
+			}
+			return;
+		}
+
+		if (tpTblMove && searchMateMove(depth, beta, state, tpTblMove, legalMoves))
+			return;
+
+		mMoveLists[mPly].populate(state, false, mKillerMoves[mPly]);
+		for (unsigned pri = 0; pri < MoveList::PRIORITIES; ++pri) {
+			unsigned count = mMoveLists[mPly].getCount(pri);
+			for (unsigned i = 0; i < count; ++i) {
+				Move move = mMoveLists[mPly].getMove(pri, i);
+				if (move != tpTblMove && searchMateMove(depth, beta, state, move, legalMoves))
+					return;
+			}
+		}
+	}
+
+	/* Searches a single move in mate search. Returns true in case of beta cutoff. */
+	bool searchMateMove(int depth, int beta, GameState& state, Move move, bool& legalMoves)
+	{
+		++mPly;
+		Player pl = state.activePlayer();
+		state.makeMove(move);
+		bool illegal = state.isKingChecked(pl);
+		bool check = !illegal && state.isKingChecked(state.activePlayer());
+		legalMoves |= !illegal;
+
+		// Attacker plays only checking moves. Defender with no plies left only needs to have a
+		// legal move to avoid the mate.
+		int score = -Scores::INF;
+		bool attacker = mPly % 2 == 1;
+		if (!illegal && (check || !attacker)) {
+			if (attacker || depth > 0) {
+				score = -mateSearch(depth - 1, 1 - beta, state);
+			} else {
+				mPvLengths[mPly] = mPly;
+				score = Scores::DRAW;
+			}
+		}
+
+		state.undoMove(move);
+		--mPly;
+
+		if (score > mResults[mPly].score) {
+			mResults[mPly].score = score;
+			mResults[mPly].bestMove = move;
+			updatePv(move);
+			if (score >= beta) {
+				mResults[mPly].nodeType = NodeType::LOWER_BOUND;
+				return true;
+			}
+		}
+		return false;
+	}
+
 	template<bool tQs>
 	int createNodeAndSearch(int depth, int alpha, int beta, GameState& state, Move move)
 	{
@@ -259,6 +593,9 @@ private:
 		assert(std::abs(mEvaluator.getScore()) < Scores::CHECK_MATE_THRESHOLD);
 		assert(mPly > 0);
 
+		mPvLengths[mPly] = mPly;
+		mSelDepth = std::max(mSelDepth, mPly);
+
 		// Check time limit periodically.
 		if ((mNodeCount & 0xfff) == 0)
 			checkTimeLimit();
@@ -279,10 +616,12 @@ private:
 #endif
 			return info->score;
 		}
-		Move bestMove = info && info->bestMove.isCapture() ? info->bestMove : Move();
+		Move bestMove = info ? state.unpackMove(info->bestMove) : Move();
+		if (!bestMove.isCapture())
+			bestMove = Move();
 
 		// Stand pat.
-		alpha = std::max(alpha, mEvaluator.getScore());
+		alpha = std::max(alpha, mEvaluator.evaluate(state, alpha, beta));
 		if (alpha >= beta || mPly >= MAX_SEARCH_DEPTH ||
 				(unsigned) -depth >= mQuiescenceSearchDepth)
 			return alpha; // No need to adjust; stand pat can't have mate score.
@@ -292,7 +631,7 @@ private:
 		beta += beta > Scores::CHECK_MATE_THRESHOLD;
 
 		// Search captures.
-		alpha = searchMoves<true>(depth, alpha, beta, state, bestMove, false /*(ignored)*/);
+		alpha = searchMoves<true>(depth, alpha, beta, state, bestMove, 0);
 
 		// Delay penalty for mates.
 		alpha -= alpha > Scores::CHECK_MATE_THRESHOLD;
@@ -311,6 +650,9 @@ private:
 		if (depth <= 0)
 			return quiescenceSearch(depth, alpha, beta, state);
 
+		mPvLengths[mPly] = mPly;
+		mSelDepth = std::max(mSelDepth, mPly);
+
 		// Check time limit periodically.
 		if ((mNodeCount & 0xfff) == 0)
 			checkTimeLimit();
@@ -320,13 +662,54 @@ private:
 		if (mRepetitionTable[state.id() & REP_TBL_MASK] && state.isRepeatedState() && mPly > 0)
 			return Scores::DRAW;
 
+		// Draw is a lower bound if the active player can repeat an earlier position. That takes at
+		// least 3 reversible plies, which most nodes don't have.
+		if (mPly > 0 && alpha < Scores::DRAW && state.reversiblePlies() >= 3
+				&& state.hasUpcomingRepetition()) {
+			alpha = Scores::DRAW;
+			if (alpha >= beta)
+				return alpha;
+		}
+
 		if (mPly >= MAX_SEARCH_DEPTH)
-			return mEvaluator.getScore();
+			return mEvaluator.evaluate(state);
+
+		// Exact score from tablebases. (Not at root so that the search always produces a move.)
+		int tbScore;
+		if (mTablebases && mPly > 0 && mTablebases->probe(state, tbScore)) {
+			mResults[mPly].bestMove = Move();
+			mResults[mPly].score = tbScore;
+			return tbScore;
+		}
+
+		// Win, draw or loss from Syzygy tablebases after captures and pawn moves, when the
+		// 50-move rule counter doesn't affect the result.
+		int wdl;
+		if (mPly > 0 && state.halfMoveClock() == 0
+				&& bitCount((uint64_t) state.board()()) <= mSyzygyPieces
+				&& mSyzygy->probeWdl(state, wdl)) {
+			mResults[mPly].bestMove = Move();
+			mResults[mPly].score = wdl > Syzygy::CURSED_WIN ? Scores::TABLEBASE_WIN
+					: wdl < Syzygy::BLESSED_LOSS ? -Scores::TABLEBASE_WIN : Scores::DRAW;
+			return mResults[mPly].score;
+		}
+
+		// Known draws, e.g. king and pawn against king when the pawn can't be promoted.
+		int endgameScore;
+		bool exact;
+		if (mPly > 0 && mEvaluator.evaluateEndgame(state, endgameScore, exact) && exact) {
+			mResults[mPly].bestMove = Move();
+			mResults[mPly].score = endgameScore;
+			return endgameScore;
+		}
 
 		// Check if we can get the result from transposition table. If not then we can still used
-		// the best stored move.
+		// the best stored move. Cutoffs are not done at root so that the search always produces
+		// a principal variation (and because in multi-PV mode the entry would be valid only for
+		// the first line). The entry is not valid when a move is excluded.
+		Move excludedMove = mExcludedMoves[mPly];
 		const StateInfo* info = mTrposTbl.get(state.id());
-		if (info && info->depth >= depth) {
+		if (info && info->depth >= depth && mPly > 0 && !excludedMove) {
 			if (info->nodeType == NodeType::EXACT
 					|| (info->nodeType == NodeType::LOWER_BOUND && info->score >= beta)
 					|| (info->nodeType == NodeType::UPPER_BOUND && info->score <= alpha)) {
@@ -335,18 +718,23 @@ private:
 #if CM_EXTRA_INFO
 				++mTrposTblCutoffs;
 #endif
-				if (mPly == 0)
-					notifyNewPv(state, info->bestMove, depth, info->score);
 				return info->score;
 			}
 		}
-		Move bestMove = info ? info->bestMove : Move();
+		Move bestMove = excludedMove ? excludedMove
+				: info ? state.unpackMove(info->bestMove) : Move();
 
 		// Check extension.
 		bool checked = state.isKingChecked(state.activePlayer());
-		if (checked)
+		bool extend = mPly < 2 * mRootDepth;
+		if (checked && extend)
 			++depth;
 
+		// Singular extension for the best move from transposition table if it is clearly better
+		// than the others.
+		int singularExtension = extend && info && !excludedMove && mPly > 0
+				&& isSingular(depth, *info, state);
+
 		// Adjust search window due to mate delay penalty.
 		alpha += alpha > Scores::CHECK_MATE_THRESHOLD;
 		beta += beta > Scores::CHECK_MATE_THRESHOLD;
@@ -361,24 +749,32 @@ private:
 		++mRepetitionTable[state.id() & REP_TBL_MASK];
 
 		// Reduce depth if we still get beta cutoff after null move.
-		if (!checked)
+		if (!checked && !excludedMove)
 			depth = applyNullMoveReduction(depth, beta, state);
 
 		// Search all moves.
-		searchMoves<false>(depth, alpha, beta, state, bestMove, checked);
+		if (mPly == 0)
+			searchRootMoves(depth, alpha, beta, state);
+		else
+			searchMoves<false>(depth, alpha, beta, state, bestMove, singularExtension);
 
 		--mRepetitionTable[state.id() & REP_TBL_MASK];
 
-		// Check mate & stale mate recognition.
-		if (!mResults[mPly].bestMove)
-			mResults[mPly].score = checked ? -Scores::MATE : Scores::DRAW;
+		// Check mate & stale mate recognition. If the only move is excluded, fail low.
+		if (!mResults[mPly].bestMove) {
+			mResults[mPly].score = excludedMove ? alpha : checked ? -Scores::MATE
+					: Scores::DRAW;
+			if (excludedMove)
+				return mResults[mPly].score;
+		}
 
 		// Delay penalty for mates.
 		mResults[mPly].score -= mResults[mPly].score > Scores::CHECK_MATE_THRESHOLD;
 
 		// Only insert in transposition table after searching, because position may be repeated
 		// during search. Stored depth must be the original depth without check extension.
-		addTranspositionTableEntry(depth - checked, mResults[mPly]);
+		if ((mPly > 0 || mPvIdx == 0) && !excludedMove)
+			addTranspositionTableEntry(depth - (checked && extend), mResults[mPly]);
 
 		assert(Scores::isValid(mResults[mPly].score));
 		assert(mResults[mPly].bestMove || mResults[mPly].score == -Scores::MATE ||
@@ -394,16 +790,42 @@ private:
 		return createNodeAndSearch<tQs>(depth, beta - 1, beta, state, move);
 	}
 
+	/* Checks whether all moves except the best move from transposition table fail low with a
+	 * reduced depth search against a margin below the stored score. */
+	bool isSingular(int depth, const StateInfo& info, GameState& state)
+	{
+		if (depth < SINGULAR_EXTENSION_DEPTH || !info.bestMove
+				|| info.nodeType == NodeType::UPPER_BOUND || info.depth < depth - 3
+				|| std::abs(info.score) > Scores::CHECK_MATE_THRESHOLD)
+			return false;
+
+		int singularBeta = info.score - SINGULAR_EXTENSION_MARGIN;
+		mExcludedMoves[mPly] = state.unpackMove(info.bestMove);
+		int score;
+		try {
+			score = search(depth / 2, singularBeta - 1, singularBeta, state);
+		} catch (StoppedException& e) {
+			mExcludedMoves[mPly] = Move();
+			throw;
+		}
+		mExcludedMoves[mPly] = Move();
+		return score < singularBeta;
+	}
+
+	/* Searches the best move from transposition table (unless it is excluded) with the given
+	 * extension and then the rest of the moves. */
 	template<bool tQs>
-	int searchMoves(int depth, int alpha, int beta, GameState& state, Move tpTblMove, bool checked)
+	int searchMoves(int depth, int alpha, int beta, GameState& state, Move tpTblMove,
+			int tpTblMoveExtension)
 	{
 		assert(alpha < beta);
 		assert(!Scores::isInf(alpha));
 		assert(!Scores::isInf(-beta));
 
 		// If earlier best move was found in transposition table, try it first.
-		if (tpTblMove) {
-			alpha = std::max(alpha, searchMove<tQs>(depth, alpha, beta, state, tpTblMove));
+		if (tpTblMove && tpTblMove != mExcludedMoves[mPly]) {
+			alpha = std::max(alpha, searchMove<tQs>(depth + tpTblMoveExtension, alpha, beta,
+					state, tpTblMove));
 			if (alpha >= beta)
 				return alpha;
 		}
@@ -439,13 +861,17 @@ private:
 		// Make move.
 		++mPly;
 		Player pl = state.activePlayer();
+		Sqr enPassantSqr = state.enPassantSqr();
 		state.makeMove(move);
 		if (state.isKingChecked(pl)) {
 			state.undoMove(move);
 			--mPly;
 			return -Scores::INF;
 		}
-		mEvaluator.makeMove(move);
+		mEvaluator.makeMove(move, enPassantSqr);
+#if CM_CHECK_EVALUATOR
+		assert(mEvaluator.isConsistent(state));
+#endif
 
 		// Continue search recursively.
 		int score;
@@ -478,9 +904,10 @@ private:
 				mResults[mPly].score = score;
 				mResults[mPly].bestMove = move;
 				if (score > alpha) {
+					updatePv(move);
 					if (mPly == 0) {
 						int adjustedScore = score - (score > Scores::CHECK_MATE_THRESHOLD);
-						notifyNewPv(state, move, depth, adjustedScore);
+						notifyNewPv(depth, adjustedScore);
 					}
 					if (score >= beta) {
 						mResults[mPly].nodeType = NodeType::LOWER_BOUND;
@@ -495,13 +922,93 @@ private:
 				}
 			}
 		} else {
-			if (score > alpha)
+			if (score > alpha) {
+				updatePv(move);
 				alpha = score;
+			}
 		}
 
 		return alpha;
 	}
 
+	/* Searches the root moves in the order of the root move list, skipping the best moves of the
+	 * previous PV lines. Keeps track of the score and node count of each move. */
+	void searchRootMoves(int depth, int alpha, int beta, GameState& state)
+	{
+		for (size_t i = mPvIdx; i < mRootMoves.size(); ++i) {
+			RootMove& rm = mRootMoves[i];
+			unsigned nodeCount = mNodeCount;
+			alpha = std::max(alpha, searchMove<false>(depth, alpha, beta, state, rm.move));
+			rm.nodes += mNodeCount - nodeCount;
+			if (mResults[0].bestMove == rm.move) {
+				int score = mResults[0].score;
+				rm.score = score - (score > Scores::CHECK_MATE_THRESHOLD);
+			}
+			if (alpha >= beta)
+				break;
+		}
+	}
+
+	/* Creates the list of legal root moves. Initially the moves are ordered by the normal move list
+	 * priorities, except that the best move from transposition table is placed first. */
+	void initRootMoves(GameState& state, const std::vector<Move>& searchMoves)
+	{
+		mRootMoves.clear();
+		mMoveLists[0].populate(state, false);
+		for (unsigned pri = 0; pri < MoveList::PRIORITIES; ++pri) {
+			for (unsigned i = 0; i < mMoveLists[0].getCount(pri); ++i) {
+				Move move = mMoveLists[0].getMove(pri, i);
+				if (!searchMoves.empty()
+						&& std::find(searchMoves.begin(), searchMoves.end(), move) == searchMoves.end())
+					continue;
+				if (state.isLegalMove2(move))
+					mRootMoves.push_back(RootMove{move, -Scores::INF, 0});
+			}
+		}
+
+		const StateInfo* info = mTrposTbl.get(state.id());
+		if (info) {
+			auto it = std::find_if(mRootMoves.begin(), mRootMoves.end(),
+					[info](const RootMove & rm) {
+						return info->bestMove == rm.move;
+					});
+			if (it != mRootMoves.end())
+				std::rotate(mRootMoves.begin(), it, it + 1);
+		}
+	}
+
+	/* Keeps only the root moves with the best result according to Syzygy DTZ tables (the ones
+	 * that win fastest, or draw, or lose slowest). Returns false if the tables don't have the
+	 * position. */
+	bool filterRootMoves(GameState& state)
+	{
+		std::vector<Move> moves;
+		std::vector<int> ranks;
+		for (const RootMove& rm : mRootMoves)
+			moves.push_back(rm.move);
+		if (!mSyzygy->rankRootMoves(state, moves, ranks))
+			return false;
+		int bestRank = *std::max_element(ranks.begin(), ranks.end());
+		size_t count = 0;
+		for (size_t i = 0; i < mRootMoves.size(); ++i) {
+			if (ranks[i] == bestRank)
+				mRootMoves[count++] = mRootMoves[i];
+		}
+		mRootMoves.resize(count);
+		return true;
+	}
+
+	/* Sorts the root moves starting from given index. Moves that have been the best move during
+	 * the search come first in the order of their scores, and rest are ordered by the size of
+	 * their subtrees. */
+	void sortRootMoves(size_t startIdx)
+	{
+		std::stable_sort(mRootMoves.begin() + startIdx, mRootMoves.end(),
+				[](const RootMove& a, const RootMove & b) {
+					return a.score > b.score || (a.score == b.score && a.nodes > b.nodes);
+				});
+	}
+
 	/* Reduces depth if beta cutoff can still be achieved with null move search. */
 	int applyNullMoveReduction(int depth, int beta, GameState& state)
 	{
@@ -520,12 +1027,44 @@ private:
 		return depth;
 	}
 
+	/* Counts the game positions since the last irreversible move. Positions of the previous root
+	 * that are still in the game keep their counts, so usually only the moves played since then
+	 * are added. */
 	void initRepetitionTable(const GameState& state)
 	{
-		std::fill(std::begin(mRepetitionTable), std::end(mRepetitionTable), 0);
+		if (mRepetitionTableDirty) {
+			std::fill(std::begin(mRepetitionTable), std::end(mRepetitionTable), 0);
+			mRepetitionIds.clear();
+			mRepetitionTableDirty = false;
+		}
+
+		// Remove positions before the first reversible one and from the first difference on.
 		unsigned start = state.ply() - std::min(state.halfMoveClock(), state.ply());
-		for (unsigned i = start; i < state.ply(); ++i)
+		size_t front = 0, end = 0;
+		if (start >= mRepetitionStart && start - mRepetitionStart < mRepetitionIds.size()) {
+			front = end = start - mRepetitionStart;
+			size_t maxEnd = std::min<size_t>(mRepetitionIds.size(), state.ply() - mRepetitionStart);
+			while (end < maxEnd && mRepetitionIds[end] == state.id(mRepetitionStart + end))
+				++end;
+		}
+		for (size_t i = 0; i < front; ++i)
+			--mRepetitionTable[mRepetitionIds[i] & REP_TBL_MASK];
+		for (size_t i = end; i < mRepetitionIds.size(); ++i)
+			--mRepetitionTable[mRepetitionIds[i] & REP_TBL_MASK];
+		if (end == front) {
+			mRepetitionIds.clear();
+			mRepetitionStart = start;
+		} else {
+			mRepetitionIds.resize(end);
+			mRepetitionIds.erase(mRepetitionIds.begin(), mRepetitionIds.begin() + front);
+			mRepetitionStart += front;
+		}
+
+		// Add the positions played since.
+		for (unsigned i = mRepetitionStart + mRepetitionIds.size(); i < state.ply(); ++i) {
+			mRepetitionIds.push_back(state.id(i));
 			++mRepetitionTable[state.id(i) & REP_TBL_MASK];
+		}
 	}
 
 	void addTranspositionTableEntry(int depth, StateInfo& result)
@@ -540,8 +1079,13 @@ private:
 	{
 		auto dur = std::chrono::high_resolution_clock::now() - mStartTime;
 		double t = std::chrono::duration_cast<std::chrono::microseconds>(dur).count() * 1e-6;
-		if ((mStopped || (mTimeConstraint.time != 0 && t > mTimeConstraint.time)) && mBestMove)
+		bool nodesLeft = mTimeConstraint.nodes == 0
+				|| mTotalNodeCount + mNodeCount < mTimeConstraint.nodes;
+		if ((mStopped || (mTimeConstraint.time != 0 && t > mTimeConstraint.time) || !nodesLeft)
+				&& mBestMove) {
+			mRepetitionTableDirty = true;
 			throw StoppedException();
+		}
 	}
 
 	void setupTimeConstraint(const TimeConstraint& tc, Player player)
@@ -566,38 +1110,36 @@ private:
 		//mInfoCallback->notifyString("Time limit: " + std::to_string(mTimeConstraint.time));
 	}
 
+	/* Sets PV of current node to be the given move followed by the PV of the child node. */
+	void updatePv(Move move)
+	{
+		unsigned childLength = mPvLengths[mPly + 1];
+		mPvTable[mPly][mPly] = move;
+		for (unsigned i = mPly + 1; i < childLength; ++i)
+			mPvTable[mPly][i] = mPvTable[mPly + 1][i];
+		mPvLengths[mPly] = std::max(childLength, mPly + 1);
+	}
+
 	/* Called when found a new best move at ply 0. We can always store it as a the new best overall
 	 * move because the best move from previous ID iteration is always searched first (thanks to
-	 * transposition table). I.e. completing an iteration is not necessary.
-	 * 
-	 * Finds the principal variation for output from transposition table. This method is not very
-	 * reliable but better than nothing. */
-	void notifyNewPv(GameState& state, Move firstMove, int depth, int score)
+	 * transposition table). I.e. completing an iteration is not necessary. In multi-PV mode only
+	 * the first line determines the best move. */
+	void notifyNewPv(int depth, int score)
 	{
-		assert(firstMove);
+		assert(mPvLengths[0] > 0);
 		assert(depth > 0);
 
-		mBestMove = firstMove;
-		mScore = score;
+		if (mPvIdx == 0) {
+			mBestMove = mPvTable[0][0];
+			mScore = score;
+		}
 
 		if (mInfoCallback) {
-			std::vector<Move> pv{firstMove};
-			for (Move move = firstMove;;) {
-				state.makeMove(move);
-				const StateInfo* info = mTrposTbl.get(state.id());
-				if (!info || info->nodeType != NodeType::EXACT)
-					break;
-				if (std::find(pv.begin(), pv.end(), info->bestMove) != pv.end())
-					break;
-				assert(info->bestMove);
-				pv.push_back(info->bestMove);
-				move = info->bestMove;
-			}
-
-			for (auto it = pv.rbegin(); it != pv.rend(); ++it)
-				state.undoMove(*it);
-
-			mInfoCallback->notifyPv(depth, score, pv);
+			std::vector<Move> pv(mPvTable[0].begin(), mPvTable[0].begin() + mPvLengths[0]);
+			auto dur = std::chrono::high_resolution_clock::now() - mStartTime;
+			double t = std::chrono::duration_cast<std::chrono::microseconds>(dur).count() * 1e-6;
+			mInfoCallback->notifyPv(mPvIdx + 1, depth, mSelDepth, score,
+					mTotalNodeCount + mNodeCount, t, pv);
 		}
 	}
 };
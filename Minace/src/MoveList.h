@@ -43,7 +43,7 @@ private:
 public:
 
 	void populate(const GameState& state, bool excludeQuietMoves,
-			const std::array<Move, 2>& killerMoves = std::array<Move, 2>())
+			const std::array<PackedMove, 2>& killerMoves = std::array<PackedMove, 2>())
 	{
 		Player player = state.activePlayer();
 		clear();
@@ -86,7 +86,7 @@ public:
 private:
 
 	void addMoves(const GameState& state, Piece pieceType, Mask pieces, Piece newType,
-			bool excludeQuietMoves, const std::array<Move, 2>& killerMoves)
+			bool excludeQuietMoves, const std::array<PackedMove, 2>& killerMoves)
 	{
 		Player player = state.activePlayer();
 		Mask enPassantMask = getEnPassantMask(state);
@@ -123,7 +123,7 @@ private:
 	}
 
 	void add(Piece pieceType, Sqr fromSqr, Sqr toSqr, Piece capturedType, Piece newType,
-			const std::array<Move, 2>& killerMoves)
+			const std::array<PackedMove, 2>& killerMoves)
 	{
 		Move move = Move(fromSqr, toSqr, pieceType, capturedType, newType);
 		unsigned priority = QUIET_MOVE_PRIORITY;
@@ -131,7 +131,7 @@ private:
 			priority = CAPTURE_PRIORITIES[pieceType][capturedType];
 		else if (newType != pieceType)
 			priority = PROMOTION_PRIORITIES[newType];
-		else if (move == killerMoves[0] || move == killerMoves[1])
+		else if (killerMoves[0] == move || killerMoves[1] == move)
 			priority = KILLER_MOVE_PRIORITY;
 		unsigned idx = moveCounts[priority]++;
 		moves[priority][idx] = move;
@@ -0,0 +1,467 @@
+#pragma once
+
+#include "Player.h"
+#include "Piece.h"
+#include "Sqr.h"
+#include "Move.h"
+#include "BitBoard.h"
+#include "Intrinsics.h"
+#include <vector>
+#include <string>
+#include <istream>
+#include <ostream>
+#include <random>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include <cassert>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace mnc {
+
+/**
+ * Parameters of the efficiently updatable neural network. The input layer has HalfKP features
+ * (own king square x non-king piece x square) for both players, and its output (the accumulator)
+ * is followed by a quantized two layer perceptron:
+ * 2 x HIDDEN int16 -> clipped ReLU -> L1 int8 weights -> clipped ReLU -> 1 int8 weights.
+ *
+ * File format (little endian): "MNCNNUE1", dimensions FEATURES, HIDDEN and L1 as uint32, and then
+ * featureWeights, featureBiases, hiddenWeights, hiddenBiases, outputWeights and outputBias.
+ */
+class NnueWeights
+{
+public:
+	static constexpr unsigned FEATURES = Sqr::COUNT * 10 * Sqr::COUNT;
+
+	static constexpr unsigned HIDDEN = 128;
+
+	static constexpr unsigned L1 = 32;
+
+	// Weights of feature n are at featureWeights[n * HIDDEN].
+	std::vector<int16_t> featureWeights;
+
+	std::vector<int16_t> featureBiases;
+
+	// Weights of neuron n are at hiddenWeights[n * 2 * HIDDEN].
+	std::vector<int8_t> hiddenWeights;
+
+	std::vector<int32_t> hiddenBiases;
+
+	std::vector<int8_t> outputWeights;
+
+	int32_t outputBias;
+
+	NnueWeights()
+	: featureWeights(FEATURES * HIDDEN), featureBiases(HIDDEN), hiddenWeights(L1 * 2 * HIDDEN),
+	hiddenBiases(L1), outputWeights(L1), outputBias(0)
+	{
+	}
+
+	/* Random network for testing and benchmarking. */
+	static std::shared_ptr<NnueWeights> random(uint64_t seed)
+	{
+		std::shared_ptr<NnueWeights> weights(new NnueWeights());
+		std::mt19937_64 rng(seed);
+		std::uniform_int_distribution<int> featureDist(-32, 32), layerDist(-127, 127);
+		for (int16_t& w : weights->featureWeights)
+			w = featureDist(rng);
+		for (int16_t& b : weights->featureBiases)
+			b = featureDist(rng);
+		for (int8_t& w : weights->hiddenWeights)
+			w = layerDist(rng);
+		for (int32_t& b : weights->hiddenBiases)
+			b = layerDist(rng) * 64;
+		for (int8_t& w : weights->outputWeights)
+			w = layerDist(rng);
+		weights->outputBias = layerDist(rng);
+		return weights;
+	}
+
+	static std::shared_ptr<NnueWeights> load(std::istream& is)
+	{
+		char magic[8];
+		uint32_t dims[3];
+		is.read(magic, sizeof magic);
+		is.read(reinterpret_cast<char*> (dims), sizeof dims);
+		if (!is || memcmp(magic, fileMagic(), sizeof magic) != 0)
+			throw std::runtime_error("Invalid NNUE file.");
+		if (dims[0] != FEATURES || dims[1] != HIDDEN || dims[2] != L1)
+			throw std::runtime_error("Unsupported NNUE dimensions.");
+
+		std::shared_ptr<NnueWeights> weights(new NnueWeights());
+		read(is, weights->featureWeights);
+		read(is, weights->featureBiases);
+		read(is, weights->hiddenWeights);
+		read(is, weights->hiddenBiases);
+		read(is, weights->outputWeights);
+		is.read(reinterpret_cast<char*> (&weights->outputBias), sizeof weights->outputBias);
+		if (!is)
+			throw std::runtime_error("Truncated NNUE file.");
+		return weights;
+	}
+
+	void save(std::ostream& os) const
+	{
+		uint32_t dims[3] = {FEATURES, HIDDEN, L1};
+		os.write(fileMagic(), 8);
+		os.write(reinterpret_cast<const char*> (dims), sizeof dims);
+		write(os, featureWeights);
+		write(os, featureBiases);
+		write(os, hiddenWeights);
+		write(os, hiddenBiases);
+		write(os, outputWeights);
+		os.write(reinterpret_cast<const char*> (&outputBias), sizeof outputBias);
+	}
+
+private:
+
+	static const char* fileMagic()
+	{
+		return "MNCNNUE1";
+	}
+
+	template<typename T>
+	static void read(std::istream& is, std::vector<T>& values)
+	{
+		is.read(reinterpret_cast<char*> (values.data()), values.size() * sizeof (T));
+	}
+
+	template<typename T>
+	static void write(std::ostream& os, const std::vector<T>& values)
+	{
+		os.write(reinterpret_cast<const char*> (values.data()), values.size() * sizeof (T));
+	}
+};
+
+/**
+ * NNUE evaluation. Keeps a stack of accumulators (the input layer output for both perspectives),
+ * which is updated incrementally by adding and subtracting the weights of the changed features.
+ * When a king moves all features of its perspective change, so that perspective is only marked
+ * dirty and recalculated from the board when the position is evaluated.
+ *
+ * Accumulator updates and the first hidden layer use AVX2 (or SSE2 for the accumulator) when
+ * available. The scalar code gives exactly the same results and can be selected with setSimd().
+ */
+class Nnue
+{
+private:
+	static constexpr unsigned HIDDEN = NnueWeights::HIDDEN;
+
+	static constexpr unsigned L1 = NnueWeights::L1;
+
+	static constexpr int HIDDEN_SHIFT = 6;
+
+	static constexpr int OUTPUT_SCALE = 16;
+
+	static constexpr int CLIP_MAX = 127;
+
+	struct Accumulator
+	{
+		int16_t values[Player::COUNT][HIDDEN];
+
+		Sqr kingSqrs[Player::COUNT];
+
+		bool dirty[Player::COUNT];
+	};
+
+	std::shared_ptr<const NnueWeights> mWeights;
+
+	std::vector<Accumulator> mAccumulators;
+
+	unsigned mPly;
+
+	bool mSimd;
+
+public:
+
+	Nnue(std::shared_ptr<const NnueWeights> weights, size_t maxDepth)
+	: mWeights(weights), mAccumulators(maxDepth + 1), mPly(0), mSimd(true)
+	{
+	}
+
+	void setSimd(bool simd)
+	{
+		mSimd = simd;
+	}
+
+	void reset(const BitBoard& board)
+	{
+		mPly = 0;
+		for (unsigned i = 0; i < Player::COUNT; ++i)
+			refresh(board, Player(i));
+	}
+
+	/* Updates the accumulators after player has made the move. En passant square must be the one
+	 * before the move. */
+	void makeMove(Player player, Move move, Sqr enPassantSqr)
+	{
+		assert(mPly + 1 < mAccumulators.size());
+		const Accumulator& prev = mAccumulators[mPly];
+		Accumulator& acc = mAccumulators[++mPly];
+
+		Sqr fromSqr = move.fromSqr();
+		Sqr toSqr = move.toSqr();
+		Piece pieceType = move.pieceType();
+		Piece capturedType = move.capturedType();
+		bool castling = pieceType == Piece::KING && ((fromSqr - toSqr) & 3) == 2;
+
+		for (unsigned i = 0; i < Player::COUNT; ++i) {
+			Player perspective(i);
+			acc.kingSqrs[i] = prev.kingSqrs[i];
+			acc.dirty[i] = prev.dirty[i];
+			if (pieceType == Piece::KING && player == perspective) {
+				acc.kingSqrs[i] = toSqr;
+				acc.dirty[i] = true;
+			}
+			if (acc.dirty[i])
+				continue;
+
+			unsigned added[2], removed[2];
+			unsigned addCount = 0, removeCount = 0;
+			Sqr kingSqr = acc.kingSqrs[i];
+			if (pieceType != Piece::KING) {
+				removed[removeCount++] = featureIndex(perspective, kingSqr, player, pieceType,
+						fromSqr);
+				added[addCount++] = featureIndex(perspective, kingSqr, player, move.newType(),
+						toSqr);
+			}
+			if (capturedType) {
+				Sqr capturedSqr = toSqr;
+				if (pieceType == Piece::PAWN && toSqr == enPassantSqr)
+					capturedSqr = Sqr(toSqr + 8 - 16 * player);
+				removed[removeCount++] = featureIndex(perspective, kingSqr, ~player, capturedType,
+						capturedSqr);
+			}
+			if (castling) {
+				bool queenSide = toSqr.col() == 2;
+				Sqr rookFromSqr(8 * toSqr.row() + (queenSide ? 0 : 7));
+				Sqr rookToSqr(8 * toSqr.row() + (queenSide ? 3 : 5));
+				removed[removeCount++] = featureIndex(perspective, kingSqr, player, Piece::ROOK,
+						rookFromSqr);
+				added[addCount++] = featureIndex(perspective, kingSqr, player, Piece::ROOK,
+						rookToSqr);
+			}
+
+			if (mSimd)
+				update<true>(prev.values[i], acc.values[i], added, addCount, removed, removeCount);
+			else
+				update<false>(prev.values[i], acc.values[i], added, addCount, removed, removeCount);
+		}
+	}
+
+	void makeNullMove()
+	{
+		assert(mPly + 1 < mAccumulators.size());
+		mAccumulators[mPly + 1] = mAccumulators[mPly];
+		++mPly;
+	}
+
+	void undoMove()
+	{
+		assert(mPly > 0);
+		--mPly;
+	}
+
+	/* Score from the active player's point of view. The board must match the current position. */
+	int evaluate(const BitBoard& board, Player activePlayer)
+	{
+		Accumulator& acc = mAccumulators[mPly];
+		for (unsigned i = 0; i < Player::COUNT; ++i) {
+			if (acc.dirty[i])
+				refresh(board, Player(i));
+		}
+
+		uint8_t input[2 * HIDDEN];
+		int32_t output;
+		if (mSimd) {
+			clip<true>(acc.values[activePlayer], input);
+			clip<true>(acc.values[~activePlayer], input + HIDDEN);
+			output = propagate<true>(input);
+		} else {
+			clip<false>(acc.values[activePlayer], input);
+			clip<false>(acc.values[~activePlayer], input + HIDDEN);
+			output = propagate<false>(input);
+		}
+		return output / OUTPUT_SCALE;
+	}
+
+	/* Checks that the accumulators that are not dirty equal accumulators calculated from scratch. */
+	bool isConsistent(const BitBoard& board) const
+	{
+		const Accumulator& acc = mAccumulators[mPly];
+		for (unsigned i = 0; i < Player::COUNT; ++i) {
+			int16_t values[HIDDEN];
+			calculate(board, Player(i), values);
+			if (!acc.dirty[i] && memcmp(values, acc.values[i], sizeof values) != 0)
+				return false;
+		}
+		return true;
+	}
+
+	static unsigned featureIndex(Player perspective, Sqr kingSqr, Player player, Piece pieceType,
+			Sqr sqr)
+	{
+		// Black's perspective is mirrored vertically.
+		unsigned flip = perspective == Player::WHITE ? 0 : 56;
+		unsigned piece = (player != perspective) * 5 + pieceType - 1;
+		return ((kingSqr ^ flip) * 10 + piece) * Sqr::COUNT + (sqr ^ flip);
+	}
+
+private:
+
+	void refresh(const BitBoard& board, Player perspective)
+	{
+		Accumulator& acc = mAccumulators[mPly];
+		acc.kingSqrs[perspective] = Sqr(countTrailingZeros(
+				(uint64_t) board(perspective, Piece::KING)));
+		calculate(board, perspective, acc.values[perspective]);
+		acc.dirty[perspective] = false;
+	}
+
+	void calculate(const BitBoard& board, Player perspective, int16_t* values) const
+	{
+		Sqr kingSqr(countTrailingZeros((uint64_t) board(perspective, Piece::KING)));
+		std::copy(mWeights->featureBiases.begin(), mWeights->featureBiases.end(), values);
+		for (unsigned i = 0; i < Player::COUNT; ++i) {
+			for (unsigned pieceType = 1; pieceType < Piece::COUNT; ++pieceType) {
+				for (Sqr sqr : board(Player(i), Piece(pieceType))) {
+					unsigned feature = featureIndex(perspective, kingSqr, Player(i),
+							Piece(pieceType), sqr);
+					const int16_t* w = &mWeights->featureWeights[feature * HIDDEN];
+					for (unsigned j = 0; j < HIDDEN; ++j)
+						values[j] += w[j];
+				}
+			}
+		}
+	}
+
+	template<bool SIMD>
+	void update(const int16_t* in, int16_t* out, const unsigned* added, unsigned addCount,
+			const unsigned* removed, unsigned removeCount) const
+	{
+		const int16_t* weights = mWeights->featureWeights.data();
+#if defined(__AVX2__)
+		if (SIMD) {
+			for (unsigned j = 0; j < HIDDEN; j += 16) {
+				__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*> (in + j));
+				for (unsigned k = 0; k < addCount; ++k)
+					v = _mm256_add_epi16(v, _mm256_loadu_si256(reinterpret_cast<const __m256i*> (
+							weights + added[k] * HIDDEN + j)));
+				for (unsigned k = 0; k < removeCount; ++k)
+					v = _mm256_sub_epi16(v, _mm256_loadu_si256(reinterpret_cast<const __m256i*> (
+							weights + removed[k] * HIDDEN + j)));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*> (out + j), v);
+			}
+			return;
+		}
+#elif defined(__SSE2__)
+		if (SIMD) {
+			for (unsigned j = 0; j < HIDDEN; j += 8) {
+				__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*> (in + j));
+				for (unsigned k = 0; k < addCount; ++k)
+					v = _mm_add_epi16(v, _mm_loadu_si128(reinterpret_cast<const __m128i*> (
+							weights + added[k] * HIDDEN + j)));
+				for (unsigned k = 0; k < removeCount; ++k)
+					v = _mm_sub_epi16(v, _mm_loadu_si128(reinterpret_cast<const __m128i*> (
+							weights + removed[k] * HIDDEN + j)));
+				_mm_storeu_si128(reinterpret_cast<__m128i*> (out + j), v);
+			}
+			return;
+		}
+#endif
+		for (unsigned j = 0; j < HIDDEN; ++j) {
+			int16_t v = in[j];
+			for (unsigned k = 0; k < addCount; ++k)
+				v += weights[added[k] * HIDDEN + j];
+			for (unsigned k = 0; k < removeCount; ++k)
+				v -= weights[removed[k] * HIDDEN + j];
+			out[j] = v;
+		}
+	}
+
+	/* Clipped ReLU from int16 accumulator values to [0, CLIP_MAX]. */
+	template<bool SIMD>
+	static void clip(const int16_t* in, uint8_t* out)
+	{
+#if defined(__AVX2__)
+		if (SIMD) {
+			const __m256i zero = _mm256_setzero_si256();
+			for (unsigned j = 0; j < HIDDEN; j += 32) {
+				__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*> (in + j));
+				__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*> (in + j + 16));
+				// Packing interleaves the 128-bit lanes, so they are permuted back in order.
+				__m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(a, b), 0xd8);
+				_mm256_storeu_si256(reinterpret_cast<__m256i*> (out + j),
+						_mm256_max_epi8(packed, zero));
+			}
+			return;
+		}
+#endif
+		for (unsigned j = 0; j < HIDDEN; ++j)
+			out[j] = std::max(0, std::min((int) in[j], (int) CLIP_MAX));
+	}
+
+	template<bool SIMD>
+	int32_t propagate(const uint8_t* input) const
+	{
+		const NnueWeights& w = *mWeights;
+		int32_t sums[L1];
+		affine<SIMD>(input, sums);
+		int32_t output = w.outputBias;
+		for (unsigned n = 0; n < L1; ++n) {
+			int32_t hidden = std::max(0, std::min(sums[n] >> HIDDEN_SHIFT, (int32_t) CLIP_MAX));
+			output += hidden * w.outputWeights[n];
+		}
+		return output;
+	}
+
+	/* Hidden layer sums including biases. */
+	template<bool SIMD>
+	void affine(const uint8_t* input, int32_t* sums) const
+	{
+		const NnueWeights& w = *mWeights;
+#if defined(__AVX2__)
+		if (SIMD) {
+			// Products of input in [0, 127] and int8 weights fit the int16 pair sums of maddubs.
+			// Four neurons are summed at a time, so that the horizontal adds can be shared.
+			const __m256i ones = _mm256_set1_epi16(1);
+			for (unsigned n = 0; n < L1; n += 4) {
+				__m256i acc[4];
+				for (unsigned k = 0; k < 4; ++k) {
+					const int8_t* weights = &w.hiddenWeights[(n + k) * 2 * HIDDEN];
+					acc[k] = _mm256_setzero_si256();
+					for (unsigned j = 0; j < 2 * HIDDEN; j += 32) {
+						__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*> (input + j));
+						__m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*> (weights + j));
+						acc[k] = _mm256_add_epi32(acc[k],
+								_mm256_madd_epi16(_mm256_maddubs_epi16(x, y), ones));
+					}
+				}
+				__m256i s = _mm256_hadd_epi32(_mm256_hadd_epi32(acc[0], acc[1]),
+						_mm256_hadd_epi32(acc[2], acc[3]));
+				__m128i r = _mm_add_epi32(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+				r = _mm_add_epi32(r, _mm_loadu_si128(reinterpret_cast<const __m128i*> (
+						&w.hiddenBiases[n])));
+				_mm_storeu_si128(reinterpret_cast<__m128i*> (sums + n), r);
+			}
+			return;
+		}
+#endif
+		for (unsigned n = 0; n < L1; ++n) {
+			const int8_t* weights = &w.hiddenWeights[n * 2 * HIDDEN];
+			int32_t sum = w.hiddenBiases[n];
+			for (unsigned j = 0; j < 2 * HIDDEN; ++j)
+				sum += input[j] * weights[j];
+			sums[n] = sum;
+		}
+	}
+};
+
+}
@@ -1,8 +1,10 @@
 #pragma once
 
+#include <cstdint>
+
 namespace mnc {
 
-enum class NodeType : unsigned
+enum class NodeType : uint8_t
 {
     NONE = 0,
     EXACT = 1,
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "Logger.h"
+#include <string>
+
+namespace mnc {
+
+/**
+ * Logger that discards all messages.
+ */
+class NullLogger : public Logger
+{
+public:
+
+	virtual void logMessage(const std::string&) override
+	{
+	}
+};
+
+}
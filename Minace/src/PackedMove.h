@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Move.h"
+#include "Sqr.h"
+#include "Piece.h"
+#include <cstdint>
+
+namespace mnc {
+
+/* 16-bit move for transposition table entries and killer moves. Holds the from and to squares
+ * (6 bits each) and the promotion type (3 bits, zero if not a promotion). The moving and captured
+ * piece types are restored from the board by GameState::unpackMove(). */
+class PackedMove
+{
+private:
+	uint16_t mValue;
+
+public:
+
+	constexpr PackedMove()
+	: mValue(0)
+	{
+	}
+
+	constexpr PackedMove(Move move)
+	: mValue(move.fromSqr() | move.toSqr() << 6
+			| (move.isPromotion() ? (unsigned) move.newType() << 12 : 0))
+	{
+	}
+
+	constexpr Sqr fromSqr() const
+	{
+		return Sqr(mValue & 0x3f);
+	}
+
+	constexpr Sqr toSqr() const
+	{
+		return Sqr(mValue >> 6 & 0x3f);
+	}
+
+	/* New piece type of a promotion, or NONE. */
+	constexpr Piece promotionType() const
+	{
+		return mValue >> 12 ? Piece(mValue >> 12 & 0x7) : Piece::NONE;
+	}
+
+	friend constexpr bool operator==(PackedMove lhs, PackedMove rhs)
+	{
+		return lhs.mValue == rhs.mValue;
+	}
+
+	friend constexpr bool operator!=(PackedMove lhs, PackedMove rhs)
+	{
+		return lhs.mValue != rhs.mValue;
+	}
+
+	explicit constexpr operator bool() const
+	{
+		return !!mValue;
+	}
+};
+
+}
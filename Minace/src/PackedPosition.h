@@ -0,0 +1,95 @@
+#pragma once
+
+#include "GameState.h"
+#include "BitBoard.h"
+#include "Piece.h"
+#include "Player.h"
+#include "Sqr.h"
+#include "Mask.h"
+#include "Intrinsics.h"
+#include <algorithm>
+#include <cstdint>
+
+namespace mnc {
+
+/**
+ * Position with search score and game result packed into 32 bytes for training data files. The
+ * pieces are stored as one nibble per occupied square (bit 3 = black, bits 0-2 = piece type) in
+ * the order of the occupied squares. Multi-byte fields are written in native byte order.
+ */
+struct PackedPosition
+{
+	static constexpr uint8_t NO_EN_PASSANT = 0xff;
+
+	uint64_t occupied;
+
+	uint8_t pieces[16];
+
+	// Search score from the active player's point of view.
+	int16_t score;
+
+	// 0 = black wins, 1 = draw, 2 = white wins.
+	uint8_t result;
+
+	// Bit 0: active player. Bits 1-4: castling rights for rooks at a1, h1, a8 and h8.
+	uint8_t flags;
+
+	uint8_t enPassantSqr;
+
+	uint8_t halfMoveClock;
+
+	// Always zero. GameState has no move number, so the game ply is not stored.
+	uint8_t reserved[2];
+
+	static PackedPosition pack(const GameState& state, int score, unsigned result)
+	{
+		PackedPosition p = PackedPosition();
+		const BitBoard& board = state.board();
+		p.occupied = (uint64_t) board();
+		unsigned i = 0;
+		for (Sqr sqr : board()) {
+			unsigned nibble = board.getPieceType(sqr) | (board.getPlayer(sqr) << 3);
+			p.pieces[i / 2] |= nibble << 4 * (i % 2);
+			++i;
+		}
+		p.score = std::max(-32767, std::min(score, 32767));
+		p.result = result;
+		p.flags = state.activePlayer();
+		for (unsigned j = 0; j < 4; ++j) {
+			if (state.castlingRights() & Mask(castlingRookSqr(j)))
+				p.flags |= 2 << j;
+		}
+		p.enPassantSqr = state.enPassantSqr() ? (uint8_t) state.enPassantSqr() : NO_EN_PASSANT;
+		p.halfMoveClock = std::min(state.halfMoveClock(), 255u);
+		return p;
+	}
+
+	GameState unpack() const
+	{
+		BitBoard board;
+		unsigned i = 0;
+		for (uint64_t m = occupied; m; m &= m - 1) {
+			unsigned nibble = pieces[i / 2] >> 4 * (i % 2);
+			board.addPiece(Player(nibble >> 3 & 1), Piece(nibble & 7), Sqr(countTrailingZeros(m)));
+			++i;
+		}
+		Mask castlingRights;
+		for (unsigned j = 0; j < 4; ++j) {
+			if (flags & 2 << j)
+				castlingRights |= Mask(castlingRookSqr(j));
+		}
+		return GameState(board, Player(flags & 1), castlingRights,
+				enPassantSqr == NO_EN_PASSANT ? Sqr::NONE : Sqr(enPassantSqr), halfMoveClock);
+	}
+
+private:
+
+	static Sqr castlingRookSqr(unsigned idx)
+	{
+		return Sqr(idx < 2 ? 56 + 7 * idx : 7 * (idx - 2));
+	}
+};
+
+static_assert(sizeof (PackedPosition) == 32, "PackedPosition must be 32 bytes.");
+
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Util.h"
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+
+namespace mnc {
+
+/**
+ * Hash table for caching pawn structure scores by the pawn zobrist code. Pawn structure changes
+ * rarely during search, so a small always-replace table gives a very high hit rate.
+ */
+class PawnHashTable
+{
+private:
+
+	struct Entry
+	{
+		uint64_t id;
+
+		int score;
+	};
+
+	std::vector<Entry> mEntries;
+
+	size_t mMask;
+
+	uint64_t mLookups, mHits;
+
+public:
+
+	explicit PawnHashTable(size_t capacityBytes)
+	: mLookups(0), mHits(0)
+	{
+		size_t capacity = roundUpToPowerOfTwo(capacityBytes / sizeof (Entry) + 1) / 2;
+		if (capacity == 0)
+			throw std::invalid_argument("Capacity too small.");
+		mEntries = std::vector<Entry>(capacity, Entry{0, 0});
+		mMask = capacity - 1;
+	}
+
+	/* Gets the score for given pawn zobrist code. Returns false if not found. */
+	bool get(uint64_t id, int& score)
+	{
+		++mLookups;
+		const Entry& entry = mEntries[id & mMask];
+		if (entry.id != id)
+			return false;
+		++mHits;
+		score = entry.score;
+		return true;
+	}
+
+	void put(uint64_t id, int score)
+	{
+		mEntries[id & mMask] = Entry{id, score};
+	}
+
+	size_t capacity() const
+	{
+		return mEntries.size();
+	}
+
+	uint64_t lookups() const
+	{
+		return mLookups;
+	}
+
+	uint64_t hits() const
+	{
+		return mHits;
+	}
+};
+
+}
@@ -0,0 +1,353 @@
+#pragma once
+
+#include "GameState.h"
+#include "Epd.h"
+#include "Move.h"
+#include "Piece.h"
+#include "Player.h"
+#include "Sqr.h"
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <utility>
+#include <stdexcept>
+#include <cctype>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+
+namespace mnc {
+
+/* Game read from or written to PGN. */
+struct PgnGame
+{
+	std::vector<std::pair<std::string, std::string>> tags;
+
+	GameState startState;
+
+	std::vector<Move> moves;
+
+	// "1-0", "0-1", "1/2-1/2" or "*".
+	std::string result = "*";
+
+	std::string tag(const std::string& name) const
+	{
+		for (const auto& t : tags) {
+			if (t.first == name)
+				return t.second;
+		}
+		return "";
+	}
+};
+
+/**
+ * Reads games from PGN one at a time, so arbitrarily large files can be processed in constant
+ * memory. Moves are in standard algebraic notation (SAN) and are matched against the legal moves
+ * of the position. Comments, variations and numeric annotation glyphs are skipped.
+ */
+class PgnReader
+{
+private:
+
+	std::istream& mIs;
+
+	std::string mLine;
+
+	bool mHasLine;
+
+	size_t mLineNumber;
+
+	size_t mMaxPly;
+
+public:
+
+	/* Only the first maxPly moves of each game are parsed, the rest are skipped. */
+	explicit PgnReader(std::istream& is, size_t maxPly = SIZE_MAX)
+	: mIs(is), mHasLine(false), mLineNumber(0), mMaxPly(maxPly)
+	{
+	}
+
+	/* Reads the next game. Returns false at the end of input. Throws std::invalid_argument if the
+	 * game cannot be parsed; the reader then continues from the next game. */
+	bool next(PgnGame& game)
+	{
+		game = PgnGame();
+
+		// Tag pairs
+		bool tagsFound = false;
+		while (readLine()) {
+			size_t i = mLine.find_first_not_of(" \t\r");
+			if (i == std::string::npos || mLine[i] == '%')
+				continue;
+			if (mLine[i] != '[') {
+				mHasLine = true;
+				break;
+			}
+			tagsFound = true;
+			size_t q1 = mLine.find('"', i), q2 = mLine.rfind('"');
+			if (q1 == std::string::npos || q2 <= q1)
+				continue;
+			std::string name = mLine.substr(i + 1, mLine.find_first_of(" \t", i) - i - 1);
+			game.tags.emplace_back(name, mLine.substr(q1 + 1, q2 - q1 - 1));
+		}
+		if (!tagsFound && !mHasLine)
+			return false;
+
+		std::string fen = game.tag("FEN");
+		if (!fen.empty())
+			game.startState = GameState(Epd(fen));
+
+		// Move text
+		GameState state = game.startState;
+		std::string error;
+		int commentDepth = 0, variationDepth = 0;
+		bool done = false;
+		while (!done && readLine()) {
+			if (mLine.find_first_not_of(" \t\r") != std::string::npos
+					&& mLine[mLine.find_first_not_of(" \t\r")] == '[' && !commentDepth) {
+				// Next game started without a result.
+				mHasLine = true;
+				break;
+			}
+			std::stringstream ss(mLine);
+			std::string token;
+			while (ss >> token) {
+				if (commentDepth) {
+					if (token.find('}') != std::string::npos)
+						commentDepth = 0;
+					continue;
+				}
+				if (token[0] == ';')
+					break;
+				if (token[0] == '{') {
+					commentDepth = token.find('}') == std::string::npos;
+					continue;
+				}
+				if (token.find_first_of("()") != std::string::npos) {
+					for (char c : token)
+						variationDepth += (c == '(') - (c == ')');
+					continue;
+				}
+				if (variationDepth || token[0] == '$')
+					continue;
+				if (token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*") {
+					game.result = token;
+					done = true;
+					break;
+				}
+
+				// Strip move number ("12." or "12..."). Digits not followed by a dot are kept so
+				// that castling can be written as "0-0".
+				size_t i = 0;
+				while (i < token.size() && isdigit(token[i]))
+					++i;
+				if (i < token.size() && token[i] != '.')
+					i = 0;
+				while (i < token.size() && token[i] == '.')
+					++i;
+				if (i == token.size() || !error.empty() || game.moves.size() >= mMaxPly)
+					continue;
+				try {
+					Move move = parseSan(state, token.substr(i));
+					state.makeMove(move);
+					game.moves.push_back(move);
+				} catch (const std::invalid_argument& e) {
+					error = e.what();
+				}
+			}
+		}
+
+		if (!error.empty())
+			throw std::invalid_argument(error + " (line " + std::to_string(mLineNumber) + ")");
+		return true;
+	}
+
+private:
+
+	bool readLine()
+	{
+		if (mHasLine) {
+			mHasLine = false;
+			return true;
+		}
+		if (!std::getline(mIs, mLine))
+			return false;
+		++mLineNumber;
+		return true;
+	}
+
+public:
+
+	/* Parses move in standard algebraic notation. */
+	static Move parseSan(GameState& state, const std::string& san)
+	{
+		std::string s = san;
+		while (!s.empty() && (s.back() == '+' || s.back() == '#' || s.back() == '!'
+				|| s.back() == '?'))
+			s.pop_back();
+
+		std::vector<Move> moves;
+		if (s == "O-O" || s == "0-0" || s == "O-O-O" || s == "0-0-0") {
+			unsigned col = s.size() == 3 ? 6 : 2;
+			getLegalMoves(state, Piece::KING, moves);
+			for (Move move : moves) {
+				if (move.pieceType() == Piece::KING && move.fromSqr().col() == 4
+						&& move.toSqr().col() == col)
+					return move;
+			}
+			throw std::invalid_argument("Illegal move " + san + ".");
+		}
+
+		Piece pieceType = Piece::PAWN;
+		size_t begin = 0;
+		if (!s.empty() && std::string("KQRBN").find(s[0]) != std::string::npos)
+			pieceType = Piece(s.substr(begin++, 1));
+
+		Piece newType = pieceType;
+		size_t eq = s.find('=');
+		if (eq != std::string::npos) {
+			newType = Piece(s.substr(eq + 1, 1));
+			s.erase(eq);
+		} else if (pieceType == Piece::PAWN && !s.empty()
+				&& std::string("QRBN").find(s.back()) != std::string::npos) {
+			newType = Piece(s.substr(s.size() - 1));
+			s.pop_back();
+		}
+
+		std::string body;
+		for (size_t i = begin; i < s.size(); ++i) {
+			if (s[i] != 'x' && s[i] != '-' && s[i] != ':')
+				body += s[i];
+		}
+		if (body.size() < 2 || body.size() > 4 || !newType)
+			throw std::invalid_argument("Invalid move " + san + ".");
+		Sqr toSqr(body.substr(body.size() - 2));
+		int fromCol = -1, fromRow = -1;
+		for (size_t i = 0; i + 2 < body.size(); ++i) {
+			if (body[i] >= 'a' && body[i] <= 'h')
+				fromCol = body[i] - 'a';
+			else if (body[i] >= '1' && body[i] <= '8')
+				fromRow = '8' - body[i];
+			else
+				throw std::invalid_argument("Invalid move " + san + ".");
+		}
+
+		Move result;
+		getLegalMoves(state, pieceType, moves);
+		for (Move move : moves) {
+			if (move.toSqr() == toSqr && move.newType() == newType
+					&& (fromCol < 0 || (int) move.fromSqr().col() == fromCol)
+					&& (fromRow < 0 || (int) move.fromSqr().row() == fromRow)) {
+				if (result)
+					throw std::invalid_argument("Ambiguous move " + san + ".");
+				result = move;
+			}
+		}
+		if (!result)
+			throw std::invalid_argument("Illegal move " + san + ".");
+		return result;
+	}
+
+private:
+
+	/* Generates legal moves only for the pieces of given type, which is much faster than
+	 * generating all of them for every move of a game. */
+	static void getLegalMoves(GameState& state, Piece pieceType, std::vector<Move>& moves)
+	{
+		for (Sqr sqr : state.board()(state.activePlayer(), pieceType))
+			state.getLegalMoves(sqr, moves);
+	}
+};
+
+/**
+ * Writes games in PGN.
+ */
+class PgnWriter
+{
+private:
+	static constexpr size_t MAX_LINE_LENGTH = 80;
+
+public:
+
+	static void write(std::ostream& os, const PgnGame& game)
+	{
+		for (const auto& t : game.tags)
+			os << "[" << t.first << " \"" << t.second << "\"]" << std::endl;
+		os << std::endl;
+
+		// Move numbers continue from the full move number of the FEN tag.
+		size_t firstMove = 1;
+		std::string fen = game.tag("FEN");
+		if (fen.find_last_of(' ') != std::string::npos)
+			firstMove = std::max(1ul, std::strtoul(fen.c_str() + fen.find_last_of(' '), nullptr, 10));
+
+		GameState state = game.startState;
+		std::string line;
+		auto add = [&os, &line](const std::string& token) {
+			if (!line.empty() && line.size() + 1 + token.size() > MAX_LINE_LENGTH) {
+				os << line << std::endl;
+				line.clear();
+			}
+			line += (line.empty() ? "" : " ") + token;
+		};
+		for (size_t i = 0; i < game.moves.size(); ++i) {
+			if (state.activePlayer() == Player::WHITE || i == 0) {
+				size_t moveNumber = firstMove
+						+ (i + (game.startState.activePlayer() == Player::BLACK)) / 2;
+				add(std::to_string(moveNumber)
+						+ (state.activePlayer() == Player::WHITE ? "." : "..."));
+			}
+			add(toSan(state, game.moves[i]));
+			state.makeMove(game.moves[i]);
+		}
+		add(game.result);
+		os << line << std::endl << std::endl;
+	}
+
+	/* Converts a legal move to standard algebraic notation. */
+	static std::string toSan(GameState& state, Move move)
+	{
+		std::string san;
+		int colDiff = (int) move.toSqr().col() - (int) move.fromSqr().col();
+		if (move.pieceType() == Piece::KING && (colDiff == 2 || colDiff == -2)) {
+			san = colDiff > 0 ? "O-O" : "O-O-O";
+		} else {
+			std::vector<Move> moves;
+			for (Sqr sqr : state.board()(state.activePlayer(), move.pieceType()))
+				state.getLegalMoves(sqr, moves);
+			bool ambiguous = false, sameCol = false, sameRow = false;
+			for (Move m : moves) {
+				if (m != move && m.pieceType() == move.pieceType() && m.toSqr() == move.toSqr()
+						&& m.fromSqr() != move.fromSqr()) {
+					ambiguous = true;
+					sameCol |= m.fromSqr().col() == move.fromSqr().col();
+					sameRow |= m.fromSqr().row() == move.fromSqr().row();
+				}
+			}
+			std::string from = move.fromSqr().toStr();
+			if (move.pieceType() == Piece::PAWN) {
+				if (move.isCapture())
+					san = from.substr(0, 1);
+			} else {
+				san = move.pieceType().toStr();
+				if (ambiguous)
+					san += !sameCol ? from.substr(0, 1) : !sameRow ? from.substr(1, 1) : from;
+			}
+			if (move.isCapture())
+				san += "x";
+			san += move.toSqr().toStr();
+			if (move.isPromotion())
+				san += "=" + move.newType().toStr();
+		}
+
+		state.makeMove(move);
+		if (state.isKingChecked(state.activePlayer()))
+			san += state.isCheckMate() ? "#" : "+";
+		state.undoMove(move);
+		return san;
+	}
+};
+
+}
@@ -7,6 +7,8 @@
 #include <climits>
 #include <iomanip>
 #include <cmath>
+#include <cstdint>
+#include <algorithm>
 
 namespace mnc {
 
@@ -25,6 +27,12 @@ public:
 
 	static constexpr TScore MATE = 1000000 * 100;
 
+	// Score of a position that is won according to tablebases but without a known mate.
+	static constexpr TScore TABLEBASE_WIN = CHECK_MATE_THRESHOLD / 2;
+
+	// Score of a position that is won by a known technique (see Endgames.h).
+	static constexpr TScore KNOWN_WIN = 10000;
+
 	static constexpr TScore PIECE_VALUES[Piece::COUNT]{
 		MATE,
 		9 * 100,
@@ -34,8 +42,53 @@ public:
 		1 * 100,
 	};
 
+	// Piece values and piece-square tables for middle game and end game. In end game only king and
+	// pawns have their own tables, the others are same as in middle game.
 	static TScore POSITIONAL_PIECE_VALUES[Player::COUNT][Piece::COUNT][Sqr::COUNT];
 
+	static TScore ENDGAME_POSITIONAL_PIECE_VALUES[Player::COUNT][Piece::COUNT][Sqr::COUNT];
+
+	// Middle game and end game values packed together (see makeScore()). King value is not
+	// included, because both players always have a king.
+	static TScore PACKED_POSITIONAL_PIECE_VALUES[Player::COUNT][Piece::COUNT][Sqr::COUNT];
+
+	// Contribution of each piece to the game phase. Phase is MAX_PHASE with all pieces on board
+	// and 0 with only kings and pawns.
+	static constexpr TScore PHASE_WEIGHTS[Piece::COUNT]{0, 4, 2, 1, 1, 0};
+
+	static constexpr TScore MAX_PHASE = 24;
+
+	// Bonus for passed pawn by rank from the player's own side (2nd rank is 1).
+	static constexpr TScore PASSED_PAWN_VALUES[8]{0, 5, 10, 20, 35, 60, 100, 0};
+
+	static constexpr TScore ISOLATED_PAWN_PENALTY = 10;
+
+	// Penalty for each pawn that has another pawn of the same player in front of it.
+	static constexpr TScore DOUBLED_PAWN_PENALTY = 10;
+
+	// Penalty for pawn that can't be defended by other pawns and can't advance safely.
+	static constexpr TScore BACKWARD_PAWN_PENALTY = 8;
+
+	static constexpr TScore BISHOP_PAIR_BONUS = 30;
+
+	// Knights get better and rooks worse with more pawns on board. Adjustment per own pawn above
+	// five.
+	static constexpr TScore KNIGHT_PAWN_BONUS = 6;
+
+	static constexpr TScore ROOK_PAWN_PENALTY = 12;
+
+	// Bonus for each square a piece attacks that is not occupied by own pieces or attacked by
+	// enemy pawns.
+	static constexpr TScore MOBILITY_VALUES[Piece::COUNT]{0, 1, 2, 4, 4, 0};
+
+	// Weight of each square a piece attacks next to the enemy king.
+	static constexpr TScore KING_ATTACK_WEIGHTS[Piece::COUNT]{0, 5, 3, 2, 2, 0};
+
+	// Bonus by the total weight of king attacks. Used only when at least two pieces attack.
+	static constexpr TScore KING_ATTACK_VALUES[16]{
+		0, 1, 2, 4, 6, 9, 12, 16, 20, 25, 30, 36, 42, 49, 56, 64
+	};
+
 	/* Checks that score is not infinite. */
 	static int isValid(int score)
 	{
@@ -48,6 +101,31 @@ public:
 		return score > INF - 10000;
 	}
 
+	/* Packs middle game and end game scores to a single value so that packed scores can be added
+	 * and subtracted with one operation. End game score is in the upper 16 bits. */
+	static constexpr TScore makeScore(int middlegame, int endgame)
+	{
+		return (TScore) ((uint32_t) endgame << 16) + middlegame;
+	}
+
+	static constexpr int middlegameScore(TScore score)
+	{
+		return (int16_t) (uint16_t) score;
+	}
+
+	static constexpr int endgameScore(TScore score)
+	{
+		return (int16_t) (uint16_t) ((uint32_t) (score + 0x8000) >> 16);
+	}
+
+	/* Interpolates packed score by the game phase. */
+	static int taperedScore(TScore score, int phase)
+	{
+		phase = std::min(phase, (int) MAX_PHASE);
+		return (middlegameScore(score) * phase + endgameScore(score) * (MAX_PHASE - phase))
+				/ MAX_PHASE;
+	}
+
 	/* Get score for mate in given number of moves. (Negative if player gets mated. ) */
 	static int getCheckMateScore(int moves)
 	{
@@ -77,10 +155,21 @@ private:
 	{
 		for (unsigned pieceType = 0; pieceType < Piece::COUNT; ++pieceType) {
 			for (unsigned sqr = 0; sqr < 64; ++sqr) {
-				POSITIONAL_PIECE_VALUES[Player::WHITE][pieceType][sqr] += PIECE_VALUES[pieceType];
+				TScore& mg = POSITIONAL_PIECE_VALUES[Player::WHITE][pieceType][sqr];
+				TScore& eg = ENDGAME_POSITIONAL_PIECE_VALUES[Player::WHITE][pieceType][sqr];
+				if (pieceType != Piece::KING && pieceType != Piece::PAWN)
+					eg = mg;
+				mg += PIECE_VALUES[pieceType];
+				eg += PIECE_VALUES[pieceType];
+
 				unsigned blackSqr = (7 - sqr / 8) * 8 + sqr % 8;
-				POSITIONAL_PIECE_VALUES[Player::BLACK][pieceType][blackSqr] =
-						POSITIONAL_PIECE_VALUES[Player::WHITE][pieceType][sqr];
+				POSITIONAL_PIECE_VALUES[Player::BLACK][pieceType][blackSqr] = mg;
+				ENDGAME_POSITIONAL_PIECE_VALUES[Player::BLACK][pieceType][blackSqr] = eg;
+
+				TScore material = pieceType == Piece::KING ? PIECE_VALUES[pieceType] : 0;
+				TScore packed = makeScore(mg - material, eg - material);
+				PACKED_POSITIONAL_PIECE_VALUES[Player::WHITE][pieceType][sqr] = packed;
+				PACKED_POSITIONAL_PIECE_VALUES[Player::BLACK][pieceType][blackSqr] = packed;
 			}
 		}
 	}
@@ -94,7 +183,22 @@ template<typename TScore>
 constexpr TScore Scores_t<TScore>::PIECE_VALUES[Piece::COUNT];
 
 template<typename TScore>
-TScore Scores_t<TScore>::POSITIONAL_PIECE_VALUES[Player::COUNT][Piece::COUNT][Sqr::COUNT]{
+constexpr TScore Scores_t<TScore>::PASSED_PAWN_VALUES[8];
+
+template<typename TScore>
+constexpr TScore Scores_t<TScore>::PHASE_WEIGHTS[Piece::COUNT];
+
+template<typename TScore>
+constexpr TScore Scores_t<TScore>::MOBILITY_VALUES[Piece::COUNT];
+
+template<typename TScore>
+constexpr TScore Scores_t<TScore>::KING_ATTACK_WEIGHTS[Piece::COUNT];
+
+template<typename TScore>
+constexpr TScore Scores_t<TScore>::KING_ATTACK_VALUES[16];
+
+template<typename TScore>
+TScore Scores_t<TScore>::ENDGAME_POSITIONAL_PIECE_VALUES[Player::COUNT][Piece::COUNT][Sqr::COUNT]{
 	{
 		// King
 		{
@@ -107,6 +211,38 @@ TScore Scores_t<TScore>::POSITIONAL_PIECE_VALUES[Player::COUNT][Piece::COUNT][Sq
 			2, 4, 5, 6, 6, 5, 4, 2,
 			0, 2, 3, 4, 5, 4, 3, 0
 		},
+		{}, {}, {}, {},
+		// Pawn
+		{
+			0, 0, 0, 0, 0, 0, 0, 0,
+			20, 20, 20, 20, 20, 20, 20, 20,
+			14, 14, 14, 14, 14, 14, 14, 14,
+			9, 9, 9, 9, 9, 9, 9, 9,
+			5, 5, 5, 5, 5, 5, 5, 5,
+			2, 2, 2, 2, 2, 2, 2, 2,
+			0, 0, 0, 0, 0, 0, 0, 0,
+			0, 0, 0, 0, 0, 0, 0, 0
+		}
+	}
+};
+
+template<typename TScore>
+TScore Scores_t<TScore>::PACKED_POSITIONAL_PIECE_VALUES[Player::COUNT][Piece::COUNT][Sqr::COUNT];
+
+template<typename TScore>
+TScore Scores_t<TScore>::POSITIONAL_PIECE_VALUES[Player::COUNT][Piece::COUNT][Sqr::COUNT]{
+	{
+		// King
+		{
+			-9, -9, -9, -9, -9, -9, -9, -9,
+			-9, -9, -9, -9, -9, -9, -9, -9,
+			-9, -9, -9, -9, -9, -9, -9, -9,
+			-9, -9, -9, -9, -9, -9, -9, -9,
+			-8, -8, -8, -8, -8, -8, -8, -8,
+			-6, -6, -6, -6, -6, -6, -6, -6,
+			2, 2, 0, -2, -2, 0, 2, 2,
+			4, 6, 3, 0, 0, 3, 6, 4
+		},
 		// Queen
 		{
 			0, 2, 3, 4, 4, 3, 2, 0,
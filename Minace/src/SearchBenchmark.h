@@ -0,0 +1,108 @@
+#pragma once
+
+#include "MinMaxAI.h"
+#include "GameGenerator.h"
+#include "GameState.h"
+#include "Epd.h"
+#include "Logger.h"
+#include "TimeConstraint.h"
+#include "Util.h"
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+
+namespace mnc {
+
+/**
+ * Searches a fixed set of positions to a fixed depth, each with a new MinMaxAI so that the
+ * transposition table and other tables start empty. The total node count doesn't depend on time or
+ * on the machine, so it works as a signature of the search: it changes only if the search or
+ * evaluation changes functionally. Speed changes show in the nodes per second.
+ */
+class SearchBenchmark
+{
+public:
+
+	static constexpr unsigned DEFAULT_DEPTH = 6;
+
+	static constexpr size_t HASH_BYTES = 16 << 20;
+
+	struct Result
+	{
+		uint64_t nodes = 0;
+
+		double time = 0;
+	};
+
+private:
+
+	// Openings and endgames generated with fixed seeds complete the set.
+	static constexpr unsigned OPENINGS = 20, RANDOM_GAMES = 6, OPENING_PLIES = 10;
+
+	Logger& mLogger;
+
+	unsigned mDepth;
+
+	std::vector<GameState> mStates;
+
+public:
+
+	SearchBenchmark(Logger& logger, unsigned depth = DEFAULT_DEPTH)
+	: mLogger(logger), mDepth(depth)
+	{
+		const char* positions[] = {
+			"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+			"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+			"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+			"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+			"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+			"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+			"8/k7/3p4/p2P1p2/P2P1P2/8/8/K7 w - - 0 1",
+			"2kr3r/ppp3pp/8/2b1pp2/P1Pn3P/3P1qP1/2PQ1P1R/R3KB2 b Q - 0 1",
+			"r6r/2p2k2/ppp5/6Q1/5P2/3Pq3/PPP3PP/4RR1K b - - 0 1",
+			"3r4/4kp2/pq2p2P/1p2Q3/1P1NN1pb/P7/4b1PK/3R4 w - - 0 1",
+			"r1b2rk1/pp1p1pp1/1b1p2B1/n1qQ2p1/8/5N2/P3RPPP/4R1K1 w - - 0 1",
+			"8/8/p1p5/1p5p/1P5p/8/PPP2K1p/4R1rk w - - 0 1",
+			"8/8/1p1r1k2/p1pPN1p1/P3KnP1/1P6/8/3R4 b - - 0 1",
+			"8/8/5p2/4r2k/5K1P/6QP/8/8 w - - 0 1",
+		};
+		for (const char* fen : positions)
+			mStates.push_back(GameState(Epd(fen)));
+
+		std::mt19937_64 rng(20240101);
+		for (unsigned i = 0; i < OPENINGS; ++i)
+			mStates.push_back(GameGenerator::createOpening(OPENING_PLIES, rng));
+		for (unsigned i = 0; i < RANDOM_GAMES; ++i)
+			mStates.push_back(GameGenerator::createGame(i));
+	}
+
+	size_t size() const
+	{
+		return mStates.size();
+	}
+
+	Result operator ()()
+	{
+		mLogger.logMessage(strFormat(100, "Running search benchmark with %zu positions to depth %u...",
+				mStates.size(), mDepth));
+
+		Result result;
+		for (const GameState& state : mStates) {
+			MinMaxAI ai(nullptr, HASH_BYTES);
+			auto start = std::chrono::high_resolution_clock::now();
+			ai.getMove(state, TimeConstraint(mDepth));
+			std::chrono::duration<double> dur = std::chrono::high_resolution_clock::now() - start;
+			result.nodes += ai.totalNodeCount();
+			result.time += dur.count();
+		}
+
+		mLogger.logMessage(strFormat(100, "Nodes: %llu", (unsigned long long) result.nodes));
+		mLogger.logMessage(strFormat(100, "Time: %.0fms", result.time * 1e3));
+		mLogger.logMessage(strFormat(100, "NPS: %.0f", result.nodes / std::max(result.time, 1e-6)));
+		return result;
+	}
+};
+
+}
@@ -1,94 +1,248 @@
 #pragma once
 
-#include "GamePlayer.h"
+#include "EpdSuite.h"
+#include "MinMaxAI.h"
 #include "Logger.h"
 #include "Epd.h"
 #include "Move.h"
 #include "Util.h"
 #include <vector>
 #include <string>
+#include <istream>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
 #include <initializer_list>
 
 namespace mnc {
 
 /**
  * Allows testing the skill level of an AI by using a set of positions where the best move is known.
+ * The solutions are read from the "bm" and "am" operations of the positions, so WAC or ECM style
+ * EPD files can be used as such. Positions are searched concurrently (see EpdSuite). Besides the
+ * number of solved positions, the time and node count from which the search kept choosing a
+ * solution are reported.
  */
 template<typename T = void>
 class SkillTest_t
 {
 public:
-	static SkillTest_t ZUGZWANG, EASY;
+	static SkillTest_t ZUGZWANG, EASY, MATE;
+
+	/* Outcome of a run. Times (in seconds) and node counts to solution are listed for the solved
+	 * positions in the order they were finished. */
+	struct Result
+	{
+		size_t solved = 0, total = 0;
+
+		std::vector<double> solveTimes;
+
+		std::vector<uint64_t> solveNodes;
+	};
 
 private:
 
-	std::vector<std::pair<std::string, std::string >> mTestPositions;
+	/* Follows the principal variations of a search and records when the search settled on a
+	 * solution. */
+	class SolutionTracker : public InfoCallback
+	{
+	public:
+
+		std::vector<Move> bestMoves, avoidMoves;
+
+		bool settled = false;
+
+		double solveTime = 0, lastTime = 0;
+
+		uint64_t solveNodes = 0, lastNodes = 0;
+
+		bool isSolution(Move move) const
+		{
+			return EpdSuite::isSolution(bestMoves, avoidMoves, move);
+		}
+
+		virtual void notifyPv(unsigned multiPv, unsigned depth, unsigned selDepth, int score,
+				uint64_t nodes, double time, const std::vector<Move>& pv) override
+		{
+			lastTime = time;
+			lastNodes = nodes;
+			if (multiPv != 1 || pv.empty())
+				return;
+			if (!isSolution(pv[0])) {
+				settled = false;
+			} else if (!settled) {
+				settled = true;
+				solveTime = time;
+				solveNodes = nodes;
+			}
+		}
+
+		virtual void notifyIterDone(unsigned depth, int score, uint64_t nodes, size_t hashEntries,
+				size_t hashCapacity) override
+		{
+			lastNodes = nodes;
+		}
+	};
+
+	EpdSuite mTestPositions;
 
 public:
 
-	SkillTest_t(std::initializer_list<std::pair<std::string, std::string >> testPositions)
+	SkillTest_t(std::initializer_list<std::string> testPositions)
 	: mTestPositions(testPositions)
 	{
 	}
 
-	void run(GamePlayer& ai, const TimeConstraint& tc, Logger& logger) const
+	/* Reads positions from EPD lines. Empty lines and lines starting with '#' are skipped. */
+	SkillTest_t(std::istream& is)
+	: mTestPositions(is)
 	{
-		logger.logMessage("Running skill test...");
+	}
 
-		unsigned count[2] = {};
+	size_t size() const
+	{
+		return mTestPositions.size();
+	}
 
-		for (const auto& tp : mTestPositions) {
-			bool r = testPos(tp.first, tp.second, ai, tc, logger);
-			++count[r];
+	Result run(const TimeConstraint& tc, Logger& logger,
+			unsigned threadCount = std::thread::hardware_concurrency(),
+			size_t hashBytes = EpdSuite::DEFAULT_HASH_BYTES) const
+	{
+		threadCount = std::min<size_t>(std::max(1u, threadCount),
+				std::max<size_t>(mTestPositions.size(), 1));
+		logger.logMessage(strFormat(100, "Running skill test with %u threads...", threadCount));
+
+		Result result;
+		std::mutex mutex;
+		auto start = std::chrono::high_resolution_clock::now();
+		mTestPositions.run<SolutionTracker>(threadCount, hashBytes,
+				[&](size_t i, MinMaxAI& ai, SolutionTracker& tracker) {
+			testPos(mTestPositions[i], ai, tracker, tc, logger, mutex, result);
+		});
+
+		std::chrono::duration<double> time = std::chrono::high_resolution_clock::now() - start;
+		logger.logMessage("Tests passed: "
+				+ std::to_string(result.solved) + "/" + std::to_string(result.total));
+		logger.logMessage(strFormat(100, "Total time: %.2fs", time.count()));
+		if (result.solved) {
+			logger.logMessage("Time to solution (s): " + distribution(result.solveTimes, "%.3f"));
+			logger.logMessage("Nodes to solution: " + distribution(result.solveNodes, "%.0f"));
 		}
+		return result;
+	}
 
-		logger.logMessage("Tests passed: "
-				+ std::to_string(count[1]) + "/" + std::to_string(count[0] + count[1]));
+	/* Returns the mean, quartiles, 90th percentile and maximum of the values. */
+	template<typename TValue>
+	static std::string distribution(std::vector<TValue> values, const char* format)
+	{
+		if (values.empty())
+			return "-";
+		std::sort(values.begin(), values.end());
+		double sum = 0;
+		for (TValue v : values)
+			sum += v;
+
+		std::string r = "mean " + strFormat(32, format, sum / values.size());
+		const unsigned percents[] = {25, 50, 75, 90, 100};
+		for (unsigned p : percents) {
+			// Nearest-rank percentile
+			size_t idx = std::max<size_t>((p * values.size() + 99) / 100, 1) - 1;
+			r += ", " + (p < 100 ? std::to_string(p) + "%" : std::string("max")) + " "
+					+ strFormat(32, format, (double) values[idx]);
+		}
+		return r;
 	}
 
 private:
 
-	bool testPos(const Epd& epd, Move bestMove, GamePlayer& ai, const TimeConstraint& tc,
-			Logger& logger) const
+	void testPos(const std::string& line, MinMaxAI& ai, SolutionTracker& tracker,
+			const TimeConstraint& tc, Logger& logger, std::mutex& mutex, Result& result) const
 	{
-		GameState state(epd);
-		Move move = ai.getMove(state, tc);
-		if (move == bestMove) {
-			logger.logMessage(epd.string() + " [OK]");
-			return true;
-		} else {
-			logger.logMessage(epd.string() + " [FAILED]");
-			std::string brd = state.board().toStr(true) + "#";
-			brd = "  " + stringReplace(brd, "\n", "\n  ");
-			brd = stringReplace(brd, "\n  #", "");
-			logger.logMessage(brd);
-			logger.logMessage("  Expected: " + bestMove.toStr());
-			logger.logMessage("  Chose: " + move.toStr());
-			return false;
+		try {
+			Epd epd(line);
+			GameState state(epd);
+			tracker.bestMoves = EpdSuite::parseSanMoves(state, epd.operation("bm"));
+			tracker.avoidMoves = EpdSuite::parseSanMoves(state, epd.operation("am"));
+			if (tracker.bestMoves.empty() && tracker.avoidMoves.empty())
+				throw std::invalid_argument("No best move or move to avoid.");
+
+			Move move = ai.getMove(state, tc);
+			bool solved = tracker.isSolution(move);
+			if (solved && !tracker.settled) {
+				tracker.solveTime = tracker.lastTime;
+				tracker.solveNodes = tracker.lastNodes;
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			++result.total;
+			if (solved) {
+				++result.solved;
+				result.solveTimes.push_back(tracker.solveTime);
+				result.solveNodes.push_back(tracker.solveNodes);
+				logger.logMessage(epd.string() + strFormat(100, " [OK] %.3fs %llu nodes",
+						tracker.solveTime, (unsigned long long) tracker.solveNodes));
+			} else {
+				logger.logMessage(epd.string() + " [FAILED]");
+				std::string brd = state.board().toStr(true) + "#";
+				brd = "  " + stringReplace(brd, "\n", "\n  ");
+				brd = stringReplace(brd, "\n  #", "");
+				logger.logMessage(brd);
+				if (!tracker.bestMoves.empty())
+					logger.logMessage("  Expected: " + epd.operation("bm").str());
+				if (!tracker.avoidMoves.empty())
+					logger.logMessage("  Avoid: " + epd.operation("am").str());
+				logger.logMessage("  Chose: " + move.toStr());
+			}
+		} catch (const std::invalid_argument& e) {
+			std::lock_guard<std::mutex> lock(mutex);
+			++result.total;
+			logger.logMessage(line + " [ERROR] " + e.what());
 		}
 	}
 };
 
 template<typename T>
 SkillTest_t<T> SkillTest_t<T>::ZUGZWANG {
-	{"8/8/p1p5/1p5p/1P5p/8/PPP2K1p/4R1rk w - - 0 1 bm Rf1; id \"zugzwang.001\";", "a2-a3"},
-	{"1q1k4/2Rr4/8/2Q3K1/8/8/8/8 w - - 0 1 bm Kh6;  id \"zugzwang.002\";", "a2-a3"},
-	{"7k/5K2/5P1p/3p4/6P1/3p4/8/8 w - - 0 1 bm g5; id \"zugzwang.003\";", "a2-a3"},
-	{"8/6B1/p5p1/Pp4kp/1P5r/5P1Q/4q1PK/8 w - - 0 32 bm Qxh4; id \"zugzwang.004\";", "a2-a3"},
-	{"8/8/1p1r1k2/p1pPN1p1/P3KnP1/1P6/8/3R4 b - - 0 1 bm Nxd5; id \"zugzwang.005\";", "a2-a3"},
+	"8/8/p1p5/1p5p/1P5p/8/PPP2K1p/4R1rk w - - 0 1 bm Rf1; id \"zugzwang.001\";",
+	"1q1k4/2Rr4/8/2Q3K1/8/8/8/8 w - - 0 1 bm Kh6;  id \"zugzwang.002\";",
+	"7k/5K2/5P1p/3p4/6P1/3p4/8/8 w - - 0 1 bm g5; id \"zugzwang.003\";",
+	"8/6B1/p5p1/Pp4kp/1P5r/5P1Q/4q1PK/8 w - - 0 32 bm Qxh4; id \"zugzwang.004\";",
+	"8/8/1p1r1k2/p1pPN1p1/P3KnP1/1P6/8/3R4 b - - 0 1 bm Nxd5; id \"zugzwang.005\";",
 };
 
 // http://www.stmintz.com/ccc/index.php?id=122312
 template<typename T>
 SkillTest_t<T> SkillTest_t<T>::EASY
 {
-	{"2kr3r/ppp3pp/8/2b1pp2/P1Pn3P/3P1qP1/2PQ1P1R/R3KB2 b Q - bm Nxc2+;", "Nd4xc2"},
-	{"4r3/4P1p1/4k3/2B3pp/1R2K3/r6P/1p4P1/8 b - - bm Ra4;", "Ra3-a4"},
-	{"r6r/2p2k2/ppp5/6Q1/5P2/3Pq3/PPP3PP/4RR1K b - - bm Rxh2+;", "Rh8xh2"},
-	{"6r1/1k6/N1b5/2P4r/4n3/7R/7K/1N6 b - - bm Nf2;", "Ne4-f2"},
-	{"3r4/4kp2/pq2p2P/1p2Q3/1P1NN1pb/P7/4b1PK/3R4 w - - bm Nf5+;", "Nd4-f5"},
-	{"4rk2/Q7/6p1/2R1p3/8/5qP1/8/4K3 b - - bm Rd8;", "Re8-d8"},
-	{"8/8/5p2/4r2k/5K1P/6QP/8/8 w - - bm Qg7;", "Qg3-g7"},
+	"2kr3r/ppp3pp/8/2b1pp2/P1Pn3P/3P1qP1/2PQ1P1R/R3KB2 b Q - bm Nxc2+;",
+	"4r3/4P1p1/4k3/2B3pp/1R2K3/r6P/1p4P1/8 b - - bm Ra4;",
+	"r6r/2p2k2/ppp5/6Q1/5P2/3Pq3/PPP3PP/4RR1K b - - bm Rxh2+;",
+	"6r1/1k6/N1b5/2P4r/4n3/7R/7K/1N6 b - - bm Nf2;",
+	"3r4/4kp2/pq2p2P/1p2Q3/1P1NN1pb/P7/4b1PK/3R4 w - - bm Nf5+;",
+	"4rk2/Q7/6p1/2R1p3/8/5qP1/8/4K3 b - - bm Rd8;",
+	"8/8/5p2/4r2k/5K1P/6QP/8/8 w - - bm Qg7;",
+};
+
+// Mates that can be found with checking moves only.
+template<typename T>
+SkillTest_t<T> SkillTest_t<T>::MATE
+{
+	"r2qkb1r/pp2nppp/3p4/2pNN1B1/2BnP3/3P4/PPP2PPP/R2bK2R w KQkq - bm Nf6+; dm 2;",
+	"r1b2k1r/ppp1bppp/8/1B1Q4/5q2/2P5/PPP2PPP/R3R1K1 w - - bm Qd8+; dm 2;",
+	"5rk1/1p1q2bp/p2pN1p1/2pP2Bn/2P3P1/1P6/P4QKP/5R2 w - - bm Qxf8+; dm 2;",
+	"6k1/pp4p1/2p5/2bp4/8/P5Pb/1P3rrP/2BRRN1K b - - bm Rg1+; dm 2;",
+	"r1bq2r1/b4pk1/p1pp1p2/1p2pP2/1P2P1PB/3P4/1PPQ2P1/R3K2R w - - bm Qh6+; dm 2;",
+	"r5rk/5p1p/5R2/4B3/8/8/7P/7K w - - bm Ra6+; dm 3;",
+	"2r3k1/p4p2/3Rp2p/1p2P1pK/8/1P4P1/P3Q2P/1q6 b - - bm Qg6+; dm 3;",
+	"r1b1kb1r/pppp1ppp/5q2/4n3/3KP3/2N3PN/PPP4P/R1BQ1B1R b kq - bm Bc5+; dm 3;",
+	"r1b3kr/ppp1Bp1p/1b6/n2P4/2p3q1/2Q2N2/P4PPP/RN2R1K1 w - - bm Qxh8+; dm 3;",
+	"1k1r4/pp1b1R2/3q2pp/4p3/2B5/4Q3/PPP2B2/2K5 b - - bm Qd1+; dm 3;",
+	"4kr2/3rn2p/1P4p1/2p5/Q1B2P2/8/P2q2PP/4R1K1 w - - bm Qa8+; dm 4;",
+	"r1b2rk1/pp1p1pp1/1b1p2B1/n1qQ2p1/8/5N2/P3RPPP/4R1K1 w - - bm Qxf7+; dm 4;",
+	"5r1k/1q4bp/3pB1p1/2pPn1B1/1r6/1p5R/1P2PPQP/R5K1 w - - bm Rxh7+; dm 4;",
+	"2q1nk1r/4Rp2/1ppp1P2/6Pp/3p1B2/3P3P/PPP1Q3/6K1 w - - bm Rxe8+; dm 5;",
 };
 
 typedef SkillTest_t<> SkillTest;
@@ -1,25 +1,31 @@
 #pragma once
 
 #include "NodeType.h"
-#include "Move.h"
+#include "PackedMove.h"
+#include <cstdint>
 
 namespace mnc {
 
+/* Transposition table entry (16 bytes). */
 struct StateInfo
 {
 public:
 
+	static constexpr unsigned MAX_AGE = 63;
+
 	uint64_t id;
 
-	uint8_t depth;
+	int score;
 
-	uint8_t age;
+	PackedMove bestMove;
 
-	int score;
+	uint8_t depth;
 
-	Move bestMove;
+	uint8_t age : 6;
 
-	NodeType nodeType;
+	NodeType nodeType : 2;
 };
 
+static_assert(sizeof (StateInfo) == 16, "Unexpected transposition table entry size.");
+
 }
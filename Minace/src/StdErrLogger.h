@@ -0,0 +1,22 @@
+#pragma once
+
+#include "Logger.h"
+#include <string>
+#include <iostream>
+
+namespace mnc {
+
+/**
+ * Simple logger that outputs to standard error, for modes that write results to standard output.
+ */
+class StdErrLogger : public Logger
+{
+public:
+
+	virtual void logMessage(const std::string& msg) override
+	{
+		std::cerr << msg << std::endl;
+	}
+};
+
+}
@@ -0,0 +1,892 @@
+#pragma once
+
+#include "SyzygyEncoding.h"
+#include "GameState.h"
+#include "BitBoard.h"
+#include "Move.h"
+#include "Piece.h"
+#include "Player.h"
+#include "Sqr.h"
+#include "Mask.h"
+#include "Intrinsics.h"
+#include <vector>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <fstream>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#ifdef __unix__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mnc {
+
+/**
+ * Probes Syzygy tablebases: WDL files (.rtbw) give win/draw/loss with the 50-move rule, DTZ files
+ * (.rtbz) the distance to the next capture or pawn move. Files are found when the path is set but
+ * memory-mapped only when first probed. Probing is thread-safe.
+ *
+ * Values of positions where a capture is at least as good as the best quiet move may be anything
+ * in the files (and DTZ doesn't store positions where a pawn move or capture wins), so probing
+ * searches captures first. Positions with castling rights are not in the tables and en passant is
+ * handled by the search.
+ */
+class Syzygy
+{
+public:
+	static constexpr unsigned MAX_PIECES = SyzygyEncoding::MAX_PIECES;
+
+	// Win/draw/loss values for the side to move. Cursed wins and blessed losses are draws by the
+	// 50-move rule.
+	static constexpr int LOSS = -2;
+
+	static constexpr int BLESSED_LOSS = -1;
+
+	static constexpr int DRAW = 0;
+
+	static constexpr int CURSED_WIN = 1;
+
+	static constexpr int WIN = 2;
+
+private:
+	// Flags of a part of a file. DTZ files store only one side to move (black if DTZ_BLACK), and
+	// the values are moves unless stored in plies. Values may be indices to a map (16-bit values
+	// if DTZ_WIDE_MAP) that has a section for each WDL value.
+	static constexpr uint8_t DTZ_BLACK = 1;
+
+	static constexpr uint8_t DTZ_MAP = 2;
+
+	static constexpr uint8_t DTZ_WIN_PLIES = 4;
+
+	static constexpr uint8_t DTZ_LOSS_PLIES = 8;
+
+	static constexpr uint8_t DTZ_WIDE_MAP = 16;
+
+	static constexpr uint8_t CONSTANT = 128;
+
+	// Upper limit of legal captures with at most MAX_PIECES pieces (promotions counted 4 times).
+	static constexpr unsigned MAX_CAPTURES = 256;
+
+	/* Values of one part of a file. The values are Huffman coded symbols in blocks of fixed size;
+	 * each symbol stands for a value or for a pair of symbols. */
+	struct Part
+	{
+		SyzygyEncoding encoding;
+
+		uint8_t flags = 0;
+
+		// Value of a constant part.
+		unsigned constant = 0;
+
+		unsigned blockBits = 0, spanBits = 0;
+
+		uint32_t blockCount = 0, blockSizeCount = 0;
+
+		uint64_t spanCount = 0;
+
+		// Block (32 bits) and offset in the block (16 bits) of the middle index of each span.
+		const uint8_t* spans = nullptr;
+
+		// Number of values of each block minus one (16 bits).
+		const uint8_t* blockSizes = nullptr;
+
+		const uint8_t* blocks = nullptr;
+
+		// Two 12-bit symbols of each pair, or a value and 0xfff.
+		const uint8_t* symbols = nullptr;
+
+		// First symbol of each code length (16 bits).
+		const uint8_t* firstSymbols = nullptr;
+
+		unsigned minLength = 0;
+
+		// Lowest code of each length, aligned to the top of 64 bits.
+		std::vector<uint64_t> lowestCodes;
+
+		// Number of values of each symbol minus one.
+		std::vector<unsigned> extraValues;
+
+		// Start of the map section of each WDL value.
+		unsigned maps[4] = {};
+	};
+
+	/* WDL or DTZ file of a table. */
+	struct TableFile
+	{
+		std::string path;
+
+		bool dtz = false;
+
+		std::atomic<bool> loaded{false};
+
+		const uint8_t* data = nullptr;
+
+		size_t size = 0;
+
+		const uint8_t* maps = nullptr;
+
+		// Parts by side to move (WDL only) and file of the leading pawn (tables with pawns only).
+		Part parts[Player::COUNT][4];
+	};
+
+	/* Table of a material combination, named with the stronger side first (e.g. "KRvKN"). */
+	struct Table
+	{
+		std::string name;
+
+		// Material keys (see BitBoard::materialKey()) with the first side white and black.
+		uint64_t keys[Player::COUNT];
+
+		unsigned pieceCount;
+
+		// Pawns of the leading color (the one with fewer pawns, but at least one) and of the other.
+		unsigned leadPawns, otherPawns;
+
+		bool threePieces;
+
+		TableFile files[2];
+
+		bool symmetric() const
+		{
+			return keys[Player::WHITE] == keys[Player::BLACK];
+		}
+	};
+
+	std::vector<std::unique_ptr<Table>> mTables;
+
+	std::unordered_map<uint64_t, Table*> mKeys;
+
+	unsigned mMaxPieces;
+
+	mutable std::mutex mMutex;
+
+public:
+
+	/* Finds the tables in the directories separated by ':' (';' on Windows). */
+	explicit Syzygy(const std::string& paths)
+	: mMaxPieces(0)
+	{
+#ifdef _WIN32
+		const char separator = ';';
+#else
+		const char separator = ':';
+#endif
+		std::vector<std::string> directories;
+		size_t begin = 0;
+		while (begin <= paths.size()) {
+			size_t end = std::min(paths.find(separator, begin), paths.size());
+			if (end > begin)
+				directories.push_back(paths.substr(begin, end - begin));
+			begin = end + 1;
+		}
+
+		// Pieces of one side in decreasing order of value, with up to MAX_PIECES - 2 in total.
+		std::vector<std::string> sides = {""};
+		for (size_t i = 0; i < sides.size(); ++i) {
+			if (sides[i].size() == MAX_PIECES - 2)
+				continue;
+			const std::string pieces = "QRBNP";
+			for (size_t p = sides[i].empty() ? 0 : pieces.find(sides[i].back()); p < pieces.size();
+					++p)
+				sides.push_back(sides[i] + pieces[p]);
+		}
+		for (const std::string& strong : sides) {
+			for (const std::string& weak : sides) {
+				if (!strong.empty() && strong.size() + weak.size() <= MAX_PIECES - 2)
+					addTable(directories, "K" + strong + "vK" + weak);
+			}
+		}
+	}
+
+	~Syzygy()
+	{
+		for (const auto& table : mTables) {
+			for (TableFile& file : table->files)
+				unmap(file);
+		}
+	}
+
+	Syzygy(const Syzygy&) = delete;
+
+	Syzygy& operator=(const Syzygy&) = delete;
+
+	/* Number of WDL tables found. */
+	size_t size() const
+	{
+		return mTables.size();
+	}
+
+	unsigned maxPieces() const
+	{
+		return mMaxPieces;
+	}
+
+	/* Sets the win/draw/loss value for the side to move. Returns false if the position is not in
+	 * the tables. */
+	bool probeWdl(GameState& state, int& wdl) const
+	{
+		if (!inTables(state))
+			return false;
+		bool ok = true, zeroing;
+		wdl = probeWdl(state, zeroing, ok);
+		return ok;
+	}
+
+	/* Sets the number of plies to the next capture, pawn move or mate in the optimal play,
+	 * positive if the side to move wins and negative if it loses, or 0 for a draw. 100 is added for
+	 * cursed wins and blessed losses, and a mated side has -1. Returns false if the position is not
+	 * in the tables. */
+	bool probeDtz(GameState& state, int& dtz) const
+	{
+		if (!inTables(state))
+			return false;
+		bool ok = true;
+		dtz = probeDtz(state, ok);
+		return ok;
+	}
+
+	/* Ranks the legal root moves: wins within the 50-move rule by the shortest DTZ, then cursed
+	 * wins, draws, blessed losses and losses by the longest DTZ. Returns false if the position is
+	 * not in the tables. */
+	bool rankRootMoves(GameState& state, const std::vector<Move>& moves,
+			std::vector<int>& ranks) const
+	{
+		if (!inTables(state))
+			return false;
+		unsigned halfMoveClock = state.halfMoveClock();
+		bool ok = true, zeroing;
+		ranks.clear();
+		for (Move move : moves) {
+			// DTZ of the side that moved.
+			int dtz;
+			state.makeMove(move);
+			if (state.isCheckMate())
+				dtz = 1;
+			else if (state.halfMoveClock() == 0)
+				dtz = zeroingDtz(-probeWdl(state, zeroing, ok));
+			else if (state.isRepeatedState())
+				dtz = 0;
+			else
+				dtz = longer(-probeDtz(state, ok));
+			state.undoMove(move);
+			if (!ok)
+				return false;
+
+			unsigned plies = std::abs(dtz);
+			ranks.push_back(!dtz ? 0 : plies + halfMoveClock > 100 ? (dtz > 0 ? 1 : -1)
+					: dtz > 0 ? 1000 - dtz : -1000 - dtz);
+		}
+		return true;
+	}
+
+private:
+
+	bool inTables(const GameState& state) const
+	{
+		return bitCount((uint64_t) state.board()()) <= mMaxPieces && !state.castlingRights();
+	}
+
+	/* Win/draw/loss of the position. The captures are searched because the table value doesn't
+	 * have to be correct when a capture is as good, and en passant because the tables don't know
+	 * about it (if en passant is the only legal move the table stores a stalemate). Zeroing is set
+	 * if the value comes from a capture and it wins (or is en passant), so that it is also the
+	 * DTZ move. */
+	int probeWdl(GameState& state, bool& zeroing, bool& ok) const
+	{
+		zeroing = false;
+		int bestCapture = LOSS - 1, bestEnPassant = LOSS - 1;
+		Move moves[MAX_CAPTURES];
+		unsigned count = getCaptures(state, moves);
+		for (unsigned i = 0; i < count; ++i) {
+			Move move = moves[i];
+			bool enPassant = move.pieceType() == Piece::PAWN && move.toSqr() == state.enPassantSqr();
+			state.makeMove(move);
+			int value = -searchCaptures(state, LOSS, -bestCapture, ok);
+			state.undoMove(move);
+			if (!ok)
+				return DRAW;
+			if (value == WIN) {
+				zeroing = true;
+				return WIN;
+			}
+			int& best = enPassant ? bestEnPassant : bestCapture;
+			best = std::max(best, value);
+		}
+
+		int value = tableValue(state, false, DRAW, ok);
+		if (!ok)
+			return DRAW;
+		if (bestEnPassant > bestCapture) {
+			if (bestEnPassant > value) {
+				zeroing = true;
+				return bestEnPassant;
+			}
+			bestCapture = bestEnPassant;
+		}
+		if (bestCapture >= value) {
+			zeroing = bestCapture > DRAW;
+			return bestCapture;
+		}
+		if (bestEnPassant >= LOSS && value == DRAW && !state.isKingChecked(state.activePlayer())
+				&& !hasMoveOtherThanEnPassant(state)) {
+			zeroing = true;
+			return bestEnPassant;
+		}
+		return value;
+	}
+
+	/* Alpha-beta search of captures on top of the table values. */
+	int searchCaptures(GameState& state, int alpha, int beta, bool& ok) const
+	{
+		Move moves[MAX_CAPTURES];
+		unsigned count = getCaptures(state, moves);
+		for (unsigned i = 0; i < count; ++i) {
+			Move move = moves[i];
+			state.makeMove(move);
+			int value = -searchCaptures(state, -beta, -alpha, ok);
+			state.undoMove(move);
+			if (!ok)
+				return DRAW;
+			if (value >= beta)
+				return value;
+			alpha = std::max(alpha, value);
+		}
+		return std::max(alpha, tableValue(state, false, DRAW, ok));
+	}
+
+	/* Generates the legal captures, including en passant and promotions with a capture, without
+	 * generating the quiet moves. Returns the number of moves. */
+	static unsigned getCaptures(GameState& state, Move* moves)
+	{
+		Player player = state.activePlayer();
+		const BitBoard& board = state.board();
+		Sqr enPassantSqr = state.enPassantSqr();
+		unsigned count = 0;
+		for (unsigned piece = 0; piece < Piece::COUNT; ++piece) {
+			Mask targets = board(~player);
+			if (piece == Piece::PAWN && enPassantSqr)
+				targets |= enPassantSqr;
+			for (Sqr fromSqr : board(player, Piece(piece))) {
+				Mask captures = state.getPseudoLegalMoves(player, Piece(piece), fromSqr) & targets;
+				for (Sqr toSqr : captures) {
+					Piece capturedType = toSqr == enPassantSqr && piece == Piece::PAWN
+							? Piece::PAWN : board.getPieceType(~player, toSqr);
+					Move move(fromSqr, toSqr, Piece(piece), capturedType, Piece(piece));
+					if (!state.isLegalMove2(move))
+						continue;
+					if (piece == Piece::PAWN && toSqr.row() == player * 7) {
+						for (unsigned promoType = Piece::QUEEN; promoType <= Piece::KNIGHT;
+								++promoType)
+							moves[count++] = Move(fromSqr, toSqr, Piece(piece), capturedType,
+									Piece(promoType));
+					} else
+						moves[count++] = move;
+				}
+			}
+		}
+		return count;
+	}
+
+	static bool hasMoveOtherThanEnPassant(GameState& state)
+	{
+		Player player = state.activePlayer();
+		const BitBoard& board = state.board();
+		for (Sqr fromSqr : board(player)) {
+			Piece pieceType = board.getPieceType(player, fromSqr);
+			for (Sqr toSqr : state.getPseudoLegalMoves(player, pieceType, fromSqr)) {
+				if (pieceType == Piece::PAWN && toSqr == state.enPassantSqr())
+					continue;
+				Piece capturedType = board.getPieceType(~player, toSqr);
+				if (state.isLegalMove2(Move(fromSqr, toSqr, pieceType, capturedType, pieceType)))
+					return true;
+			}
+		}
+		return false;
+	}
+
+	int probeDtz(GameState& state, bool& ok) const
+	{
+		bool zeroing;
+		int wdl = probeWdl(state, zeroing, ok);
+		if (!ok || wdl == DRAW)
+			return 0;
+		if (zeroing)
+			return zeroingDtz(wdl);
+
+		// A winning pawn move has the shortest DTZ.
+		std::vector<Move> moves;
+		state.getLegalMoves(moves);
+		if (wdl > DRAW) {
+			for (Move move : moves) {
+				if (move.pieceType() != Piece::PAWN || move.isCapture())
+					continue;
+				state.makeMove(move);
+				int value = -probeWdl(state, zeroing, ok);
+				state.undoMove(move);
+				if (!ok)
+					return 0;
+				if (value == wdl)
+					return zeroingDtz(wdl);
+			}
+		}
+
+		int stored = tableValue(state, true, wdl, ok);
+		if (!ok)
+			return 0;
+		if (stored >= 0)
+			return zeroingDtz(wdl) + (wdl > DRAW ? stored : -stored);
+
+		// The table stores the other side to move, so search one ply.
+		int best = wdl > DRAW ? INT_MAX : -1;
+		for (Move move : moves) {
+			bool zeroingMove = move.isCapture() || move.pieceType() == Piece::PAWN;
+			if (wdl > DRAW && zeroingMove)
+				continue;
+			state.makeMove(move);
+			int value;
+			if (wdl > DRAW)
+				value = state.isCheckMate() ? 1 : longer(-probeDtz(state, ok));
+			else if (!zeroingMove)
+				value = longer(-probeDtz(state, ok));
+			else
+				value = wdl == LOSS ? -1 : -probeWdl(state, zeroing, ok) == LOSS ? -1 : -101;
+			state.undoMove(move);
+			if (!ok)
+				return 0;
+			if (wdl > DRAW && value > 0)
+				best = std::min(best, value);
+			else if (wdl < DRAW)
+				best = std::min(best, value);
+		}
+		if (best == INT_MAX)
+			ok = false;
+		return best;
+	}
+
+	/* DTZ when the move is a capture or pawn move (or mate) with the result. */
+	static int zeroingDtz(int wdl)
+	{
+		switch (wdl) {
+		case WIN:
+			return 1;
+		case CURSED_WIN:
+			return 101;
+		case BLESSED_LOSS:
+			return -101;
+		case LOSS:
+			return -1;
+		default:
+			return 0;
+		}
+	}
+
+	/* DTZ one ply longer. */
+	static int longer(int dtz)
+	{
+		return dtz > 0 ? dtz + 1 : dtz < 0 ? dtz - 1 : 0;
+	}
+
+	/* Value stored for the position: WDL, or the DTZ plies after zeroingDtz(wdl). Returns -1 if the
+	 * DTZ table stores the other side to move, and sets ok to false if the table is missing. */
+	int tableValue(const GameState& state, bool dtz, int wdl, bool& ok) const
+	{
+		const BitBoard& board = state.board();
+		if (bitCount((uint64_t) board()) == 2)
+			return DRAW;
+		auto it = mKeys.find(state.materialId());
+		TableFile* file = it == mKeys.end() ? nullptr : &it->second->files[dtz];
+		if (!file || !load(*it->second, *file)) {
+			ok = false;
+			return DRAW;
+		}
+		const Table& table = *it->second;
+
+		// Tables have the stronger side as white, and only white to move if both sides have the
+		// same pieces. Otherwise the colors and ranks are flipped.
+		bool black = state.activePlayer() == Player::BLACK;
+		bool flip = state.materialId() != table.keys[Player::WHITE] || (table.symmetric() && black);
+		unsigned stm = black != flip;
+		const Part* part = &file->parts[dtz ? 0 : stm][0];
+		int sqrs[MAX_PIECES];
+		unsigned count = 0;
+		if (table.leadPawns) {
+			count = addSqrs(board, part->encoding.piece(0), flip, sqrs);
+			part = &file->parts[dtz ? 0 : stm][SyzygyEncoding::leadingPawn(sqrs, count)];
+		}
+		if (dtz && unsigned(part->flags & DTZ_BLACK) != stm
+				&& !(table.symmetric() && !table.leadPawns))
+			return -1;
+		while (count < table.pieceCount)
+			count += addSqrs(board, part->encoding.piece(count), flip, sqrs + count);
+
+		unsigned value = decode(*part, part->encoding.index(sqrs));
+		if (!dtz)
+			return (int) value - 2;
+
+		if (part->flags & DTZ_MAP) {
+			unsigned idx = part->maps[wdl == WIN ? 0 : wdl == LOSS ? 1 : wdl == CURSED_WIN ? 2 : 3]
+					+ value;
+			value = part->flags & DTZ_WIDE_MAP ? readLe16(file->maps + 2 * idx) : file->maps[idx];
+		}
+		bool plies = (wdl == WIN && (part->flags & DTZ_WIN_PLIES))
+				|| (wdl == LOSS && (part->flags & DTZ_LOSS_PLIES));
+		return plies ? value : 2 * value;
+	}
+
+	/* Adds the squares of the pieces with the code of the table (colors flipped if flip). */
+	static unsigned addSqrs(const BitBoard& board, int code, bool flip, int* sqrs)
+	{
+		Player player(bool(code & 8) != flip);
+		Piece piece(6u - (code & 7));
+		unsigned count = 0;
+		for (Sqr sqr : board(player, piece))
+			sqrs[count++] = flip ? sqr : sqr ^ 56;
+		return count;
+	}
+
+	/* Value at the index of the part. */
+	static unsigned decode(const Part& part, uint64_t idx)
+	{
+		if (part.flags & CONSTANT)
+			return part.constant;
+
+		// The spans tell the block and the offset of the middle index. Move from there to the
+		// block of the index.
+		const uint8_t* span = part.spans + 6 * (idx >> part.spanBits);
+		uint32_t block = readLe32(span);
+		int64_t offset = (int64_t) readLe16(span + 4) + (int64_t) (idx & ((1ull << part.spanBits) - 1))
+				- (int64_t) (1ull << (part.spanBits - 1));
+		while (offset < 0)
+			offset += readLe16(part.blockSizes + 2 * --block) + 1;
+		while (offset > readLe16(part.blockSizes + 2 * block))
+			offset -= readLe16(part.blockSizes + 2 * block++) + 1;
+
+		// Read symbols from the start of the block until the one with the value. Bits are consumed
+		// from the top of a 64-bit buffer and refilled 32 bits at a time.
+		const uint8_t* data = part.blocks + ((uint64_t) block << part.blockBits);
+		uint64_t bits = (uint64_t) readBe32(data) << 32 | readBe32(data + 4);
+		data += 8;
+		unsigned consumed = 0, symbol;
+		for (;;) {
+			unsigned length = 0;
+			while (bits < part.lowestCodes[length])
+				++length;
+			symbol = readLe16(part.firstSymbols + 2 * length)
+					+ (unsigned) ((bits - part.lowestCodes[length]) >> (64 - part.minLength - length));
+			if (offset <= part.extraValues[symbol])
+				break;
+			offset -= part.extraValues[symbol] + 1;
+			bits <<= part.minLength + length;
+			consumed += part.minLength + length;
+			if (consumed >= 32) {
+				consumed -= 32;
+				bits |= (uint64_t) readBe32(data) << consumed;
+				data += 4;
+			}
+		}
+
+		// Go down the pairs to the value.
+		while (part.extraValues[symbol]) {
+			unsigned first = firstOfPair(part.symbols, symbol);
+			if (offset <= part.extraValues[first]) {
+				symbol = first;
+			} else {
+				offset -= part.extraValues[first] + 1;
+				symbol = secondOfPair(part.symbols, symbol);
+			}
+		}
+		return firstOfPair(part.symbols, symbol);
+	}
+
+	static unsigned firstOfPair(const uint8_t* symbols, unsigned symbol)
+	{
+		const uint8_t* p = symbols + 3 * symbol;
+		return (p[1] & 0xf) << 8 | p[0];
+	}
+
+	static unsigned secondOfPair(const uint8_t* symbols, unsigned symbol)
+	{
+		const uint8_t* p = symbols + 3 * symbol;
+		return p[2] << 4 | p[1] >> 4;
+	}
+
+	static unsigned readLe16(const uint8_t* p)
+	{
+		return p[0] | p[1] << 8;
+	}
+
+	static uint32_t readLe32(const uint8_t* p)
+	{
+		return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+	}
+
+	static uint32_t readBe32(const uint8_t* p)
+	{
+		return (uint32_t) p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+	}
+
+	/* Adds the table if its WDL file is found in one of the directories. */
+	void addTable(const std::vector<std::string>& directories, const std::string& name)
+	{
+		std::string path;
+		for (const std::string& dir : directories) {
+			if (std::ifstream(dir + "/" + name + ".rtbw")) {
+				path = dir + "/" + name;
+				break;
+			}
+		}
+		if (path.empty())
+			return;
+
+		std::unique_ptr<Table> table(new Table());
+		table->name = name;
+		table->keys[Player::WHITE] = table->keys[Player::BLACK] = 0;
+		table->pieceCount = name.size() - 1;
+		table->threePieces = false;
+		size_t v = name.find('v');
+		unsigned pawns[Player::COUNT] = {};
+		for (size_t i = 0; i < name.size(); ++i) {
+			if (i == v)
+				continue;
+			bool first = i < v;
+			Piece piece(std::string(1, name[i]));
+			for (unsigned player = 0; player < Player::COUNT; ++player)
+				table->keys[player] += BitBoard::materialKeyUnit(Player(bool(player) == first), piece);
+			pawns[first] += piece == Piece::PAWN;
+			if (piece != Piece::KING && std::count(name.begin() + (first ? 0 : v),
+					name.begin() + (first ? v : name.size()), name[i]) == 1)
+				table->threePieces = true;
+		}
+		if (mKeys.count(table->keys[Player::WHITE]))
+			return;
+		bool firstLeads = pawns[true] && (!pawns[false] || pawns[true] <= pawns[false]);
+		table->leadPawns = pawns[firstLeads];
+		table->otherPawns = pawns[!firstLeads];
+		for (bool dtz : {false, true}) {
+			table->files[dtz].path = path + (dtz ? ".rtbz" : ".rtbw");
+			table->files[dtz].dtz = dtz;
+		}
+		mKeys[table->keys[Player::WHITE]] = table.get();
+		mKeys[table->keys[Player::BLACK]] = table.get();
+		mMaxPieces = std::max(mMaxPieces, table->pieceCount);
+		mTables.push_back(std::move(table));
+	}
+
+	/* Maps the file on first use. Returns false if it is missing or not valid. */
+	bool load(const Table& table, TableFile& file) const
+	{
+		if (file.loaded.load(std::memory_order_acquire))
+			return file.data;
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (file.loaded.load(std::memory_order_relaxed))
+			return file.data;
+
+#ifdef __unix__
+		int fd = open(file.path.c_str(), O_RDONLY);
+		struct stat st;
+		if (fd != -1 && fstat(fd, &st) == 0 && st.st_size > 0) {
+			void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+			if (p != MAP_FAILED) {
+				file.data = (const uint8_t*) p;
+				file.size = st.st_size;
+			}
+		}
+		if (fd != -1)
+			close(fd);
+#else
+		std::ifstream ifs(file.path, std::ios::binary | std::ios::ate);
+		if (ifs && ifs.tellg() > 0) {
+			file.size = ifs.tellg();
+			uint8_t* data = new uint8_t[file.size];
+			ifs.seekg(0);
+			ifs.read((char*) data, file.size);
+			file.data = data;
+		}
+#endif
+		// Files end with a 16-byte checksum after 64-byte aligned data.
+		static const uint32_t MAGIC[] = {0x5d23e871, 0xa50c66d7};
+		if (file.data && (file.size < 64 || file.size % 64 != 16
+				|| readLe32(file.data) != MAGIC[file.dtz] || !parse(table, file)))
+			unmap(file);
+		file.loaded.store(true, std::memory_order_release);
+		return file.data;
+	}
+
+	static void unmap(TableFile& file)
+	{
+		if (!file.data)
+			return;
+#ifdef __unix__
+		munmap((void*) file.data, file.size);
+#else
+		delete[] file.data;
+#endif
+		file.data = nullptr;
+	}
+
+	/* Reads the layout of the file: after the magic and a flags byte each file of the leading
+	 * pawn has the digit order and the pieces of both sides (in nibbles), then come the headers of
+	 * the parts, the DTZ maps, the spans, the block sizes and the 64-byte aligned blocks. */
+	static bool parse(const Table& table, TableFile& file)
+	{
+		bool pawns = file.data[4] & 2, split = file.data[4] & 1;
+		if (pawns != (table.leadPawns > 0) || (!file.dtz && split == table.symmetric()))
+			return false;
+		unsigned sides = file.dtz || !split ? 1 : 2, files = pawns ? 4 : 1;
+		bool otherPawns = table.otherPawns > 0;
+		size_t pos = 5;
+		for (unsigned f = 0; f < files; ++f) {
+			if (pos + 1 + otherPawns + table.pieceCount > file.size)
+				return false;
+			const uint8_t* order = file.data + pos;
+			const uint8_t* pieces = order + 1 + otherPawns;
+			for (unsigned side = 0; side < sides; ++side) {
+				unsigned shift = 4 * side;
+				int codes[MAX_PIECES];
+				for (unsigned i = 0; i < table.pieceCount; ++i)
+					codes[i] = pieces[i] >> shift & 0xf;
+				if (!file.parts[side][f].encoding.init(codes, table.pieceCount, pawns,
+						table.threePieces, f, order[0] >> shift & 0xf,
+						otherPawns ? order[1] >> shift & 0xf : 15))
+					return false;
+			}
+			pos += 1 + otherPawns + table.pieceCount;
+		}
+		pos += pos & 1;
+
+		for (unsigned f = 0; f < files; ++f) {
+			for (unsigned side = 0; side < sides; ++side) {
+				if (!parsePart(file, file.parts[side][f], pos))
+					return false;
+			}
+		}
+
+		if (file.dtz) {
+			size_t start = pos;
+			file.maps = file.data + start;
+			for (unsigned f = 0; f < files; ++f) {
+				Part& part = file.parts[0][f];
+				if (!(part.flags & DTZ_MAP))
+					continue;
+				bool wide = part.flags & DTZ_WIDE_MAP;
+				pos += wide && (pos & 1);
+				for (unsigned& map : part.maps) {
+					if (pos + 2 > file.size)
+						return false;
+					map = wide ? (pos - start) / 2 + 1 : pos - start + 1;
+					pos += wide ? 2 + 2 * readLe16(file.data + pos) : 1 + file.data[pos];
+				}
+			}
+			pos += pos & 1;
+		}
+
+		for (unsigned f = 0; f < files; ++f) {
+			for (unsigned side = 0; side < sides; ++side) {
+				file.parts[side][f].spans = file.data + pos;
+				pos += 6 * file.parts[side][f].spanCount;
+			}
+		}
+		for (unsigned f = 0; f < files; ++f) {
+			for (unsigned side = 0; side < sides; ++side) {
+				file.parts[side][f].blockSizes = file.data + std::min(pos, file.size);
+				pos += 2 * file.parts[side][f].blockSizeCount;
+			}
+		}
+		for (unsigned f = 0; f < files; ++f) {
+			for (unsigned side = 0; side < sides; ++side) {
+				Part& part = file.parts[side][f];
+				pos = (pos + 63) & ~(size_t) 63;
+				part.blocks = file.data + std::min(pos, file.size);
+				pos += (size_t) part.blockCount << part.blockBits;
+			}
+		}
+		return pos <= file.size;
+	}
+
+	/* Reads the header of a part: flags, block size, span size, extra block sizes, block count,
+	 * longest and shortest code, first symbol of each code length and the symbols. */
+	static bool parsePart(const TableFile& file, Part& part, size_t& pos)
+	{
+		const uint8_t* p = file.data + pos;
+		if (pos + 2 > file.size)
+			return false;
+		part.flags = p[0];
+		if (part.flags & CONSTANT) {
+			part.constant = p[1];
+			pos += 2;
+			return true;
+		}
+		if (pos + 12 > file.size)
+			return false;
+		part.blockBits = p[1];
+		part.spanBits = p[2];
+		part.blockCount = readLe32(p + 4);
+		part.blockSizeCount = part.blockCount + p[3];
+		unsigned maxLength = p[8];
+		part.minLength = p[9];
+		if (part.blockBits > 30 || !part.spanBits || part.spanBits > 32 || !part.minLength
+				|| part.minLength > maxLength || maxLength > 32)
+			return false;
+		unsigned lengths = maxLength - part.minLength + 1;
+		if (pos + 12 + 2 * lengths > file.size)
+			return false;
+		part.firstSymbols = p + 10;
+		unsigned symbolCount = readLe16(p + 10 + 2 * lengths);
+		part.symbols = p + 12 + 2 * lengths;
+		pos += 12 + 2 * lengths + 3 * symbolCount + (symbolCount & 1);
+		if (pos > file.size)
+			return false;
+		uint64_t span = 1ull << part.spanBits;
+		part.spanCount = (part.encoding.size() + span - 1) / span;
+
+		// Canonical code: longer codes are smaller, and the codes of a length continue from the
+		// codes of the next longer length (halved).
+		part.lowestCodes.assign(lengths, 0);
+		for (int i = (int) lengths - 2; i >= 0; --i)
+			part.lowestCodes[i] = (part.lowestCodes[i + 1] + readLe16(part.firstSymbols + 2 * i)
+					- readLe16(part.firstSymbols + 2 * i + 2)) / 2;
+		for (unsigned i = 0; i < lengths; ++i)
+			part.lowestCodes[i] <<= 64 - part.minLength - i;
+
+		part.extraValues.assign(symbolCount, UINT_MAX);
+		for (unsigned symbol = 0; symbol < symbolCount; ++symbol) {
+			if (!countValues(part, symbol, symbolCount))
+				return false;
+		}
+		return true;
+	}
+
+	/* Sets the number of values of the symbol (minus one). Returns false if the pairs don't form
+	 * a tree. */
+	static bool countValues(Part& part, unsigned symbol, unsigned symbolCount)
+	{
+		unsigned& extra = part.extraValues[symbol];
+		if (extra == UINT_MAX - 1)
+			return false;
+		if (extra != UINT_MAX)
+			return true;
+		unsigned second = secondOfPair(part.symbols, symbol);
+		if (second == 0xfff) {
+			extra = 0;
+			return true;
+		}
+		unsigned first = firstOfPair(part.symbols, symbol);
+		if (first >= symbolCount || second >= symbolCount)
+			return false;
+		extra = UINT_MAX - 1;
+		if (!countValues(part, first, symbolCount) || !countValues(part, second, symbolCount))
+			return false;
+		extra = part.extraValues[first] + part.extraValues[second] + 1;
+		return true;
+	}
+};
+
+}
@@ -0,0 +1,373 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+namespace mnc {
+
+/**
+ * Square tables of the Syzygy position index. Squares are numbered as in the files, from a1 = 0 to
+ * h8 = 63 (Sqr ^ 56).
+ */
+template<typename T>
+class SyzygySquares_t
+{
+public:
+	// CHOOSE[k][n] is the number of ways to choose k squares out of n.
+	static T CHOOSE[8][64];
+
+	// Squares of the a1-d1-d4 triangle: b1, c1, d1, c2, d2, d3, then a1, b2, c3, d4.
+	static int TRIANGLE_SQRS[10];
+
+	// Index of the square in TRIANGLE_SQRS.
+	static int TRIANGLE[64];
+
+	// The 28 squares below the a1-h8 diagonal to 0-27 in the order of the squares.
+	static int BELOW_DIAGONAL[64];
+
+	// Index of two kings by the triangle index of the first one and the square of the second one,
+	// or -1 if the kings touch or the second one is above the diagonal while the first one is on
+	// it. There are 462 indices and the ones with both kings on the diagonal come last.
+	static int KINGS[10][64];
+
+	// Squares a2-h7 to 47-0: files from the edge to the center, ranks 2-7 within a file and the
+	// queenside square before its mirror image.
+	static int PAWN_ORDER[64];
+
+	// Index of the first arrangement of n pawns with the highest PAWN_ORDER on the square (files
+	// a-d) as PAWN_START[n][sqr], and the number of arrangements on the file as PAWN_RANGE[n][file].
+	static T PAWN_START[6][64];
+
+	static T PAWN_RANGE[6][4];
+
+	/* Rank minus file: zero on the a1-h8 diagonal and negative below it. */
+	static int diagonalOffset(int sqr)
+	{
+		return (sqr >> 3) - (sqr & 7);
+	}
+
+	/* Reflection along the a1-h8 diagonal. */
+	static int transpose(int sqr)
+	{
+		return (sqr >> 3) | (sqr & 7) << 3;
+	}
+
+private:
+
+	SyzygySquares_t()
+	{
+		for (int n = 0; n < 64; ++n) {
+			CHOOSE[0][n] = 1;
+			for (int k = 1; k < 8; ++k)
+				CHOOSE[k][n] = n ? CHOOSE[k - 1][n - 1] + CHOOSE[k][n - 1] : 0;
+		}
+
+		int below = 0, triangle = 0;
+		for (int sqr = 0; sqr < 64; ++sqr) {
+			BELOW_DIAGONAL[sqr] = diagonalOffset(sqr) < 0 ? below++ : -1;
+			if ((sqr & 7) <= 3 && diagonalOffset(sqr) < 0)
+				TRIANGLE_SQRS[triangle++] = sqr;
+		}
+		for (int sqr = 0; sqr <= 27; sqr += 9)
+			TRIANGLE_SQRS[triangle++] = sqr;
+		std::fill(TRIANGLE, TRIANGLE + 64, -1);
+		for (int i = 0; i < 10; ++i)
+			TRIANGLE[TRIANGLE_SQRS[i]] = i;
+
+		int code = 0;
+		for (bool bothOnDiagonal : {false, true}) {
+			for (int i = 0; i < 10; ++i) {
+				int king = TRIANGLE_SQRS[i];
+				for (int sqr = 0; sqr < 64; ++sqr) {
+					bool touch = std::abs((king >> 3) - (sqr >> 3)) <= 1
+							&& std::abs((king & 7) - (sqr & 7)) <= 1;
+					bool onDiagonal = !diagonalOffset(king);
+					if (!bothOnDiagonal)
+						KINGS[i][sqr] = -1;
+					if (touch || (onDiagonal && diagonalOffset(sqr) > 0))
+						continue;
+					if (bothOnDiagonal == (onDiagonal && !diagonalOffset(sqr)))
+						KINGS[i][sqr] = code++;
+				}
+			}
+		}
+
+		std::fill(PAWN_ORDER, PAWN_ORDER + 64, -1);
+		for (int sqr = 8; sqr < 56; ++sqr) {
+			int file = sqr & 7;
+			PAWN_ORDER[sqr] = 47 - 12 * std::min(file, 7 - file) - 2 * ((sqr >> 3) - 1) - (file > 3);
+		}
+		for (int n = 1; n < 6; ++n) {
+			for (int file = 0; file < 4; ++file) {
+				T start = 0;
+				for (int sqr = 8 + file; sqr < 56; sqr += 8) {
+					PAWN_START[n][sqr] = start;
+					start += CHOOSE[n - 1][PAWN_ORDER[sqr]];
+				}
+				PAWN_RANGE[n][file] = start;
+			}
+		}
+	}
+
+	static SyzygySquares_t sInit;
+};
+
+template<typename T>
+T SyzygySquares_t<T>::CHOOSE[8][64];
+
+template<typename T>
+int SyzygySquares_t<T>::TRIANGLE_SQRS[10];
+
+template<typename T>
+int SyzygySquares_t<T>::TRIANGLE[64];
+
+template<typename T>
+int SyzygySquares_t<T>::BELOW_DIAGONAL[64];
+
+template<typename T>
+int SyzygySquares_t<T>::KINGS[10][64];
+
+template<typename T>
+int SyzygySquares_t<T>::PAWN_ORDER[64];
+
+template<typename T>
+T SyzygySquares_t<T>::PAWN_START[6][64];
+
+template<typename T>
+T SyzygySquares_t<T>::PAWN_RANGE[6][4];
+
+template<typename T>
+SyzygySquares_t<T> SyzygySquares_t<T>::sInit;
+
+typedef SyzygySquares_t<uint64_t> SyzygySquares;
+
+/**
+ * Index of the positions in one part of a Syzygy table (one side to move and, in tables with
+ * pawns, one file of the leading pawn).
+ *
+ * The table lists its pieces in a fixed order, and consecutive identical pieces form groups. The
+ * index is a mixed-radix number with one digit per group, in the digit order given by the table.
+ * The first group removes the symmetry of the board: three unique pieces or the two kings (the
+ * first piece in the a1-d1-d4 triangle and the first one off the diagonal below it), or the pawns
+ * of the leading color (the leading pawn on files a-d). The pawns of the other color are placed on
+ * the free squares of ranks 2-7, the other groups on the free squares of the board.
+ */
+class SyzygyEncoding
+{
+public:
+	static constexpr unsigned MAX_PIECES = 7;
+
+	// Number of indices of the first group with three unique pieces and with the kings.
+	static constexpr uint64_t THREE_PIECES_SIZE = 31332;
+
+	static constexpr uint64_t KINGS_SIZE = 462;
+
+private:
+	unsigned mPieceCount;
+
+	// Pieces in the order of the table: 1-6 are white pawn, knight, bishop, rook, queen and king,
+	// 9-14 the black ones.
+	int mPieces[MAX_PIECES];
+
+	unsigned mGroupCount;
+
+	// First piece of each group, and the piece count at the end.
+	unsigned mGroupStart[MAX_PIECES + 1];
+
+	uint64_t mMultipliers[MAX_PIECES];
+
+	uint64_t mSize;
+
+	bool mPawns, mThreePieces;
+
+	// The second group is the other color's pawns.
+	bool mOtherPawns;
+
+public:
+
+	SyzygyEncoding()
+	: mPieceCount(0), mGroupCount(0), mSize(0), mPawns(false), mThreePieces(false),
+	mOtherPawns(false)
+	{
+	}
+
+	/* Sets the pieces in the order of the table. The first group goes to the digit firstDigit, the
+	 * other color's pawns to pawnDigit (15 if none) and the rest of the groups to the remaining
+	 * digits in order. File is the file of the leading pawn (0-3) in tables with pawns. Returns
+	 * false if the pieces don't form a valid encoding. */
+	bool init(const int* pieces, unsigned count, bool pawns, bool threePieces, unsigned file,
+			unsigned firstDigit, unsigned pawnDigit)
+	{
+		if (!count || count > MAX_PIECES)
+			return false;
+		mPieceCount = count;
+		mPawns = pawns;
+		mThreePieces = !pawns && threePieces;
+		mOtherPawns = pawns && pawnDigit != 15;
+		for (unsigned i = 0; i < count; ++i) {
+			if ((pieces[i] & 7) < 1 || (pieces[i] & 7) > 6 || pieces[i] > 15)
+				return false;
+			mPieces[i] = pieces[i];
+		}
+
+		// The first group has the leading pawns, or a fixed number of pieces.
+		unsigned firstSize = pawns ? 1 : mThreePieces ? 3 : 2;
+		mGroupCount = 0;
+		for (unsigned i = 0; i < count; ++i) {
+			if (i == 0 || (i == firstSize && !pawns)
+					|| (i >= firstSize && mPieces[i] != mPieces[i - 1]))
+				mGroupStart[mGroupCount++] = i;
+		}
+		mGroupStart[mGroupCount] = count;
+		if (groupSize(0) < firstSize || (pawns && (groupSize(0) > 5 || (mPieces[0] & 7) != 1))
+				|| (mOtherPawns && (mGroupCount < 2 || (mPieces[mGroupStart[1]] & 7) != 1)))
+			return false;
+
+		// Digit of each group and the number of values of the digit.
+		unsigned digits[MAX_PIECES];
+		uint64_t sizes[MAX_PIECES];
+		unsigned next = 0, freeSqrs = 64;
+		for (unsigned g = 0; g < mGroupCount; ++g) {
+			unsigned n = groupSize(g);
+			if (g == 0) {
+				digits[g] = firstDigit;
+				sizes[g] = pawns ? SyzygySquares::PAWN_RANGE[n][file]
+						: mThreePieces ? THREE_PIECES_SIZE : KINGS_SIZE;
+			} else if (g == 1 && mOtherPawns) {
+				digits[g] = pawnDigit;
+				sizes[g] = SyzygySquares::CHOOSE[n][48 - groupSize(0)];
+			} else {
+				while (next == firstDigit || (mOtherPawns && next == pawnDigit))
+					++next;
+				digits[g] = next++;
+				sizes[g] = SyzygySquares::CHOOSE[n][freeSqrs];
+			}
+			freeSqrs -= n;
+		}
+
+		mSize = 1;
+		for (unsigned digit = 0; digit < mGroupCount; ++digit) {
+			unsigned* g = std::find(digits, digits + mGroupCount, digit);
+			if (g == digits + mGroupCount)
+				return false;
+			mMultipliers[g - digits] = mSize;
+			mSize *= sizes[g - digits];
+		}
+		return true;
+	}
+
+	unsigned pieceCount() const
+	{
+		return mPieceCount;
+	}
+
+	int piece(unsigned idx) const
+	{
+		return mPieces[idx];
+	}
+
+	/* Number of indices. */
+	uint64_t size() const
+	{
+		return mSize;
+	}
+
+	/* Index of the position with the pieces in the squares (in the order of the pieces). The
+	 * leading pawn must be the first one (see leadingPawn()). The squares are changed. */
+	uint64_t index(int* sqrs) const
+	{
+		if ((sqrs[0] & 7) > 3) {
+			for (unsigned i = 0; i < mPieceCount; ++i)
+				sqrs[i] ^= 7;
+		}
+
+		uint64_t idx;
+		if (mPawns) {
+			unsigned n = groupSize(0);
+			std::sort(sqrs + 1, sqrs + n, [](int a, int b) {
+				return SyzygySquares::PAWN_ORDER[a] > SyzygySquares::PAWN_ORDER[b];
+			});
+			idx = SyzygySquares::PAWN_START[n][sqrs[0]];
+			for (unsigned i = 1; i < n; ++i)
+				idx += SyzygySquares::CHOOSE[n - i][SyzygySquares::PAWN_ORDER[sqrs[i]]];
+		} else {
+			if (sqrs[0] >= 32) {
+				for (unsigned i = 0; i < mPieceCount; ++i)
+					sqrs[i] ^= 56;
+			}
+			for (unsigned i = 0; i < groupSize(0); ++i) {
+				int offset = SyzygySquares::diagonalOffset(sqrs[i]);
+				if (offset > 0) {
+					for (unsigned j = 0; j < mPieceCount; ++j)
+						sqrs[j] = SyzygySquares::transpose(sqrs[j]);
+				}
+				if (offset)
+					break;
+			}
+			idx = mThreePieces ? threePiecesIndex(sqrs)
+					: SyzygySquares::KINGS[SyzygySquares::TRIANGLE[sqrs[0]]][sqrs[1]];
+		}
+		idx *= mMultipliers[0];
+
+		// The other groups take the free squares: squares taken by earlier groups are skipped.
+		for (unsigned g = 1; g < mGroupCount; ++g) {
+			unsigned begin = mGroupStart[g], end = mGroupStart[g + 1];
+			std::sort(sqrs + begin, sqrs + end);
+			int firstSqr = g == 1 && mOtherPawns ? 8 : 0;
+			uint64_t digit = 0;
+			for (unsigned i = begin; i < end; ++i) {
+				int taken = std::count_if(sqrs, sqrs + begin, [&](int sqr) {
+					return sqr < sqrs[i];
+				});
+				digit += SyzygySquares::CHOOSE[i - begin + 1][sqrs[i] - taken - firstSqr];
+			}
+			idx += digit * mMultipliers[g];
+		}
+		return idx;
+	}
+
+	/* Moves the leading pawn (highest PAWN_ORDER) of the first count squares to the front and
+	 * returns its file mirrored to 0-3. */
+	static unsigned leadingPawn(int* sqrs, unsigned count)
+	{
+		std::swap(sqrs[0], *std::max_element(sqrs, sqrs + count, [](int a, int b) {
+			return SyzygySquares::PAWN_ORDER[a] < SyzygySquares::PAWN_ORDER[b];
+		}));
+		return std::min(sqrs[0] & 7, 7 - (sqrs[0] & 7));
+	}
+
+private:
+
+	unsigned groupSize(unsigned group) const
+	{
+		return mGroupStart[group + 1] - mGroupStart[group];
+	}
+
+	/* Index of three unique pieces, the first one in the triangle. The first piece below the
+	 * diagonal comes first (10 - 4 triangle squares, then any squares for the others), then the
+	 * first piece on the diagonal with the second one below it, then the first two on the diagonal
+	 * with the third one below it, and finally all three on the diagonal. */
+	static uint64_t threePiecesIndex(const int* sqrs)
+	{
+		int second = sqrs[1] - (sqrs[1] > sqrs[0]);
+		int third = sqrs[2] - (sqrs[2] > sqrs[0]) - (sqrs[2] > sqrs[1]);
+		if (SyzygySquares::diagonalOffset(sqrs[0]))
+			return (SyzygySquares::TRIANGLE[sqrs[0]] * 63 + second) * 62 + third;
+
+		// The ranks of pieces on the diagonal, skipping the ones taken.
+		uint64_t idx = 6 * 63 * 62;
+		int rank1 = sqrs[0] >> 3;
+		if (SyzygySquares::diagonalOffset(sqrs[1]))
+			return idx + (rank1 * 28 + SyzygySquares::BELOW_DIAGONAL[sqrs[1]]) * 62 + third;
+		idx += 4 * 28 * 62;
+		int rank2 = (sqrs[1] >> 3) - (sqrs[1] > sqrs[0]);
+		if (SyzygySquares::diagonalOffset(sqrs[2]))
+			return idx + (rank1 * 7 + rank2) * 28 + SyzygySquares::BELOW_DIAGONAL[sqrs[2]];
+		idx += 4 * 7 * 28;
+		int rank3 = (sqrs[2] >> 3) - (sqrs[2] > sqrs[0]) - (sqrs[2] > sqrs[1]);
+		return idx + (rank1 * 7 + rank2) * 6 + rank3;
+	}
+};
+
+}
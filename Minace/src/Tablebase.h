@@ -0,0 +1,631 @@
+#pragma once
+
+#include "GameState.h"
+#include "BitBoard.h"
+#include "Scores.h"
+#include "Piece.h"
+#include "Player.h"
+#include "Sqr.h"
+#include "Mask.h"
+#include "Intrinsics.h"
+#include "MoveMasks.h"
+#include <vector>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+#include <istream>
+#include <ostream>
+#include <fstream>
+#include <stdexcept>
+#include <cstdint>
+#include <cctype>
+
+namespace mnc {
+
+/**
+ * Endgame tablebase for one material combination (e.g. "KQvKR", white pieces first). It contains
+ * the distance to mate of every position for both sides to move, generated by TablebaseGenerator.
+ *
+ * Positions are indexed by the squares of the pieces: white king, black king, then white and black
+ * pieces in the order of piece type. Symmetry is used to restrict the white king to 10 squares
+ * (a1-d1-d4 triangle) in pawnless tables and to files a-d in tables with pawns, and only the king
+ * pairs that are not adjacent are indexed (564 or 1806 pairs). Each group of identical pieces is
+ * indexed as a combination of squares (C(64, k), or C(48, k) for pawns that can't be on the first
+ * and last rank). If the white king is on the diagonal, the smaller index of the position and its
+ * reflection is used. The largest 5-piece tables (e.g. KRPvKB) have 355M positions for each side
+ * to move.
+ *
+ * Each value is one byte: 0 = draw, 1-126 = win in n moves, 128-254 = loss in n - 128 moves and
+ * 255 = invalid index (not kept in files). Castling and en passant are not included. Files are
+ * compressed with run-length encoding and decompressed to memory when loaded.
+ */
+class Tablebase
+{
+public:
+	static constexpr unsigned MAX_PIECES = 5;
+
+	static constexpr uint8_t DRAW = 0;
+
+	static constexpr uint8_t LOSS = 128;
+
+	static constexpr uint8_t INVALID = 255;
+
+	// Longest distance to mate in plies that fits in the value encoding.
+	static constexpr unsigned MAX_PLIES = 251;
+
+private:
+	static constexpr uint32_t FILE_MAGIC = 0x3242544d; // "MTB2"
+
+	/* Identical pieces that are indexed together. */
+	struct Group
+	{
+		unsigned first, count, squares;
+
+		uint64_t size;
+	};
+
+	std::string mName;
+
+	unsigned mPieceCount;
+
+	std::vector<Player> mPlayers;
+
+	std::vector<Piece> mPieces;
+
+	bool mPawns;
+
+	uint64_t mSize;
+
+	std::vector<Group> mGroups;
+
+	// Index of each king pair by white king index * 64 + black king square, or -1 if not valid.
+	std::vector<int> mKingPairs;
+
+	// White king index * 64 + black king square of each king pair.
+	std::vector<unsigned> mKingPairSqrs;
+
+	std::vector<uint8_t> mValues[Player::COUNT];
+
+public:
+
+	/* Creates an empty table for the material, e.g. "KRvK". Throws std::invalid_argument if the
+	 * name is not valid. */
+	explicit Tablebase(const std::string& name)
+	: mName(name), mPieceCount(0), mPawns(false)
+	{
+		size_t v = name.find('v');
+		if (v == std::string::npos || name.size() > MAX_PIECES + 1 || name[0] != 'K'
+				|| name[v + 1] != 'K')
+			throw std::invalid_argument("Invalid tablebase name " + name + ".");
+		mPlayers = {Player::WHITE, Player::BLACK};
+		mPieces = {Piece::KING, Piece::KING};
+		for (size_t i = 1; i < name.size(); ++i) {
+			if (i == v || i == v + 1)
+				continue;
+			Piece piece(std::string(1, name[i]));
+			if (!piece || piece == Piece::KING || !isupper(name[i]))
+				throw std::invalid_argument("Invalid tablebase name " + name + ".");
+			mPlayers.push_back(i < v ? Player::WHITE : Player::BLACK);
+			mPieces.push_back(piece);
+			mPawns |= piece == Piece::PAWN;
+		}
+		mPieceCount = mPieces.size();
+		for (unsigned i = 3; i < mPieceCount; ++i) {
+			if (mPlayers[i] == mPlayers[i - 1] && mPieces[i] < mPieces[i - 1])
+				throw std::invalid_argument("Invalid tablebase name " + name + ".");
+		}
+
+		unsigned kingSqrs = mPawns ? 32 : 10;
+		mKingPairs.assign(kingSqrs * 64, -1);
+		for (unsigned king = 0; king < kingSqrs; ++king) {
+			Sqr whiteKing = kingSqr(king);
+			for (unsigned blackKing = 0; blackKing < 64; ++blackKing) {
+				if (blackKing == whiteKing || (MoveMasks::KING_MOVES[whiteKing] & Sqr(blackKing)))
+					continue;
+				mKingPairs[king * 64 + blackKing] = mKingPairSqrs.size();
+				mKingPairSqrs.push_back(king * 64 + blackKing);
+			}
+		}
+		mSize = mKingPairSqrs.size();
+		for (unsigned i = 2; i < mPieceCount; ++i) {
+			if (i > 2 && mPlayers[i] == mPlayers[i - 1] && mPieces[i] == mPieces[i - 1]) {
+				Group& group = mGroups.back();
+				mSize /= group.size;
+				group.size = binomial(group.squares, ++group.count);
+			} else {
+				unsigned squares = mPieces[i] == Piece::PAWN ? 48 : 64;
+				mGroups.push_back(Group{i, 1, squares, squares});
+			}
+			mSize *= mGroups.back().size;
+		}
+	}
+
+	const std::string& name() const
+	{
+		return mName;
+	}
+
+	unsigned pieceCount() const
+	{
+		return mPieceCount;
+	}
+
+	Player player(unsigned idx) const
+	{
+		return mPlayers[idx];
+	}
+
+	Piece piece(unsigned idx) const
+	{
+		return mPieces[idx];
+	}
+
+	bool hasPawns() const
+	{
+		return mPawns;
+	}
+
+	/* Number of indices for each side to move. */
+	uint64_t size() const
+	{
+		return mSize;
+	}
+
+	uint8_t value(Player activePlayer, uint64_t idx) const
+	{
+		return mValues[activePlayer][idx];
+	}
+
+	std::vector<uint8_t>& values(Player activePlayer)
+	{
+		return mValues[activePlayer];
+	}
+
+	/* Index of the position with the pieces in given squares (in the order of the table). Returns
+	 * size() if the position can't be indexed (kings next to each other, identical pieces on the
+	 * same square or pawns on the first or last rank). */
+	uint64_t index(const Sqr* sqrs) const
+	{
+		unsigned transform = getTransform(sqrs[0]);
+		uint64_t idx = rawIndex(sqrs, transform);
+		Sqr king = applyTransform(transform, sqrs[0]);
+		if (!mPawns && 7 - king.row() == king.col())
+			idx = std::min(idx, rawIndex(sqrs, transform ^ 4));
+		return idx;
+	}
+
+	/* Squares of the pieces from the index. The result may be an invalid position. */
+	void decode(uint64_t idx, Sqr* sqrs) const
+	{
+		for (size_t g = mGroups.size(); g-- > 0;) {
+			const Group& group = mGroups[g];
+			uint64_t combination = idx % group.size;
+			idx /= group.size;
+			unsigned square = group.squares;
+			for (unsigned j = group.count; j-- > 0;) {
+				uint64_t c;
+				while ((c = binomial(--square, j + 1)) > combination)
+					;
+				combination -= c;
+				sqrs[group.first + j] = Sqr(square + (group.squares == 48 ? 8 : 0));
+			}
+		}
+		unsigned kings = mKingPairSqrs[idx];
+		sqrs[0] = kingSqr(kings / 64);
+		sqrs[1] = Sqr(kings % 64);
+	}
+
+	void write(std::ostream& os) const
+	{
+		writeInt(os, FILE_MAGIC, 4);
+		writeInt(os, mName.size(), 1);
+		os.write(mName.data(), mName.size());
+		for (unsigned player = 0; player < Player::COUNT; ++player) {
+			// Invalid positions are never probed, so they can take the previous value to make
+			// longer runs.
+			std::vector<uint8_t> values = mValues[player];
+			for (size_t i = 0; i < values.size(); ++i) {
+				if (values[i] == INVALID)
+					values[i] = i > 0 ? values[i - 1] : DRAW;
+			}
+			std::vector<uint8_t> data = compress(values);
+			writeInt(os, data.size(), 8);
+			os.write((const char*) data.data(), data.size());
+		}
+		if (!os)
+			throw std::runtime_error("Failed to write tablebase " + mName + ".");
+	}
+
+	static std::unique_ptr<Tablebase> read(std::istream& is)
+	{
+		if (readInt(is, 4) != FILE_MAGIC)
+			throw std::runtime_error("Not a tablebase file.");
+		std::string name(readInt(is, 1), ' ');
+		is.read(&name[0], name.size());
+		std::unique_ptr<Tablebase> tb(new Tablebase(name));
+		for (unsigned player = 0; player < Player::COUNT; ++player) {
+			std::vector<uint8_t> data(readInt(is, 8));
+			is.read((char*) data.data(), data.size());
+			if (!is)
+				throw std::runtime_error("Truncated tablebase file.");
+			tb->mValues[player] = decompress(data, tb->mSize);
+		}
+		return tb;
+	}
+
+	/* Name of the table that contains the given pieces (kings included), and whether the colors
+	 * must be flipped to look up the position. */
+	static std::string canonicalName(const std::vector<Player>& players,
+			const std::vector<Piece>& pieces, bool& flip)
+	{
+		static constexpr unsigned PIECE_VALUES[Piece::COUNT] = {0, 9, 5, 3, 3, 1};
+		std::string sides[Player::COUNT];
+		unsigned values[Player::COUNT] = {};
+		for (unsigned type = Piece::KING; type < Piece::COUNT; ++type) {
+			for (size_t i = 0; i < pieces.size(); ++i) {
+				if (pieces[i] == type) {
+					sides[players[i]] += Piece(type).toStr(Player::WHITE, true);
+					values[players[i]] += PIECE_VALUES[type];
+				}
+			}
+		}
+		flip = values[Player::WHITE] < values[Player::BLACK]
+				|| (values[Player::WHITE] == values[Player::BLACK]
+				&& sides[Player::WHITE] < sides[Player::BLACK]);
+		return sides[flip] + "v" + sides[!flip];
+	}
+
+	/* Names of all tables with given number of pieces. */
+	static std::vector<std::string> names(unsigned pieceCount)
+	{
+		std::vector<std::string> result;
+		std::vector<Piece> pieces(pieceCount, Piece::KING);
+		std::vector<Player> players(pieceCount, Player::WHITE);
+		players[1] = Player::BLACK;
+		addNames(pieces, players, 2, Player::WHITE, Piece::QUEEN, result);
+		return result;
+	}
+
+	/* Converts the value to search score from the point of view of the active player. Like in the
+	 * search, mate scores count moves, not plies. */
+	static int toScore(uint8_t value)
+	{
+		if (value == DRAW)
+			return Scores::DRAW;
+		if (value < LOSS)
+			return Scores::getCheckMateScore(value);
+		return Scores::getCheckMateScore(-(value - LOSS));
+	}
+
+private:
+
+	static void addNames(std::vector<Piece>& pieces, std::vector<Player>& players, unsigned idx,
+			unsigned minPlayer, unsigned minType, std::vector<std::string>& result)
+	{
+		if (idx == pieces.size()) {
+			bool flip;
+			std::string name = canonicalName(players, pieces, flip);
+			if (std::find(result.begin(), result.end(), name) == result.end())
+				result.push_back(name);
+			return;
+		}
+		for (unsigned player = minPlayer; player < Player::COUNT; ++player) {
+			for (unsigned type = player == minPlayer ? minType : (unsigned) Piece::QUEEN;
+					type < Piece::COUNT; ++type) {
+				players[idx] = Player(player);
+				pieces[idx] = Piece(type);
+				addNames(pieces, players, idx + 1, player, type, result);
+			}
+		}
+	}
+
+	/* Transformation that moves the white king to the allowed squares: bit 0 = mirror files,
+	 * bit 1 = mirror ranks, bit 2 = reflect along a1-h8 diagonal. */
+	unsigned getTransform(Sqr king) const
+	{
+		unsigned transform = king.col() > 3;
+		if (!mPawns) {
+			transform |= (king.row() < 4) << 1;
+			king = applyTransform(transform, king);
+			transform |= (7 - king.row() > king.col()) << 2;
+		}
+		return transform;
+	}
+
+	static Sqr applyTransform(unsigned transform, Sqr sqr)
+	{
+		unsigned s = sqr;
+		if (transform & 1)
+			s ^= 7;
+		if (transform & 2)
+			s ^= 56;
+		if (transform & 4)
+			s = (7 - (s & 7)) * 8 + 7 - (s >> 3);
+		return Sqr(s);
+	}
+
+	uint64_t rawIndex(const Sqr* sqrs, unsigned transform) const
+	{
+		Sqr s[MAX_PIECES];
+		for (unsigned i = 0; i < mPieceCount; ++i)
+			s[i] = applyTransform(transform, sqrs[i]);
+
+		int kings = mKingPairs[kingIndex(s[0]) * 64 + s[1]];
+		if (kings < 0)
+			return mSize;
+		uint64_t idx = kings;
+		for (const Group& group : mGroups) {
+			// Squares of identical pieces in ascending order give a unique combination.
+			Sqr* g = s + group.first;
+			for (unsigned i = 1; i < group.count; ++i) {
+				for (unsigned j = i; j > 0 && g[j] < g[j - 1]; --j)
+					std::swap(g[j], g[j - 1]);
+			}
+			uint64_t combination = 0;
+			for (unsigned j = 0; j < group.count; ++j) {
+				unsigned square = g[j] - (group.squares == 48 ? 8 : 0);
+				if (square >= group.squares || (j > 0 && g[j] == g[j - 1]))
+					return mSize;
+				combination += binomial(square, j + 1);
+			}
+			idx = idx * group.size + combination;
+		}
+		return idx;
+	}
+
+	static uint64_t binomial(unsigned n, unsigned k)
+	{
+		if (n < k)
+			return 0;
+		uint64_t result = 1;
+		for (unsigned i = 0; i < k; ++i)
+			result = result * (n - i) / (i + 1);
+		return result;
+	}
+
+	unsigned kingIndex(Sqr king) const
+	{
+		if (mPawns)
+			return king.row() * 4 + king.col();
+		// Triangle a1-d1-d4: rank r, file f, r <= f <= 3.
+		static constexpr unsigned RANK_OFFSETS[] = {0, 4, 7, 9};
+		unsigned r = 7 - king.row(), f = king.col();
+		return RANK_OFFSETS[r] + f - r;
+	}
+
+	Sqr kingSqr(uint64_t idx) const
+	{
+		if (mPawns)
+			return Sqr(idx / 4 * 8 + idx % 4);
+		unsigned r = 0;
+		while (idx >= 4 - r)
+			idx -= 4 - r++;
+		return Sqr((7 - r) * 8 + r + idx);
+	}
+
+	/* Run-length encoding: control byte c < 128 is followed by c + 1 literal bytes, 128 <= c < 255
+	 * by one byte repeated c - 125 times and c = 255 by one byte and the repeat count as varint. */
+	static std::vector<uint8_t> compress(const std::vector<uint8_t>& values)
+	{
+		std::vector<uint8_t> out;
+		size_t literalStart = 0;
+		auto flushLiterals = [&](size_t end) {
+			while (literalStart < end) {
+				size_t n = std::min<size_t>(end - literalStart, 128);
+				out.push_back(n - 1);
+				out.insert(out.end(), values.begin() + literalStart,
+						values.begin() + literalStart + n);
+				literalStart += n;
+			}
+		};
+		for (size_t i = 0; i < values.size();) {
+			size_t run = 1;
+			while (i + run < values.size() && values[i + run] == values[i])
+				++run;
+			if (run < 3) {
+				i += run;
+				continue;
+			}
+			flushLiterals(i);
+			if (run < 130) {
+				out.push_back(run + 125);
+				out.push_back(values[i]);
+			} else {
+				out.push_back(255);
+				out.push_back(values[i]);
+				for (uint64_t n = run; ; n >>= 7) {
+					out.push_back((n & 127) | (n >= 128) << 7);
+					if (n < 128)
+						break;
+				}
+			}
+			i += run;
+			literalStart = i;
+		}
+		flushLiterals(values.size());
+		return out;
+	}
+
+	static std::vector<uint8_t> decompress(const std::vector<uint8_t>& data, uint64_t size)
+	{
+		std::vector<uint8_t> values;
+		values.reserve(size);
+		for (size_t i = 0; i < data.size();) {
+			unsigned c = data[i++];
+			if (c < 128) {
+				if (i + c + 1 > data.size())
+					break;
+				values.insert(values.end(), data.begin() + i, data.begin() + i + c + 1);
+				i += c + 1;
+			} else if (i < data.size()) {
+				uint8_t value = data[i++];
+				uint64_t run = c - 125;
+				if (c == 255) {
+					run = 0;
+					for (unsigned shift = 0; i < data.size(); shift += 7) {
+						run |= (uint64_t) (data[i] & 127) << shift;
+						if (!(data[i++] & 128))
+							break;
+					}
+				}
+				if (values.size() + run > size)
+					break;
+				values.insert(values.end(), run, value);
+			}
+		}
+		if (values.size() != size)
+			throw std::runtime_error("Corrupted tablebase file.");
+		return values;
+	}
+
+	static void writeInt(std::ostream& os, uint64_t value, unsigned bytes)
+	{
+		for (unsigned i = 0; i < bytes; ++i)
+			os.put((char) (value >> 8 * i));
+	}
+
+	static uint64_t readInt(std::istream& is, unsigned bytes)
+	{
+		uint64_t value = 0;
+		for (unsigned i = 0; i < bytes; ++i)
+			value |= (uint64_t) (uint8_t) is.get() << 8 * i;
+		return value;
+	}
+};
+
+/**
+ * Collection of tablebases used for probing during search.
+ */
+class Tablebases
+{
+private:
+
+	struct Entry
+	{
+		const Tablebase* tablebase;
+
+		bool flip;
+	};
+
+	std::vector<std::unique_ptr<Tablebase>> mTablebases;
+
+	// Tables by material key (see materialKey()) of both colors.
+	std::unordered_map<uint32_t, Entry> mEntries;
+
+	unsigned mMaxPieces;
+
+public:
+
+	Tablebases()
+	: mMaxPieces(0)
+	{
+	}
+
+	/* Loads all tables found in the directory. Returns the number of tables. */
+	unsigned load(const std::string& directory)
+	{
+		unsigned count = 0;
+		for (unsigned pieces = 3; pieces <= Tablebase::MAX_PIECES; ++pieces) {
+			for (const std::string& name : Tablebase::names(pieces)) {
+				std::ifstream ifs(directory + "/" + name + ".mtb", std::ios::binary);
+				if (ifs) {
+					add(Tablebase::read(ifs));
+					++count;
+				}
+			}
+		}
+		return count;
+	}
+
+	void add(std::unique_ptr<Tablebase> tablebase)
+	{
+		Tablebase* tb = tablebase.get();
+		mTablebases.push_back(std::move(tablebase));
+		unsigned counts[Player::COUNT][Piece::COUNT] = {};
+		for (unsigned i = 0; i < tb->pieceCount(); ++i)
+			++counts[tb->player(i)][tb->piece(i)];
+		uint32_t key = materialKey(counts[Player::WHITE], counts[Player::BLACK]);
+		uint32_t flippedKey = materialKey(counts[Player::BLACK], counts[Player::WHITE]);
+		mEntries[key] = Entry{tb, false};
+		if (flippedKey != key)
+			mEntries[flippedKey] = Entry{tb, true};
+		mMaxPieces = std::max(mMaxPieces, tb->pieceCount());
+	}
+
+	const Tablebase* find(const std::string& name) const
+	{
+		for (const auto& tb : mTablebases) {
+			if (tb->name() == name)
+				return tb.get();
+		}
+		return nullptr;
+	}
+
+	size_t size() const
+	{
+		return mTablebases.size();
+	}
+
+	const Tablebase& operator[](size_t idx) const
+	{
+		return *mTablebases[idx];
+	}
+
+	unsigned maxPieces() const
+	{
+		return mMaxPieces;
+	}
+
+	/* Looks up the position. Returns false if there is no table for it. Otherwise sets the score
+	 * from the point of view of the active player (mate scores count moves to mate, see
+	 * toScore()). */
+	bool probe(const GameState& state, int& score) const
+	{
+		const BitBoard& board = state.board();
+		if (bitCount((uint64_t) board()) > mMaxPieces || state.castlingRights()
+				|| state.enPassantSqr())
+			return false;
+
+		unsigned counts[Player::COUNT][Piece::COUNT];
+		for (unsigned player = 0; player < Player::COUNT; ++player) {
+			for (unsigned piece = 0; piece < Piece::COUNT; ++piece)
+				counts[player][piece] = bitCount((uint64_t) board(Player(player), Piece(piece)));
+		}
+		auto it = mEntries.find(materialKey(counts[Player::WHITE], counts[Player::BLACK]));
+		if (it == mEntries.end())
+			return false;
+
+		const Tablebase& tb = *it->second.tablebase;
+		bool flip = it->second.flip;
+		Sqr sqrs[Tablebase::MAX_PIECES];
+		for (unsigned i = 0; i < tb.pieceCount();) {
+			Player player = flip ? ~tb.player(i) : tb.player(i);
+			for (Sqr sqr : board(player, tb.piece(i)))
+				sqrs[i++] = flip ? Sqr(sqr ^ 56) : sqr;
+		}
+		Player activePlayer = flip ? ~state.activePlayer() : state.activePlayer();
+		uint64_t idx = tb.index(sqrs);
+		if (idx == tb.size())
+			return false;
+		uint8_t value = tb.value(activePlayer, idx);
+		if (value == Tablebase::INVALID)
+			return false;
+		score = Tablebase::toScore(value);
+		return true;
+	}
+
+private:
+
+	/* Piece counts packed in 3 bits per piece type (kings excluded). */
+	static uint32_t materialKey(const unsigned* white, const unsigned* black)
+	{
+		uint32_t key = 0;
+		for (unsigned piece = Piece::QUEEN; piece < Piece::COUNT; ++piece)
+			key |= std::min(white[piece], 7u) << 3 * (piece - 1) | std::min(black[piece], 7u)
+					<< 3 * (piece + 4);
+		return key;
+	}
+};
+
+}
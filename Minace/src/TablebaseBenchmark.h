@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Tablebase.h"
+#include "GameState.h"
+#include "BitBoard.h"
+#include "Logger.h"
+#include "Util.h"
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstdint>
+
+namespace mnc {
+
+/**
+ * Measures the latency of Tablebases::probe() with random valid positions of the loaded tables.
+ */
+class TablebaseBenchmark
+{
+private:
+	static constexpr unsigned POSITIONS = 10000;
+
+	Logger& mLogger;
+
+	const Tablebases& mTablebases;
+
+	double mLength;
+
+	std::vector<GameState> mStates;
+
+public:
+
+	TablebaseBenchmark(Logger& logger, const Tablebases& tablebases, double length)
+	: mLogger(logger), mTablebases(tablebases), mLength(length)
+	{
+		std::mt19937_64 rng(1234);
+		for (size_t i = 0; i < tablebases.size() * 100000 && mStates.size() < POSITIONS; ++i) {
+			const Tablebase& tb = tablebases[rng() % tablebases.size()];
+			Player activePlayer(rng() & 1);
+			uint64_t idx = rng() % tb.size();
+			if (tb.value(activePlayer, idx) == Tablebase::INVALID)
+				continue;
+			Sqr sqrs[Tablebase::MAX_PIECES];
+			tb.decode(idx, sqrs);
+			BitBoard board;
+			for (unsigned j = 0; j < tb.pieceCount(); ++j)
+				board.addPiece(tb.player(j), tb.piece(j), sqrs[j]);
+			mStates.emplace_back(board, activePlayer, Mask(), Sqr::NONE, 0);
+		}
+	}
+
+	void operator ()()
+	{
+		if (mStates.empty())
+			return;
+		uint64_t probes = 0, found = 0;
+		int64_t checksum = 0;
+		double time = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		while (time < mLength) {
+			for (const GameState& state : mStates) {
+				int score;
+				if (mTablebases.probe(state, score)) {
+					++found;
+					checksum += score;
+				}
+			}
+			probes += mStates.size();
+			auto dur = std::chrono::high_resolution_clock::now() - start;
+			time = std::chrono::duration_cast<std::chrono::nanoseconds>(dur).count() * 1e-9;
+		}
+		mLogger.logMessage(strFormat(200, "probes=%llu found=%llu ns/probe=%.1f checksum=%lld",
+				(unsigned long long) probes, (unsigned long long) found, time * 1e9 / probes,
+				(long long) checksum));
+	}
+};
+
+}
@@ -0,0 +1,622 @@
+#pragma once
+
+#include "Tablebase.h"
+#include "MoveMasks.h"
+#include "Logger.h"
+#include "Piece.h"
+#include "Player.h"
+#include "Sqr.h"
+#include "Mask.h"
+#include "Util.h"
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <functional>
+#include <cstdlib>
+#include <stdexcept>
+#include <cstdint>
+
+namespace mnc {
+
+/**
+ * Generates tablebases with retrograde analysis. All tables reachable by captures and promotions
+ * are generated first (or taken from the collection if already loaded).
+ *
+ * Each position gets a counter of its distinct successor positions in the same table. Positions
+ * are resolved in order of distance to mate: mated positions first, then predecessors of lost
+ * positions are won, and predecessors of won positions whose counter drops to zero are lost.
+ * Captures and promotions lead to other tables and are evaluated once in the beginning. The
+ * positions resolved on each ply are processed by all threads; counters and resolved flags are
+ * updated atomically.
+ *
+ * The table has no en passant square, so a double push that can be captured en passant leads to a
+ * position that is better for the opponent than the one in the table. If an en passant capture
+ * wins for the opponent, the push is evaluated as a losing exit by the distance of the capture
+ * (rarely a move longer than the loss through the table position). If one draws, the push can't
+ * win. If all of them lose, the push wins only when the table position is lost too, by the longer
+ * of the two distances.
+ */
+class TablebaseGenerator
+{
+private:
+	static constexpr uint8_t RESOLVED = 0x80;
+
+	static constexpr unsigned MAX_MOVES = 128;
+
+	/* Table and piece mapping for positions reached by a capture and/or promotion. */
+	struct Exit
+	{
+		// Null if only kings are left.
+		const Tablebase* tablebase;
+
+		bool flip;
+
+		// Index of the piece in the original table for each piece of the exit table.
+		unsigned pieceMap[Tablebase::MAX_PIECES];
+	};
+
+	/* Outcome of the en passant captures after a double push for the side that captures, in
+	 * plies. */
+	struct EnPassant
+	{
+		bool any, draw;
+
+		// Fastest win (MAX_PLIES + 1 if none) and longest loss.
+		unsigned win, loss;
+	};
+
+	/* Position of the table being generated. */
+	struct Position
+	{
+		Sqr sqrs[Tablebase::MAX_PIECES];
+
+		Mask occupied, pieces[Player::COUNT];
+	};
+
+	Logger& mLogger;
+
+	Tablebases& mTablebases;
+
+	std::string mDirectory;
+
+	unsigned mThreadCount;
+
+	// State of the table being generated.
+	Tablebase* mTb;
+
+	// Exits by captured piece, promoted piece and promotion type (pieceCount = none).
+	Exit mExits[Tablebase::MAX_PIECES + 1][Tablebase::MAX_PIECES + 1][Piece::COUNT];
+
+	// Resolved flag and the remaining successor count of each position.
+	std::unique_ptr<std::atomic<uint8_t>[]> mStates[Player::COUNT];
+
+	// Positions resolved on each ply (index * 2 + active player).
+	std::vector<std::vector<uint64_t>> mResolved, mExitWins;
+
+public:
+
+	/* Generated tables are added to the collection and written to the directory unless it is
+	 * empty. */
+	TablebaseGenerator(Logger& logger, Tablebases& tablebases, const std::string& directory,
+			unsigned threadCount = std::thread::hardware_concurrency())
+	: mLogger(logger), mTablebases(tablebases), mDirectory(directory),
+	mThreadCount(std::max(1u, threadCount)), mTb(nullptr)
+	{
+	}
+
+	/* Generates the table unless it is already in the collection. */
+	const Tablebase& generate(const std::string& name)
+	{
+		if (const Tablebase* tb = mTablebases.find(name))
+			return *tb;
+
+		std::unique_ptr<Tablebase> tb(new Tablebase(name));
+		std::vector<Player> players;
+		std::vector<Piece> pieces;
+		for (unsigned i = 0; i < tb->pieceCount(); ++i) {
+			players.push_back(tb->player(i));
+			pieces.push_back(tb->piece(i));
+		}
+		bool flip;
+		std::string canonical = Tablebase::canonicalName(players, pieces, flip);
+		if (canonical != name)
+			throw std::invalid_argument("Tablebase " + name + " should be " + canonical + ".");
+
+		initExits(*tb);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		mTb = tb.get();
+		for (unsigned player = 0; player < Player::COUNT; ++player) {
+			mTb->values(Player(player)).assign(mTb->size(), (uint8_t) Tablebase::DRAW);
+			mStates[player].reset(new std::atomic<uint8_t>[mTb->size()]);
+		}
+		mResolved.assign(Tablebase::MAX_PLIES + 2, std::vector<uint64_t>());
+		mExitWins.assign(Tablebase::MAX_PLIES + 2, std::vector<uint64_t>());
+
+		runThreads([this](unsigned thread, std::vector<std::vector<uint64_t>>& resolved,
+				std::vector<std::vector<uint64_t>>& exitWins) {
+			uint64_t begin = mTb->size() * thread / mThreadCount;
+			uint64_t end = mTb->size() * (thread + 1) / mThreadCount;
+			for (uint64_t idx = begin; idx < end; ++idx) {
+				initPosition(Player::WHITE, idx, resolved, exitWins);
+				initPosition(Player::BLACK, idx, resolved, exitWins);
+			}
+		});
+		double initTime = elapsed(start);
+
+		unsigned plies = 0;
+		for (unsigned ply = 0; ply <= Tablebase::MAX_PLIES; ++ply) {
+			for (uint64_t pos : mExitWins[ply]) {
+				uint8_t state = mStates[pos & 1][pos >> 1];
+				if (!(state & RESOLVED)
+						&& mStates[pos & 1][pos >> 1].compare_exchange_strong(state, RESOLVED)) {
+					mTb->values(Player(pos & 1))[pos >> 1] = (ply + 1) / 2;
+					mResolved[ply].push_back(pos);
+				}
+			}
+			std::vector<uint64_t>().swap(mExitWins[ply]);
+			if (!mResolved[ply].empty())
+				plies = ply;
+			runThreads([this, ply](unsigned thread, std::vector<std::vector<uint64_t>>& resolved,
+					std::vector<std::vector<uint64_t>>& exitWins) {
+				const std::vector<uint64_t>& positions = mResolved[ply];
+				size_t begin = positions.size() * thread / mThreadCount;
+				size_t end = positions.size() * (thread + 1) / mThreadCount;
+				for (size_t i = begin; i < end; ++i)
+					resolvePredecessors(Player(positions[i] & 1), positions[i] >> 1, ply,
+							resolved, exitWins);
+			});
+			std::vector<uint64_t>().swap(mResolved[ply]);
+		}
+		if (!mResolved[Tablebase::MAX_PLIES + 1].empty())
+			throw std::runtime_error("Distance to mate is too long in " + name + ".");
+
+		// Unresolved positions are draws. Invalid positions have been resolved as INVALID.
+		uint64_t counts[3] = {};
+		for (unsigned player = 0; player < Player::COUNT; ++player) {
+			std::vector<uint8_t>& values = mTb->values(Player(player));
+			for (uint64_t idx = 0; idx < mTb->size(); ++idx) {
+				if (!(mStates[player][idx] & RESOLVED))
+					values[idx] = Tablebase::DRAW;
+				uint8_t value = values[idx];
+				++counts[value == Tablebase::INVALID ? 2 : value == Tablebase::DRAW ? 1 : 0];
+			}
+			mStates[player].reset();
+		}
+		double time = elapsed(start);
+
+		uint64_t fileSize = 0;
+		if (!mDirectory.empty()) {
+			std::ofstream ofs(mDirectory + "/" + name + ".mtb", std::ios::binary);
+			mTb->write(ofs);
+			fileSize = (uint64_t) ofs.tellp();
+		}
+		mLogger.logMessage(strFormat(300, "%s: %.2fs (init %.2fs), %llu positions, %llu decisive, "
+				"%llu draws, longest mate %u plies, file %llu bytes", name.c_str(), time, initTime,
+				(unsigned long long) (counts[0] + counts[1]), (unsigned long long) counts[0],
+				(unsigned long long) counts[1], plies, (unsigned long long) fileSize));
+
+		mTb = nullptr;
+		mTablebases.add(std::move(tb));
+		return *mTablebases.find(name);
+	}
+
+private:
+
+	/* Runs the function in all threads with thread local lists of resolved positions and exit
+	 * wins by ply, which are merged to the global lists after the threads finish. */
+	template<typename TFunc>
+	void runThreads(TFunc func)
+	{
+		typedef std::vector<std::vector<uint64_t>> Lists;
+		std::vector<Lists> resolved(mThreadCount, Lists(mResolved.size()));
+		std::vector<Lists> exitWins(mThreadCount, Lists(mExitWins.size()));
+		std::vector<std::thread> threads;
+		for (unsigned t = 0; t < mThreadCount; ++t)
+			threads.emplace_back(func, t, std::ref(resolved[t]), std::ref(exitWins[t]));
+		for (std::thread& th : threads)
+			th.join();
+		for (unsigned t = 0; t < mThreadCount; ++t) {
+			for (size_t ply = 0; ply < mResolved.size(); ++ply) {
+				mResolved[ply].insert(mResolved[ply].end(), resolved[t][ply].begin(),
+						resolved[t][ply].end());
+				mExitWins[ply].insert(mExitWins[ply].end(), exitWins[t][ply].begin(),
+						exitWins[t][ply].end());
+			}
+		}
+	}
+
+	/* Generates the tables reached by captures and promotions and sets up the piece mapping. */
+	void initExits(const Tablebase& tb)
+	{
+		// Generating the other tables overwrites the member, so the exits are collected here.
+		Exit exits[Tablebase::MAX_PIECES + 1][Tablebase::MAX_PIECES + 1][Piece::COUNT];
+		unsigned n = tb.pieceCount();
+		for (unsigned captured = 2; captured <= n; ++captured) {
+			for (unsigned promoted = 2; promoted <= n; ++promoted) {
+				if (promoted < n && (tb.piece(promoted) != Piece::PAWN
+						|| (captured < n && tb.player(captured) == tb.player(promoted))))
+					continue;
+				for (unsigned type = Piece::QUEEN; type <= Piece::KNIGHT; ++type) {
+					if (captured == n && promoted == n)
+						continue;
+					std::vector<Player> players;
+					std::vector<Piece> pieces;
+					std::vector<unsigned> original;
+					for (unsigned i = 0; i < n; ++i) {
+						if (i == captured)
+							continue;
+						players.push_back(tb.player(i));
+						pieces.push_back(i == promoted ? Piece(type) : tb.piece(i));
+						original.push_back(i);
+					}
+					unsigned count = pieces.size();
+					Exit& exit = exits[captured][promoted][type];
+					exit.tablebase = nullptr;
+					if (count == 2)
+						continue;
+					std::string name = Tablebase::canonicalName(players, pieces, exit.flip);
+					exit.tablebase = &generate(name);
+
+					// Map each piece of the exit table to a piece of this table.
+					bool used[Tablebase::MAX_PIECES] = {};
+					for (unsigned k = 0; k < count; ++k) {
+						Player player = exit.flip ? ~exit.tablebase->player(k)
+								: exit.tablebase->player(k);
+						for (unsigned j = 0; j < count; ++j) {
+							if (!used[j] && players[j] == player
+									&& pieces[j] == exit.tablebase->piece(k)) {
+								used[j] = true;
+								exit.pieceMap[k] = original[j];
+								break;
+							}
+						}
+					}
+				}
+			}
+		}
+		std::copy(&exits[0][0][0], &exits[0][0][0] + sizeof (exits) / sizeof (Exit),
+				&mExits[0][0][0]);
+	}
+
+	/* Value of the position after a capture and/or promotion. */
+	uint8_t exitValue(const Exit& exit, const Sqr* sqrs, Player activePlayer) const
+	{
+		if (!exit.tablebase)
+			return Tablebase::DRAW;
+		Sqr exitSqrs[Tablebase::MAX_PIECES];
+		for (unsigned k = 0; k < exit.tablebase->pieceCount(); ++k) {
+			Sqr sqr = sqrs[exit.pieceMap[k]];
+			exitSqrs[k] = exit.flip ? Sqr(sqr ^ 56) : sqr;
+		}
+		return exit.tablebase->value(exit.flip ? ~activePlayer : activePlayer,
+				exit.tablebase->index(exitSqrs));
+	}
+
+	/* Decodes the position and checks that it is valid with the given player to move. */
+	bool decode(Player activePlayer, uint64_t idx, Position& pos) const
+	{
+		mTb->decode(idx, pos.sqrs);
+		pos.occupied = pos.pieces[Player::WHITE] = pos.pieces[Player::BLACK] = 0;
+		for (unsigned i = 0; i < mTb->pieceCount(); ++i) {
+			Sqr sqr = pos.sqrs[i];
+			if (pos.occupied & sqr)
+				return false;
+			if (mTb->piece(i) == Piece::PAWN && (sqr.row() == 0 || sqr.row() == 7))
+				return false;
+			pos.occupied |= sqr;
+			pos.pieces[mTb->player(i)] |= sqr;
+		}
+		return mTb->index(pos.sqrs) == idx
+				&& !isAttacked(pos.sqrs, pos.sqrs[~activePlayer], activePlayer, pos.occupied,
+				mTb->pieceCount());
+	}
+
+	/* Counts the successors in this table and evaluates captures and promotions. */
+	void initPosition(Player activePlayer, uint64_t idx,
+			std::vector<std::vector<uint64_t>>& resolved,
+			std::vector<std::vector<uint64_t>>& exitWins)
+	{
+		std::atomic<uint8_t>& state = mStates[activePlayer][idx];
+		uint8_t& value = mTb->values(activePlayer)[idx];
+		Position pos;
+		if (!decode(activePlayer, idx, pos)) {
+			state = RESOLVED;
+			value = Tablebase::INVALID;
+			return;
+		}
+
+		uint64_t successors[MAX_MOVES];
+		unsigned count = 0, moveCount = 0;
+		unsigned exitWin = Tablebase::MAX_PLIES + 1, exitLoss = 0;
+		bool exitDraw = false;
+		Player opponent = ~activePlayer;
+		forEachMove(activePlayer, pos, [&](const Sqr* sqrs, const Exit* exit) {
+			++moveCount;
+			if (!exit) {
+				EnPassant ep = enPassant(activePlayer, pos.sqrs, sqrs);
+				if (ep.win <= Tablebase::MAX_PLIES) {
+					exitLoss = std::max(exitLoss, ep.win + 1);
+					return;
+				}
+				uint64_t succ = mTb->index(sqrs);
+				if (std::find(successors, successors + count, succ) == successors + count)
+					successors[count++] = succ;
+				return;
+			}
+			uint8_t v = exitValue(*exit, sqrs, opponent);
+			if (v == Tablebase::DRAW)
+				exitDraw = true;
+			else if (v >= Tablebase::LOSS)
+				exitWin = std::min(exitWin, 2u * (v - Tablebase::LOSS) + 1);
+			else
+				exitLoss = std::max(exitLoss, 2u * v);
+		});
+
+		if (moveCount == 0) {
+			bool mated = isAttacked(pos.sqrs, pos.sqrs[activePlayer], opponent, pos.occupied,
+					mTb->pieceCount());
+			state = RESOLVED;
+			value = mated ? Tablebase::LOSS : Tablebase::DRAW;
+			if (mated)
+				resolved[0].push_back(idx * 2 + activePlayer);
+		} else if (exitWin <= Tablebase::MAX_PLIES) {
+			// One extra count so that the position is never resolved as lost.
+			state = count + 1;
+			value = (exitWin + 1) / 2;
+			exitWins[exitWin].push_back(idx * 2 + activePlayer);
+		} else if (exitDraw) {
+			state = count + 1;
+		} else if (count == 0) {
+			state = RESOLVED;
+			value = Tablebase::LOSS + exitLoss / 2;
+			resolved[exitLoss].push_back(idx * 2 + activePlayer);
+		} else {
+			// The longest loss by captures or promotions is stored until the position is resolved.
+			state = count;
+			value = Tablebase::LOSS + exitLoss / 2;
+		}
+	}
+
+	/* Resolves the predecessors of a position resolved on given ply. Wins that are delayed by en
+	 * passant captures are added to the exit wins. */
+	void resolvePredecessors(Player activePlayer, uint64_t idx, unsigned ply,
+			std::vector<std::vector<uint64_t>>& resolved,
+			std::vector<std::vector<uint64_t>>& exitWins)
+	{
+		Position pos;
+		decode(activePlayer, idx, pos);
+		Player mover = ~activePlayer;
+		uint64_t predecessors[MAX_MOVES];
+		unsigned count = 0;
+
+		forEachUnmove(mover, pos, [&](const Sqr* sqrs) {
+			uint64_t pred = mTb->index(sqrs);
+			if (std::find(predecessors, predecessors + count, pred) != predecessors + count)
+				return;
+			predecessors[count++] = pred;
+
+			// The double push was either not counted as a successor (en passant wins) or it
+			// can't win before the en passant captures are lost.
+			EnPassant ep = enPassant(mover, sqrs, pos.sqrs);
+			if (ep.win <= Tablebase::MAX_PLIES || (ply % 2 == 0 && ep.draw))
+				return;
+			if (ply % 2 == 0 && ep.any && ep.loss > ply) {
+				if (ep.loss < Tablebase::MAX_PLIES)
+					exitWins[ep.loss + 1].push_back(pred * 2 + mover);
+				else
+					resolved[Tablebase::MAX_PLIES + 1].push_back(pred * 2 + mover);
+				return;
+			}
+
+			std::atomic<uint8_t>& state = mStates[mover][pred];
+			uint8_t& value = mTb->values(mover)[pred];
+			uint8_t s = state;
+			if (ply % 2 == 0) {
+				// Position is lost, so the predecessor is won.
+				while (!(s & RESOLVED)) {
+					if (state.compare_exchange_weak(s, RESOLVED)) {
+						value = (ply + 2) / 2;
+						resolved[ply + 1].push_back(pred * 2 + mover);
+						break;
+					}
+				}
+			} else {
+				// Position is won, so one less successor can save the predecessor.
+				while (!(s & RESOLVED)) {
+					uint8_t next = s - 1 ? s - 1 : RESOLVED;
+					if (state.compare_exchange_weak(s, next)) {
+						if (next == RESOLVED) {
+							unsigned lossPly = std::max(ply + 1, 2u * (value - Tablebase::LOSS));
+							value = Tablebase::LOSS + lossPly / 2;
+							resolved[std::min(lossPly, Tablebase::MAX_PLIES + 1)].push_back(
+									pred * 2 + mover);
+						}
+						break;
+					}
+				}
+			}
+		});
+	}
+
+	/* En passant captures of the opponent if the player's move from the squares before to the
+	 * squares after is a double pawn push. */
+	EnPassant enPassant(Player player, const Sqr* before, const Sqr* after) const
+	{
+		EnPassant ep = {false, false, Tablebase::MAX_PLIES + 1, 0};
+		unsigned n = mTb->pieceCount(), pawn = 0;
+		while (pawn < n && before[pawn] == after[pawn])
+			++pawn;
+		if (pawn == n || mTb->piece(pawn) != Piece::PAWN
+				|| std::abs((int) after[pawn] - (int) before[pawn]) != 16)
+			return ep;
+
+		Player opponent = ~player;
+		Sqr passed((before[pawn] + after[pawn]) / 2);
+		Mask occupied;
+		for (unsigned i = 0; i < n; ++i)
+			occupied |= after[i];
+		Sqr sqrs[Tablebase::MAX_PIECES];
+		std::copy(after, after + n, sqrs);
+		for (unsigned i = 0; i < n; ++i) {
+			if (mTb->player(i) != opponent || mTb->piece(i) != Piece::PAWN
+					|| !(attacks(opponent, Piece::PAWN, after[i], occupied) & passed))
+				continue;
+			sqrs[i] = passed;
+			Mask captureOccupied = (occupied & ~Mask(after[i]) & ~Mask(after[pawn])) | passed;
+			if (!isAttacked(sqrs, sqrs[opponent], player, captureOccupied, n, pawn)) {
+				ep.any = true;
+				uint8_t v = exitValue(mExits[pawn][n][Piece::QUEEN], sqrs, player);
+				if (v == Tablebase::DRAW)
+					ep.draw = true;
+				else if (v >= Tablebase::LOSS)
+					ep.win = std::min(ep.win, 2u * (v - Tablebase::LOSS) + 1);
+				else
+					ep.loss = std::max(ep.loss, 2u * v);
+			}
+			sqrs[i] = after[i];
+		}
+		return ep;
+	}
+
+	/* Calls func(sqrs, exit) for each legal move. Exit is null for moves within the table. */
+	template<typename TFunc>
+	void forEachMove(Player player, const Position& pos, TFunc func) const
+	{
+		unsigned n = mTb->pieceCount();
+		Player opponent = ~player;
+		Sqr sqrs[Tablebase::MAX_PIECES];
+		std::copy(pos.sqrs, pos.sqrs + n, sqrs);
+		for (unsigned i = 0; i < n; ++i) {
+			if (mTb->player(i) != player)
+				continue;
+			Sqr from = pos.sqrs[i];
+			Piece piece = mTb->piece(i);
+			Mask targets;
+			if (piece == Piece::PAWN) {
+				Sqr push(player == Player::WHITE ? from - 8 : from + 8);
+				if (!(pos.occupied & push)) {
+					targets |= push;
+					Sqr doublePush(player == Player::WHITE ? from - 16 : from + 16);
+					if (from.row() == (player == Player::WHITE ? 6u : 1u)
+							&& !(pos.occupied & doublePush))
+						targets |= doublePush;
+				}
+				targets |= attacks(player, piece, from, pos.occupied) & pos.pieces[opponent];
+			} else {
+				targets = attacks(player, piece, from, pos.occupied) & ~pos.pieces[player];
+			}
+
+			for (Sqr to : targets) {
+				unsigned captured = n;
+				if (pos.pieces[opponent] & to) {
+					for (captured = 0; sqrs[captured] != to || captured == i; ++captured)
+						;
+				}
+				sqrs[i] = to;
+				Mask occupied = (pos.occupied & ~Mask(from)) | to;
+				bool legal = !isAttacked(sqrs, sqrs[player], opponent, occupied, n, captured);
+				if (legal) {
+					bool promotion = piece == Piece::PAWN && (to.row() == 0 || to.row() == 7);
+					if (captured == n && !promotion) {
+						func(sqrs, (const Exit*) nullptr);
+					} else if (!promotion) {
+						func(sqrs, &mExits[captured][n][Piece::QUEEN]);
+					} else {
+						for (unsigned type = Piece::QUEEN; type <= Piece::KNIGHT; ++type)
+							func(sqrs, &mExits[captured][i][type]);
+					}
+				}
+				sqrs[i] = from;
+			}
+		}
+	}
+
+	/* Calls func(sqrs) for each position from which the player can reach this position with a
+	 * move that is not a capture or promotion. */
+	template<typename TFunc>
+	void forEachUnmove(Player player, const Position& pos, TFunc func) const
+	{
+		unsigned n = mTb->pieceCount();
+		Sqr sqrs[Tablebase::MAX_PIECES];
+		std::copy(pos.sqrs, pos.sqrs + n, sqrs);
+		for (unsigned i = 0; i < n; ++i) {
+			if (mTb->player(i) != player)
+				continue;
+			Sqr to = pos.sqrs[i];
+			Piece piece = mTb->piece(i);
+			Mask origins;
+			if (piece == Piece::PAWN) {
+				Sqr back(player == Player::WHITE ? to + 8 : to - 8);
+				if (back.row() != (player == Player::WHITE ? 7u : 0u) && !(pos.occupied & back)) {
+					origins |= back;
+					Sqr doubleBack(player == Player::WHITE ? to + 16 : to - 16);
+					if (to.row() == (player == Player::WHITE ? 4u : 3u)
+							&& !(pos.occupied & doubleBack))
+						origins |= doubleBack;
+				}
+			} else {
+				origins = attacks(player, piece, to, pos.occupied) & ~pos.occupied;
+			}
+
+			for (Sqr from : origins) {
+				sqrs[i] = from;
+				Mask occupied = (pos.occupied & ~Mask(to)) | from;
+				if (!isAttacked(sqrs, sqrs[~player], player, occupied, n))
+					func(sqrs);
+			}
+			sqrs[i] = to;
+		}
+	}
+
+	/* Checks whether the square is attacked by the player's pieces (except the captured one). */
+	bool isAttacked(const Sqr* sqrs, Sqr sqr, Player player, Mask occupied, unsigned n,
+			unsigned captured = Tablebase::MAX_PIECES) const
+	{
+		for (unsigned i = 0; i < n; ++i) {
+			if (mTb->player(i) == player && i != captured
+					&& (attacks(player, mTb->piece(i), sqrs[i], occupied) & sqr))
+				return true;
+		}
+		return false;
+	}
+
+	static Mask attacks(Player player, Piece piece, Sqr sqr, Mask occupied)
+	{
+		switch (piece) {
+		case Piece::KING:
+			return MoveMasks::KING_MOVES[sqr];
+		case Piece::QUEEN:
+			return MoveMasks::getQueenMoves(sqr, occupied);
+		case Piece::ROOK:
+			return MoveMasks::getRookMoves(sqr, occupied);
+		case Piece::BISHOP:
+			return MoveMasks::getBishopMoves(sqr, occupied);
+		case Piece::KNIGHT:
+			return MoveMasks::KNIGHT_MOVES[sqr];
+		default:
+			Mask mask;
+			unsigned row = sqr.row() - 1 + 2 * player;
+			if (row < 8) {
+				if (sqr.col() > 0)
+					mask |= Sqr(row * 8 + sqr.col() - 1);
+				if (sqr.col() < 7)
+					mask |= Sqr(row * 8 + sqr.col() + 1);
+			}
+			return mask;
+		}
+	}
+
+	static double elapsed(std::chrono::high_resolution_clock::time_point start)
+	{
+		auto dur = std::chrono::high_resolution_clock::now() - start;
+		return std::chrono::duration_cast<std::chrono::microseconds>(dur).count() * 1e-6;
+	}
+};
+
+}
@@ -12,6 +12,7 @@ namespace mnc {
  * 2) Time
  * 3) Node count
  * 4) Standard chess clocks with time left, increment (using Fischer delay) and moves left.
+ * In addition the search can be turned into a mate search by giving the number of moves.
  * If no constraints are specified the search is infinite and must be stopped by explicity calling
  * stop(), or if the AI decides to stop itself (e.g. when finds a guaranteed mate).
  */
@@ -28,6 +29,9 @@ public:
 	// Limit by number of searched nodes. 0 if not used.
 	unsigned long long nodes;
 
+	// Search for mate in given number of moves. 0 if not used.
+	unsigned mate;
+
 	// Initial clock value. 0 if clock is not used.
 	double clockInitialValue[Player::COUNT];
 
@@ -57,7 +61,7 @@ public:
 
 	TimeConstraint(double clock, double clockIncrement, unsigned clockMovesLeft = 0,
 			unsigned depth = 0, double time = 0, unsigned long long nodes = 0)
-	: depth(depth), time(time), nodes(nodes), clockMovesInitialValue(clockMovesLeft),
+	: depth(depth), time(time), nodes(nodes), mate(0), clockMovesInitialValue(clockMovesLeft),
 	clockMovesLeft(clockMovesLeft)
 	{
 		clockInitialValue[Player::WHITE] = clock;
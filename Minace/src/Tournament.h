@@ -1,6 +1,8 @@
 #pragma once
 
 #include "Game.h"
+#include "GameGenerator.h"
+#include "Pgn.h"
 #include "ExternalUciEngine.h"
 #include "VarStats.h"
 #include <ostream>
@@ -89,6 +91,9 @@ private:
 
 	bool mLogEngines;
 
+	// Games are appended to this file in PGN if not empty.
+	std::string mPgnFile;
+
 public:
 
 	Tournament(const std::string& tournamentFile, std::ostream& out)
@@ -117,6 +122,8 @@ public:
 				ss >> mOutputDir;
 			} else if (cmd == "log_engines") {
 				ss >> mLogEngines;
+			} else if (cmd == "pgn") {
+				ss >> mPgnFile;
 			} else if (cmd == "engine") {
 				std::string tmp;
 				ss >> tmp;
@@ -229,7 +236,8 @@ private:
 		ExternalUciEngine p2(mExecutableFileNames[opponentIdx],{}, mLogEngines ?  &elog2 : nullptr,
 				"E" + std::to_string(opponentIdx));
 
-		GameState state = generateRandomOpening(6);
+		std::mt19937_64 rng(std::random_device{}());
+		GameState state = GameGenerator::createOpening(6, rng);
 		//mOut << state.toStr(true) << std::endl;
 		double score = playMatch(state, p1, p2);
 		score += 1 - playMatch(state, p2, p1);
@@ -257,6 +265,8 @@ private:
 	{
 		Game game(white, black, mTimeConstraint, state, this);
 		game.run();
+		if (!mPgnFile.empty())
+			writePgn(game, state);
 
 		if (game.result() == Player::WHITE)
 			return 1.0;
@@ -266,6 +276,33 @@ private:
 			return 0.5;
 	}
 
+	void writePgn(Game& game, const GameState& startState)
+	{
+		PgnGame pgn;
+		pgn.startState = startState;
+		pgn.result = game.result() == Player::WHITE ? "1-0"
+				: game.result() == Player::BLACK ? "0-1" : "1/2-1/2";
+		pgn.tags = {
+			{"Event", "Minace tournament"},
+			{"White", game.player(Player::WHITE).name()},
+			{"Black", game.player(Player::BLACK).name()},
+			{"Result", pgn.result},
+			{"SetUp", "1"},
+			{"FEN", startState.toStr()}
+		};
+		GameState state = startState;
+		for (Move move : game.moves()) {
+			if (!state.isLegalMove(move))
+				break;
+			pgn.moves.push_back(move);
+			state.makeMove(move);
+		}
+
+		std::lock_guard<std::mutex> l(mMutex);
+		std::ofstream ofs(mPgnFile, std::ios_base::out | std::ios_base::app);
+		PgnWriter::write(ofs, pgn);
+	}
+
 	virtual void notifyMove(Game& game, unsigned ply, GamePlayer& player,
 			Move move, double time) override
 	{
@@ -301,29 +338,6 @@ private:
 			mOut << name << " ran out of time. " << std::endl;
 		}
 	}
-
-	GameState generateRandomOpening(unsigned depth)
-	{
-		std::mt19937_64 rng(std::random_device{}
-		());
-
-		GameState state;
-		std::vector<Move> moves;
-		for (unsigned i = 0; i < depth; ++i) {
-			moves.clear();
-			state.getLegalMoves(moves);
-			std::uniform_int_distribution<unsigned> distr(0, moves.size() - 1);
-			for (;;) {
-				Move move = moves[distr(rng)];
-				state.makeMove(move);
-				if (!state.isCheckMate() && !state.isStaleMate())
-					break;
-				state.undoMove(move);
-			}
-		}
-
-		return state;
-	}
 };
 
 #endif
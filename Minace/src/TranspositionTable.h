@@ -35,14 +35,14 @@ private:
 
 	size_t mSize;
 
-	unsigned mPrevWrites, mCurrentWrites, mTotalWrites, mLookups;
+	unsigned mPrevWrites, mCurrentWrites, mTotalWrites, mLookups, mHits;
 
 	uint8_t mSearchIdx;
 
 public:
 
 	explicit TranspositionTable(size_t capacityBytes)
-	: mPrevWrites(0), mTotalWrites(0), mLookups(0), mSearchIdx(0)
+	: mPrevWrites(0), mTotalWrites(0), mLookups(0), mHits(0), mSearchIdx(0)
 	{
 		clear(capacityBytes);
 	}
@@ -68,13 +68,13 @@ public:
 #endif
 
 		size_t b = (size_t) id & mMask;
-		if (mEntries[b].id == id)
-			return &mEntries[b];
-		if (mEntries[b + 1].id == id)
-			return &mEntries[b + 1];
-
-		return nullptr;
+		if (mEntries[b].id != id && mEntries[++b].id != id)
+			return nullptr;
 
+#if CM_EXTRA_INFO
+		++mHits;
+#endif
+		return &mEntries[b];
 	}
 
 	void clear(size_t capacityBytes)
@@ -114,6 +114,11 @@ public:
 		return mLookups;
 	}
 
+	uint64_t hits() const
+	{
+		return mHits;
+	}
+
 	uint64_t writes() const
 	{
 		return mCurrentWrites + mTotalWrites;
@@ -121,8 +126,8 @@ public:
 
 	void startNewSearch()
 	{
-		if (++mSearchIdx == 0)
-			++mSearchIdx;
+		if (++mSearchIdx > StateInfo::MAX_AGE)
+			mSearchIdx = 1;
 
 		if (std::max(mCurrentWrites, mPrevWrites) < mLimit << 2 && mLimit > MIN_LIMIT)
 			shrinkLimit();
@@ -0,0 +1,543 @@
+#pragma once
+
+#include "Evaluator.h"
+#include "GameState.h"
+#include "PackedPosition.h"
+#include "Pgn.h"
+#include "Scores.h"
+#include "Logger.h"
+#include "Intrinsics.h"
+#include "Util.h"
+#include <vector>
+#include <array>
+#include <string>
+#include <istream>
+#include <ostream>
+#include <thread>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+
+namespace mnc {
+
+/**
+ * Labeled positions for tuning in structure of arrays layout. Each position takes 59 bytes: a
+ * bitboard for each piece type and for white pieces, the score of the terms that are not tuned
+ * and the game result.
+ */
+class TuningSet
+{
+public:
+
+	std::vector<uint64_t> pieces[Piece::COUNT];
+
+	std::vector<uint64_t> whitePieces;
+
+	// Pawn structure, mobility, king attack and material imbalance score from white's point of
+	// view.
+	std::vector<int16_t> fixedScores;
+
+	// 0 = black wins, 1 = draw, 2 = white wins.
+	std::vector<uint8_t> results;
+
+	void add(const BitBoard& board, int fixedScore, unsigned result)
+	{
+		for (unsigned pieceType = 0; pieceType < Piece::COUNT; ++pieceType)
+			pieces[pieceType].push_back((uint64_t) board(Player::WHITE, Piece(pieceType))
+				| (uint64_t) board(Player::BLACK, Piece(pieceType)));
+		whitePieces.push_back((uint64_t) board(Player::WHITE));
+		fixedScores.push_back(std::max(-32767, std::min(fixedScore, 32767)));
+		results.push_back(result);
+	}
+
+	size_t size() const
+	{
+		return results.size();
+	}
+};
+
+/**
+ * Texel tuner for the piece-square tables in Scores. Positions are resolved with quiescence search
+ * when loaded, and the leaf of the principal variation is stored. The tuner then minimizes the
+ * mean squared error between the game results and the sigmoid of the evaluation, using Adam
+ * gradient descent with the gradient calculated in parallel threads.
+ *
+ * The tuned parameters are the middle game tables of all pieces and the end game tables of king
+ * and pawn (other pieces use the same table in both phases). Piece values are included in the
+ * tables, and the output is written in the format used in Scores.h.
+ */
+class Tuner
+{
+public:
+	static constexpr unsigned PARAM_COUNT = (Piece::COUNT + 2) * Sqr::COUNT;
+
+private:
+	static constexpr unsigned MAX_QUIESCENCE_PLY = 8;
+
+	static constexpr size_t LOAD_BATCH_SIZE = 1 << 16;
+
+	static constexpr double BETA1 = 0.9, BETA2 = 0.999, EPSILON = 1e-8;
+
+	/* Quiescence search that collects the principal variation. One per thread. */
+	class Resolver
+	{
+	private:
+		Evaluator mEvaluator;
+
+		std::vector<Move> mMoves[MAX_QUIESCENCE_PLY];
+
+		Move mPv[MAX_QUIESCENCE_PLY][MAX_QUIESCENCE_PLY];
+
+		unsigned mPvLengths[MAX_QUIESCENCE_PLY];
+
+	public:
+
+		Resolver()
+		: mEvaluator(MAX_QUIESCENCE_PLY)
+		{
+		}
+
+		/* Moves the state to the end of the quiescence search PV. */
+		void resolve(GameState& state)
+		{
+			mEvaluator.reset(state);
+			search(state, -Scores::INF, Scores::INF, 0);
+			for (unsigned i = 0; i < mPvLengths[0]; ++i)
+				state.makeMove(mPv[0][i]);
+		}
+
+	private:
+
+		int search(GameState& state, int alpha, int beta, unsigned ply)
+		{
+			mPvLengths[ply] = ply;
+			int standPat = mEvaluator.evaluateUncached(state);
+			if (standPat >= beta || ply + 1 == MAX_QUIESCENCE_PLY)
+				return standPat;
+			alpha = std::max(alpha, standPat);
+
+			std::vector<Move>& moves = mMoves[ply];
+			moves.clear();
+			state.getLegalMoves(moves);
+			for (Move move : moves) {
+				if (!move.isCapture() && !move.isPromotion())
+					continue;
+				Sqr enPassantSqr = state.enPassantSqr();
+				state.makeMove(move);
+				mEvaluator.makeMove(move, enPassantSqr);
+				int score = -search(state, -beta, -alpha, ply + 1);
+				mEvaluator.undoMove();
+				state.undoMove(move);
+
+				if (score > alpha) {
+					alpha = score;
+					mPv[ply][ply] = move;
+					for (unsigned i = ply + 1; i < mPvLengths[ply + 1]; ++i)
+						mPv[ply][i] = mPv[ply + 1][i];
+					mPvLengths[ply] = std::max(mPvLengths[ply + 1], ply + 1);
+					if (alpha >= beta)
+						break;
+				}
+			}
+			return alpha;
+		}
+	};
+
+	Logger& mLogger;
+
+	unsigned mThreadCount;
+
+	TuningSet mSet;
+
+	std::vector<double> mParams;
+
+	// Scaling constant of the sigmoid.
+	double mK;
+
+public:
+
+	explicit Tuner(Logger& logger, unsigned threadCount = std::thread::hardware_concurrency())
+	: mLogger(logger), mThreadCount(std::max(1u, threadCount)), mParams(PARAM_COUNT), mK(1.0)
+	{
+		for (unsigned pieceType = 0; pieceType < Piece::COUNT; ++pieceType) {
+			int material = pieceType == Piece::KING ? Scores::PIECE_VALUES[Piece::KING] : 0;
+			for (unsigned sqr = 0; sqr < Sqr::COUNT; ++sqr) {
+				mParams[mgIndex(pieceType, sqr)] =
+						Scores::POSITIONAL_PIECE_VALUES[Player::WHITE][pieceType][sqr] - material;
+				mParams[egIndex(pieceType, sqr)] =
+						Scores::ENDGAME_POSITIONAL_PIECE_VALUES[Player::WHITE][pieceType][sqr]
+						- material;
+			}
+		}
+	}
+
+	/* Loads positions from EPD/FEN lines that contain the game result (see parseResult()).
+	 * Positions without result and positions in check are skipped. */
+	void load(std::istream& is)
+	{
+		std::vector<std::string> lines;
+		std::string line;
+		size_t lineCount = 0;
+		while (std::getline(is, line)) {
+			lines.push_back(line);
+			++lineCount;
+			if (lines.size() == LOAD_BATCH_SIZE) {
+				addBatch(lines);
+				lines.clear();
+			}
+		}
+		addBatch(lines);
+		mLogger.logMessage(strFormat(200, "Loaded %zu positions from %zu lines.", mSet.size(),
+				lineCount));
+	}
+
+	/* Loads positions of the games in PGN, labeled with the game result. Games without result
+	 * and games that cannot be parsed are skipped. */
+	void loadPgn(std::istream& is)
+	{
+		PgnReader reader(is);
+		PgnGame game;
+		std::vector<GameState> states;
+		std::vector<double> results;
+		size_t gameCount = 0;
+		for (;;) {
+			try {
+				if (!reader.next(game))
+					break;
+			} catch (const std::invalid_argument&) {
+				continue;
+			}
+			double result;
+			if (!parseResult(game.result, result))
+				continue;
+			++gameCount;
+			GameState state = game.startState;
+			for (Move move : game.moves) {
+				state.makeMove(move);
+				states.emplace_back(state.board(), state.activePlayer(), state.castlingRights(),
+						state.enPassantSqr(), state.halfMoveClock());
+				results.push_back(result);
+			}
+			if (states.size() >= LOAD_BATCH_SIZE) {
+				add(states, results);
+				states.clear();
+				results.clear();
+			}
+		}
+		add(states, results);
+		mLogger.logMessage(strFormat(200, "Loaded %zu positions from %zu games.", mSet.size(),
+				gameCount));
+	}
+
+	/* Loads positions in the binary format written by DataGenerator. */
+	void loadPacked(std::istream& is)
+	{
+		std::vector<PackedPosition> positions(LOAD_BATCH_SIZE);
+		size_t count = 0;
+		for (;;) {
+			is.read((char*) positions.data(), positions.size() * sizeof (PackedPosition));
+			size_t n = is.gcount() / sizeof (PackedPosition);
+			if (n == 0)
+				break;
+			std::vector<GameState> states;
+			std::vector<double> results;
+			for (size_t i = 0; i < n; ++i) {
+				states.push_back(positions[i].unpack());
+				results.push_back(0.5 * positions[i].result);
+			}
+			add(states, results);
+			count += n;
+		}
+		mLogger.logMessage(strFormat(200, "Loaded %zu positions from %zu records.", mSet.size(),
+				count));
+	}
+
+	/* Resolves the position with quiescence search and adds it. Result is from white's point of
+	 * view (0, 0.5 or 1). */
+	void addPosition(const GameState& state, double result)
+	{
+		std::vector<GameState> states{state};
+		std::vector<double> results{result};
+		add(states, results);
+	}
+
+	/* Finds the sigmoid scaling constant that minimizes the error with the current parameters. */
+	void optimizeK()
+	{
+		double lo = 0.1, hi = 3.0;
+		for (int i = 0; i < 30; ++i) {
+			double k1 = lo + (hi - lo) / 3, k2 = hi - (hi - lo) / 3;
+			mK = k1;
+			double e1 = error();
+			mK = k2;
+			double e2 = error();
+			if (e1 < e2)
+				hi = k2;
+			else
+				lo = k1;
+		}
+		mK = (lo + hi) / 2;
+		mLogger.logMessage(strFormat(200, "K=%.4f error=%.6f", mK, error()));
+	}
+
+	void tune(unsigned iterations, double learningRate = 1.0)
+	{
+		std::vector<double> m(PARAM_COUNT), v(PARAM_COUNT), gradient;
+		for (unsigned t = 1; t <= iterations; ++t) {
+			double e = calculateGradient(gradient);
+			for (unsigned i = 0; i < PARAM_COUNT; ++i) {
+				m[i] = BETA1 * m[i] + (1 - BETA1) * gradient[i];
+				v[i] = BETA2 * v[i] + (1 - BETA2) * gradient[i] * gradient[i];
+				double mHat = m[i] / (1 - std::pow(BETA1, t));
+				double vHat = v[i] / (1 - std::pow(BETA2, t));
+				mParams[i] -= learningRate * mHat / (std::sqrt(vHat) + EPSILON);
+			}
+			if (t % 50 == 0 || t == iterations)
+				mLogger.logMessage(strFormat(200, "Iteration %u error=%.6f", t, e));
+		}
+	}
+
+	/* Mean squared error of the predicted results. */
+	double error() const
+	{
+		std::vector<double> errors(mThreadCount);
+		parallelFor([this, &errors](unsigned thread, size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				double e = 0.5 * mSet.results[i] - sigmoid(evaluate(i));
+				errors[thread] += e * e;
+			}
+		});
+		double sum = 0;
+		for (double e : errors)
+			sum += e;
+		return mSet.size() ? sum / mSet.size() : 0;
+	}
+
+	/* Evaluation of position i from white's point of view with the current parameters. */
+	double evaluate(size_t i) const
+	{
+		double mg = 0, eg = 0;
+		int phase = 0;
+		forEachPiece(i, [this, &mg, &eg, &phase](unsigned pieceType, unsigned sqr, int sign) {
+			mg += sign * mParams[mgIndex(pieceType, sqr)];
+			eg += sign * mParams[egIndex(pieceType, sqr)];
+			phase += Scores::PHASE_WEIGHTS[pieceType];
+		});
+		phase = std::min(phase, (int) Scores::MAX_PHASE);
+		return (mg * phase + eg * (Scores::MAX_PHASE - phase)) / Scores::MAX_PHASE
+				+ mSet.fixedScores[i];
+	}
+
+	/* Writes the tables in the format of Scores.h. */
+	void write(std::ostream& os) const
+	{
+		static const char* names[Piece::COUNT] = {
+			"King", "Queen", "Rook", "Bishop", "Knight", "Pawn"
+		};
+
+		os << "// Tuned with " << mSet.size() << " positions, K=" << mK << ", error=" << error()
+				<< std::endl << std::endl;
+
+		os << "template<typename TScore>" << std::endl;
+		os << "TScore Scores_t<TScore>::ENDGAME_POSITIONAL_PIECE_VALUES"
+				<< "[Player::COUNT][Piece::COUNT][Sqr::COUNT]{" << std::endl << "\t{" << std::endl;
+		writeTable(os, names[Piece::KING], Piece::KING, false);
+		os << "," << std::endl << "\t\t{}, {}, {}, {}," << std::endl;
+		writeTable(os, names[Piece::PAWN], Piece::PAWN, false);
+		os << std::endl << "\t}" << std::endl << "};" << std::endl << std::endl;
+
+		os << "template<typename TScore>" << std::endl;
+		os << "TScore Scores_t<TScore>::POSITIONAL_PIECE_VALUES"
+				<< "[Player::COUNT][Piece::COUNT][Sqr::COUNT]{" << std::endl << "\t{" << std::endl;
+		for (unsigned pieceType = 0; pieceType < Piece::COUNT; ++pieceType) {
+			writeTable(os, names[pieceType], pieceType, true);
+			os << (pieceType + 1 < Piece::COUNT ? "," : "") << std::endl;
+		}
+		os << "\t}" << std::endl << "};" << std::endl;
+	}
+
+	const TuningSet& set() const
+	{
+		return mSet;
+	}
+
+	/* Parses game result from a line: "1-0", "0-1", "1/2-1/2" (e.g. in c9 operation) or a number
+	 * in brackets ("[1.0]", "[0.5]", "[0.0]"). Result is from white's point of view. */
+	static bool parseResult(const std::string& line, double& result)
+	{
+		if (line.find("1/2-1/2") != std::string::npos) {
+			result = 0.5;
+		} else if (line.find("1-0") != std::string::npos) {
+			result = 1.0;
+		} else if (line.find("0-1") != std::string::npos) {
+			result = 0.0;
+		} else {
+			size_t idx = line.find('[');
+			if (idx == std::string::npos)
+				return false;
+			char* end;
+			result = std::strtod(line.c_str() + idx + 1, &end);
+			if (*end != ']' || (result != 0.0 && result != 0.5 && result != 1.0))
+				return false;
+		}
+		return true;
+	}
+
+private:
+
+	static unsigned mgIndex(unsigned pieceType, unsigned sqr)
+	{
+		return pieceType * Sqr::COUNT + sqr;
+	}
+
+	static unsigned egIndex(unsigned pieceType, unsigned sqr)
+	{
+		if (pieceType == Piece::KING)
+			return Piece::COUNT * Sqr::COUNT + sqr;
+		if (pieceType == Piece::PAWN)
+			return (Piece::COUNT + 1) * Sqr::COUNT + sqr;
+		return mgIndex(pieceType, sqr);
+	}
+
+	/* Calls f(pieceType, sqr, sign) for each piece of position i. Black squares are mirrored to
+	 * white's side and sign is -1 for black. */
+	template<typename F>
+	void forEachPiece(size_t i, F f) const
+	{
+		uint64_t white = mSet.whitePieces[i];
+		for (unsigned pieceType = 0; pieceType < Piece::COUNT; ++pieceType) {
+			uint64_t pieces = mSet.pieces[pieceType][i];
+			for (uint64_t m = pieces & white; m; m &= m - 1)
+				f(pieceType, countTrailingZeros(m), 1);
+			for (uint64_t m = pieces & ~white; m; m &= m - 1)
+				f(pieceType, countTrailingZeros(m) ^ 56, -1);
+		}
+	}
+
+	double sigmoid(double score) const
+	{
+		return 1.0 / (1.0 + std::pow(10.0, -mK * score / 400));
+	}
+
+	/* Calculates gradient of the error and returns the error. */
+	double calculateGradient(std::vector<double>& gradient) const
+	{
+		std::vector<std::vector<double>> gradients(mThreadCount,
+				std::vector<double>(PARAM_COUNT));
+		std::vector<double> errors(mThreadCount);
+		parallelFor([this, &gradients, &errors](unsigned thread, size_t begin, size_t end) {
+			std::vector<double>& g = gradients[thread];
+			for (size_t i = begin; i < end; ++i) {
+				double s = sigmoid(evaluate(i));
+				double e = 0.5 * mSet.results[i] - s;
+				errors[thread] += e * e;
+
+				// Derivative of the squared error by the score.
+				double d = -2 * e * s * (1 - s) * mK * std::log(10.0) / 400;
+				int phase = 0;
+				forEachPiece(i, [&phase](unsigned pieceType, unsigned, int) {
+					phase += Scores::PHASE_WEIGHTS[pieceType];
+				});
+				double mgWeight = std::min(phase, (int) Scores::MAX_PHASE)
+						/ (double) Scores::MAX_PHASE;
+				forEachPiece(i, [&g, d, mgWeight](unsigned pieceType, unsigned sqr, int sign) {
+					g[mgIndex(pieceType, sqr)] += sign * d * mgWeight;
+					g[egIndex(pieceType, sqr)] += sign * d * (1 - mgWeight);
+				});
+			}
+		});
+
+		gradient.assign(PARAM_COUNT, 0.0);
+		double error = 0;
+		for (unsigned t = 0; t < mThreadCount; ++t) {
+			for (unsigned i = 0; i < PARAM_COUNT; ++i)
+				gradient[i] += gradients[t][i] / mSet.size();
+			error += errors[t];
+		}
+		return error / mSet.size();
+	}
+
+	/* Splits the positions evenly for the threads and calls f(thread, begin, end). */
+	template<typename F>
+	void parallelFor(F f) const
+	{
+		parallelFor(mSet.size(), f);
+	}
+
+	template<typename F>
+	void parallelFor(size_t n, F f) const
+	{
+		std::vector<std::thread> threads;
+		for (unsigned t = 0; t < mThreadCount; ++t)
+			threads.emplace_back(f, t, n * t / mThreadCount, n * (t + 1) / mThreadCount);
+		for (std::thread& th : threads)
+			th.join();
+	}
+
+	void addBatch(const std::vector<std::string>& lines)
+	{
+		std::vector<GameState> states;
+		std::vector<double> results;
+		for (const std::string& line : lines) {
+			double result;
+			if (!parseResult(line, result))
+				continue;
+			try {
+				states.emplace_back(line);
+				results.push_back(result);
+			} catch (const std::invalid_argument&) {
+				// Skip invalid positions.
+			}
+		}
+		add(states, results);
+	}
+
+	/* Resolves the positions in parallel and adds them in the original order. */
+	void add(std::vector<GameState>& states, const std::vector<double>& results)
+	{
+		std::vector<uint8_t> valid(states.size());
+		std::vector<int> fixedScores(states.size());
+		parallelFor(states.size(), [&states, &valid, &fixedScores](unsigned, size_t begin,
+				size_t end) {
+			Resolver resolver;
+			for (size_t i = begin; i < end; ++i) {
+				GameState& state = states[i];
+				const BitBoard& board = state.board();
+				if (!board(Player::WHITE, Piece::KING) || !board(Player::BLACK, Piece::KING)
+						|| state.isKingChecked(state.activePlayer()))
+					continue;
+				resolver.resolve(state);
+				MaterialTable::Entry material;
+				MaterialTable::calculate(state.board().materialKey(), material);
+				fixedScores[i] = Evaluator::evaluatePawns(state.board())
+						+ Evaluator::evaluateActivity(state.board()) + material.imbalance;
+				valid[i] = true;
+			}
+		});
+
+		for (size_t i = 0; i < states.size(); ++i) {
+			if (valid[i])
+				mSet.add(states[i].board(), fixedScores[i], (unsigned) std::lround(2 * results[i]));
+		}
+	}
+
+	void writeTable(std::ostream& os, const char* name, unsigned pieceType, bool middlegame) const
+	{
+		int material = pieceType == Piece::KING ? 0 : Scores::PIECE_VALUES[pieceType];
+		os << "\t\t// " << name << std::endl << "\t\t{" << std::endl;
+		for (unsigned row = 0; row < 8; ++row) {
+			os << "\t\t\t";
+			for (unsigned col = 0; col < 8; ++col) {
+				unsigned sqr = 8 * row + col;
+				unsigned idx = middlegame ? mgIndex(pieceType, sqr) : egIndex(pieceType, sqr);
+				os << std::lround(mParams[idx]) - material << (col < 7 ? ", " : "");
+			}
+			os << (row < 7 ? "," : "") << std::endl;
+		}
+		os << "\t\t}";
+	}
+};
+
+}
@@ -5,11 +5,17 @@
 #include "BitBoard.h"
 #include "GameState.h"
 #include "Move.h"
+#include "PolyglotBook.h"
+#include "SearchBenchmark.h"
+#include "Logger.h"
 #include <sstream>
 #include <memory>
 #include <vector>
 #include <thread>
 #include <chrono>
+#include <fstream>
+#include <random>
+#include <algorithm>
 
 namespace mnc {
 
@@ -20,6 +26,25 @@ class Uci : public InfoCallback
 {
 private:
 
+	/* Writes log messages to the UCI output. */
+	class OutputLogger : public Logger
+	{
+	private:
+		std::ostream& mOut;
+
+	public:
+
+		OutputLogger(std::ostream& out)
+		: mOut(out)
+		{
+		}
+
+		virtual void logMessage(const std::string& msg) override
+		{
+			mOut << msg << std::endl;
+		}
+	};
+
 	std::istream& mIn;
 
 	std::ostream& mOut, & mLog;
@@ -32,10 +57,27 @@ private:
 
 	std::chrono::high_resolution_clock::time_point mStartTime;
 
+	unsigned mMultiPv;
+
+	std::shared_ptr<const NnueWeights> mNnueWeights;
+
+	std::shared_ptr<const Tablebases> mTablebases;
+
+	std::shared_ptr<const Syzygy> mSyzygy;
+
+	unsigned mSyzygyProbeLimit;
+
+	std::unique_ptr<PolyglotBook> mBook;
+
+	bool mOwnBook;
+
+	std::mt19937_64 mBookRng;
+
 public:
 
 	Uci(std::istream& in, std::ostream& out, std::ostream& log)
-	: mIn(in), mOut(out), mLog(log), mAi(new MinMaxAI(this))
+	: mIn(in), mOut(out), mLog(log), mAi(new MinMaxAI(this)), mMultiPv(1),
+	mSyzygyProbeLimit(Syzygy::MAX_PIECES), mOwnBook(false), mBookRng(std::random_device{}())
 	{
 	}
 
@@ -67,6 +109,13 @@ private:
 			mOut << "id name Minace 1.0" << std::endl;
 			mOut << "id author T.A." << std::endl;
 			mOut << "option name Hash type spin default 32 min 1 max 8192" << std::endl;
+			mOut << "option name MultiPV type spin default 1 min 1 max 64" << std::endl;
+			mOut << "option name EvalFile type string default <empty>" << std::endl;
+			mOut << "option name OwnBook type check default false" << std::endl;
+			mOut << "option name BookFile type string default <empty>" << std::endl;
+			mOut << "option name TablebasePath type string default <empty>" << std::endl;
+			mOut << "option name SyzygyPath type string default <empty>" << std::endl;
+			mOut << "option name SyzygyProbeLimit type spin default 7 min 0 max 7" << std::endl;
 			mOut << "uciok" << std::endl;
 		} else if (cmd == "debug") {
 
@@ -87,6 +136,8 @@ private:
 				mAi->stop();
 		} else if (cmd == "ponderhit") {
 
+		} else if (cmd == "bench") {
+			bench(ss);
 		} else if (cmd == "quit") {
 			return false;
 		} else {
@@ -97,6 +148,15 @@ private:
 		return true;
 	}
 
+	/* Non-standard command "bench [depth]" that runs the search benchmark. */
+	void bench(std::stringstream& ss)
+	{
+		unsigned depth = SearchBenchmark::DEFAULT_DEPTH;
+		ss >> depth;
+		OutputLogger logger(mOut);
+		SearchBenchmark(logger, std::max(1u, depth))();
+	}
+
 	void setOption(std::stringstream& ss)
 	{
 		std::string s1, name, s2;
@@ -108,7 +168,104 @@ private:
 			ss >> value;
 			value = std::max(1u, std::min(value, 8192u));
 			mAi.reset(new MinMaxAI(this, value * (1ull << 20)));
+			mAi->setMultiPv(mMultiPv);
+			mAi->setNnue(mNnueWeights);
+			mAi->setTablebases(mTablebases);
+			mAi->setSyzygy(mSyzygy, mSyzygyProbeLimit);
+		} else if (name == "MultiPV") {
+			ss >> mMultiPv;
+			mAi->setMultiPv(mMultiPv);
+			mMultiPv = mAi->multiPv();
+		} else if (name == "EvalFile") {
+			setEvalFile(ss);
+		} else if (name == "OwnBook") {
+			std::string value;
+			ss >> value;
+			mOwnBook = value == "true";
+		} else if (name == "BookFile") {
+			setBookFile(ss);
+		} else if (name == "TablebasePath") {
+			setTablebasePath(ss);
+		} else if (name == "SyzygyPath") {
+			setSyzygyPath(ss);
+		} else if (name == "SyzygyProbeLimit") {
+			ss >> mSyzygyProbeLimit;
+			mSyzygyProbeLimit = std::min(mSyzygyProbeLimit, (unsigned) Syzygy::MAX_PIECES);
+			mAi->setSyzygy(mSyzygy, mSyzygyProbeLimit);
+		}
+	}
+
+	/* Opens Polyglot opening book. Empty value closes the book. */
+	void setBookFile(std::stringstream& ss)
+	{
+		std::string path;
+		std::getline(ss >> std::ws, path);
+		mBook.reset();
+		if (!path.empty() && path != "<empty>") {
+			try {
+				mBook.reset(new PolyglotBook(path));
+				mOut << "info string Opening book " << path << " with " << mBook->size()
+						<< " entries" << std::endl;
+			} catch (const std::exception& e) {
+				mOut << "info string Cannot open " << path << ": " << e.what() << std::endl;
+			}
+		}
+	}
+
+	/* Loads the tablebases found in the directory. Empty value disables tablebases. */
+	void setTablebasePath(std::stringstream& ss)
+	{
+		std::string path;
+		std::getline(ss >> std::ws, path);
+		mTablebases.reset();
+		if (!path.empty() && path != "<empty>") {
+			try {
+				std::shared_ptr<Tablebases> tablebases(new Tablebases());
+				unsigned count = tablebases->load(path);
+				mOut << "info string Loaded " << count << " tablebases from " << path << std::endl;
+				if (count)
+					mTablebases = tablebases;
+			} catch (const std::exception& e) {
+				mOut << "info string Cannot load tablebases from " << path << ": " << e.what()
+						<< std::endl;
+			}
+		}
+		mAi->setTablebases(mTablebases);
+	}
+
+	/* Finds Syzygy tables in the directories. The files are mapped when first probed. */
+	void setSyzygyPath(std::stringstream& ss)
+	{
+		std::string paths;
+		std::getline(ss >> std::ws, paths);
+		mSyzygy.reset();
+		if (!paths.empty() && paths != "<empty>") {
+			std::shared_ptr<Syzygy> syzygy(new Syzygy(paths));
+			mOut << "info string Found " << syzygy->size() << " Syzygy tablebases" << std::endl;
+			if (syzygy->size())
+				mSyzygy = syzygy;
 		}
+		mAi->setSyzygy(mSyzygy, mSyzygyProbeLimit);
+	}
+
+	/* Loads NNUE weights from the file. Empty value disables NNUE. */
+	void setEvalFile(std::stringstream& ss)
+	{
+		std::string path;
+		std::getline(ss >> std::ws, path);
+		mNnueWeights.reset();
+		if (!path.empty() && path != "<empty>") {
+			try {
+				std::ifstream file(path, std::ios::binary);
+				if (!file)
+					throw std::runtime_error("File not found.");
+				mNnueWeights = NnueWeights::load(file);
+				mOut << "info string NNUE evaluation using " << path << std::endl;
+			} catch (const std::exception& e) {
+				mOut << "info string Cannot load " << path << ": " << e.what() << std::endl;
+			}
+		}
+		mAi->setNnue(mNnueWeights);
 	}
 
 	void position(std::stringstream& ss)
@@ -148,7 +305,9 @@ private:
 	{
 		// Parameters
 		TimeConstraint tc;
-		bool infinite = false/*, ponder = false, mate = false*/;
+		bool infinite = false/*, ponder = false*/;
+		std::vector<Move> searchMoves;
+		bool readingSearchMoves = false;
 
 		auto getTime = [&](double& val) {
 			ss >> val;
@@ -158,6 +317,12 @@ private:
 		// Read go parameters
 		std::string cmd;
 		while (ss >> cmd) {
+			if (readingSearchMoves && cmd.size() >= 4 && isdigit(cmd[1]) && isdigit(cmd[3])) {
+				searchMoves.emplace_back(cmd, mPosition.board());
+				continue;
+			}
+			readingSearchMoves = false;
+
 			if (cmd == "wtime") {
 				getTime(tc.clock[Player::WHITE]);
 			} else if (cmd == "btime") {
@@ -177,11 +342,11 @@ private:
 			} else if (cmd == "nodes") {
 				ss >> tc.nodes;
 			} else if (cmd == "searchmoves") {
-				throw std::runtime_error("searchmoves not supported yet");
+				readingSearchMoves = true;
 			} else if (cmd == "ponder") {
 				//ponder = true;
 			} else if (cmd == "mate") {
-				//mate = true;
+				ss >> tc.mate;
 			}
 		}
 
@@ -191,22 +356,42 @@ private:
 		// Wait for previous thread to end.
 		cleanup();
 
+		// Play from the opening book without searching.
+		if (mOwnBook && mBook && !infinite && !tc.mate && searchMoves.empty()) {
+			Move bookMove = mBook->probe(mPosition, mBookRng);
+			if (bookMove) {
+				mOut << "info string book move" << std::endl;
+				mOut << "bestmove " << bookMove.toStr(true) << std::endl;
+				mLog << "Book move: " << bookMove.toStr() << std::endl;
+				return;
+			}
+		}
+
 		mStartTime = std::chrono::high_resolution_clock::now();
 
-		mAiThread.reset(new std::thread([this, tc]() {
+		mAiThread.reset(new std::thread([this, tc, searchMoves]() {
 			GameState mStateCopy = mPosition; // Copy in case mState is modified during getMove
-			Move bestMove = mAi->getMove(mStateCopy, tc);
+			Move bestMove = mAi->getMove(mStateCopy, tc, searchMoves);
 
 					mOut << "bestmove " << bestMove.toStr(true) << std::endl;
 					mLog << "Best move: " << bestMove.toStr() << std::endl;
 		}));
 	}
 
-	virtual void notifyPv(unsigned depth, int score, const std::vector<Move>& pv) override
+	virtual void notifyPv(unsigned multiPv, unsigned depth, unsigned selDepth, int score,
+			uint64_t nodes, double time, const std::vector<Move>& pv) override
 	{
 		mOut << "info";
+		mOut << " multipv " << multiPv;
 		mOut << " depth " << depth;
-		mOut << " score cp " << score;
+		mOut << " seldepth " << selDepth;
+		if (std::abs(score) > Scores::CHECK_MATE_THRESHOLD)
+			mOut << " score " << Scores::toStr(score);
+		else
+			mOut << " score cp " << score;
+		mOut << " nodes " << nodes;
+		mOut << " nps " << (uint64_t) (nodes / std::max(time, 1e-3));
+		mOut << " time " << (uint64_t) (time * 1e3);
 		mOut << " pv";
 		for (Move m : pv)
 			mOut << " " << m.toStr(true);
@@ -3,9 +3,95 @@
 #include <string>
 #include <cstring>
 #include <memory>
+#include <cmath>
+#include <ostream>
 
 namespace mnc {
 
+/**
+ * Non-owning view of a character sequence, e.g. a part of a string. The viewed characters must
+ * outlive the view.
+ */
+class StringView
+{
+private:
+	const char* mData;
+
+	size_t mSize;
+
+public:
+
+	constexpr StringView()
+	: mData(""), mSize(0)
+	{
+	}
+
+	constexpr StringView(const char* data, size_t size)
+	: mData(data), mSize(size)
+	{
+	}
+
+	StringView(const char* s)
+	: mData(s), mSize(std::strlen(s))
+	{
+	}
+
+	StringView(const std::string& s)
+	: mData(s.data()), mSize(s.size())
+	{
+	}
+
+	constexpr const char* data() const
+	{
+		return mData;
+	}
+
+	constexpr size_t size() const
+	{
+		return mSize;
+	}
+
+	constexpr bool empty() const
+	{
+		return !mSize;
+	}
+
+	constexpr const char* begin() const
+	{
+		return mData;
+	}
+
+	constexpr const char* end() const
+	{
+		return mData + mSize;
+	}
+
+	constexpr char operator[](size_t idx) const
+	{
+		return mData[idx];
+	}
+
+	std::string str() const
+	{
+		return std::string(mData, mSize);
+	}
+
+	friend bool operator==(StringView lhs, StringView rhs)
+	{
+		return lhs.mSize == rhs.mSize && !std::memcmp(lhs.mData, rhs.mData, lhs.mSize);
+	}
+
+	friend bool operator!=(StringView lhs, StringView rhs)
+	{
+		return !(lhs == rhs);
+	}
+
+	friend std::ostream& operator<<(std::ostream& os, StringView sv)
+	{
+		return os.write(sv.mData, sv.mSize);
+	}
+};
+
 template<typename ...TArgs>
 std::string strFormat(size_t len, const char* fmt, TArgs ...args)
 {
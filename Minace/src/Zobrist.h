@@ -3,8 +3,12 @@
 #include "Player.h"
 #include "Sqr.h"
 #include "Piece.h"
+#include "Move.h"
+#include "PackedMove.h"
 #include <random>
 #include <array>
+#include <algorithm>
+#include <cstdlib>
 #include <cstdint>
 
 namespace mnc {
@@ -23,12 +27,35 @@ public:
 
 	static T EMPTY_RND;
 
+	static constexpr unsigned CUCKOO_SIZE = 8192;
+
+	// Cuckoo hash table of the zobrist code changes of reversible moves (non-pawn moves on an empty
+	// board together with the change of the active player) for detecting upcoming repetitions.
+	// Each key is stored either in slot cuckooHash1(key) or cuckooHash2(key).
+	static std::array<T, CUCKOO_SIZE> CUCKOO_KEYS;
+
+	static std::array<PackedMove, CUCKOO_SIZE> CUCKOO_MOVES;
+
+	static constexpr unsigned cuckooHash1(T key)
+	{
+		return key & (CUCKOO_SIZE - 1);
+	}
+
+	static constexpr unsigned cuckooHash2(T key)
+	{
+		return key >> 16 & (CUCKOO_SIZE - 1);
+	}
+
 private:
 
 	Zobrist_t()
 	{
+		// Raw generator output rather than a distribution, as distributions are implementation
+		// defined and the keys must be the same with every standard library.
 		std::mt19937_64 rng(999);
-		std::uniform_int_distribution<T> rnd;
+		auto rnd = [](std::mt19937_64& rng) {
+			return (T) rng();
+		};
 		for (auto& x : PIECE_SQR_RND) {
 			for (auto& y : x) {
 				for (auto& z : y)
@@ -42,6 +69,46 @@ private:
 		for (T& x : CASTLINGRIGHTS_RND)
 			x = rnd(rng);
 
+		for (unsigned player = 0; player < Player::COUNT; ++player) {
+			for (unsigned piece = Piece::KING; piece < Piece::PAWN; ++piece) {
+				for (unsigned fromSqr = 0; fromSqr < Sqr::COUNT; ++fromSqr) {
+					for (unsigned toSqr = fromSqr + 1; toSqr < Sqr::COUNT; ++toSqr) {
+						if (isReversibleMove(Piece(piece), Sqr(fromSqr), Sqr(toSqr)))
+							addCuckooMove(Player(player), Piece(piece), Sqr(fromSqr), Sqr(toSqr));
+					}
+				}
+			}
+		}
+	}
+
+	static bool isReversibleMove(Piece piece, Sqr fromSqr, Sqr toSqr)
+	{
+		unsigned dr = std::abs((int) toSqr.row() - (int) fromSqr.row());
+		unsigned dc = std::abs((int) toSqr.col() - (int) fromSqr.col());
+		bool straight = dr == 0 || dc == 0, diagonal = dr == dc;
+		return piece == Piece::KING ? std::max(dr, dc) == 1
+				: piece == Piece::QUEEN ? straight || diagonal
+				: piece == Piece::ROOK ? straight
+				: piece == Piece::BISHOP ? diagonal
+				: dr * dc == 2;
+	}
+
+	static void addCuckooMove(Player player, Piece piece, Sqr fromSqr, Sqr toSqr)
+	{
+		T key = PIECE_SQR_RND[player][piece][fromSqr] ^ PIECE_SQR_RND[player][piece][toSqr]
+				^ PLAYER_RND;
+		PackedMove move(Move(fromSqr, toSqr, piece, Piece::NONE, piece));
+
+		// Insert in the first slot and move the replaced entry to its other slot until an empty
+		// slot is found.
+		unsigned i = cuckooHash1(key);
+		for (;;) {
+			std::swap(CUCKOO_KEYS[i], key);
+			std::swap(CUCKOO_MOVES[i], move);
+			if (!move)
+				break;
+			i = i == cuckooHash1(key) ? cuckooHash2(key) : cuckooHash1(key);
+		}
 	}
 
 	static Zobrist_t sInit;
@@ -62,6 +129,15 @@ std::array<T, Sqr::COUNT> Zobrist_t<T>::CASTLINGRIGHTS_RND;
 template<typename T>
 T Zobrist_t<T>::EMPTY_RND;
 
+template<typename T>
+constexpr unsigned Zobrist_t<T>::CUCKOO_SIZE;
+
+template<typename T>
+std::array<T, Zobrist_t<T>::CUCKOO_SIZE> Zobrist_t<T>::CUCKOO_KEYS;
+
+template<typename T>
+std::array<PackedMove, Zobrist_t<T>::CUCKOO_SIZE> Zobrist_t<T>::CUCKOO_MOVES;
+
 template<typename T>
 Zobrist_t<T> Zobrist_t<T>::sInit;
 
@@ -1,16 +1,33 @@
 #include "App.h"
 #include "Uci.h"
 #include "Tournament.h"
+#include "Tuner.h"
+#include "DataGenerator.h"
+#include "BookBuilder.h"
+#include "TablebaseGenerator.h"
+#include "TablebaseBenchmark.h"
+#include "EpdAnalyzer.h"
+#include "SearchBenchmark.h"
+#include "StdOutLogger.h"
+#include "StdErrLogger.h"
 #include <iostream>
 #include <sstream>
 #include <fstream>
 #include <memory>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <stdexcept>
+#include <algorithm>
 
 // Explicit instantiation for classes that have static initialization code.
 namespace mnc {
 template class Scores_t<int>;
 template class MoveMasks_t<Mask>;
 template class Zobrist_t<uint64_t>;
+template class SyzygySquares_t<uint64_t>;
+template class Endgames_t<uint32_t>;
 }
 
 int main(int argc, char** argv)
@@ -18,6 +35,21 @@ int main(int argc, char** argv)
 	int mode = 0;
 	std::unique_ptr<std::ostream> log(new std::stringstream);
 	std::string tournamentFile;
+	std::string tuneInputFile, tuneOutputFile;
+	unsigned tuneIterations = 1000;
+	std::string dataFile;
+	unsigned long long dataPositions = 0, dataNodes = 5000;
+	uint64_t dataSeed = std::random_device()();
+	std::string bookFile;
+	std::vector<std::string> pgnFiles;
+	std::string tbDirectory;
+	std::vector<std::string> tbNames;
+	std::string epdFile;
+	unsigned long long epdNodes = 1000000;
+	unsigned epdThreads = std::thread::hardware_concurrency();
+	std::string skillFile;
+	unsigned skillMillis = 1000;
+	unsigned benchDepth = mnc::SearchBenchmark::DEFAULT_DEPTH;
 
 	// Parse command line arguments.
 	for (int i = 1; i < argc; ++i) {
@@ -29,6 +61,55 @@ int main(int argc, char** argv)
 			mode = 2;
 			tournamentFile = argv[i];
 		}
+		if (strcmp(argv[i], "-tune") == 0 && i + 2 < argc) {
+			mode = 3;
+			tuneInputFile = argv[++i];
+			tuneOutputFile = argv[++i];
+			if (i + 1 < argc && isdigit(argv[i + 1][0]))
+				tuneIterations = atoi(argv[++i]);
+		}
+		if (strcmp(argv[i], "-datagen") == 0 && i + 2 < argc) {
+			mode = 4;
+			dataFile = argv[++i];
+			dataPositions = strtoull(argv[++i], nullptr, 10);
+			if (i + 1 < argc && isdigit(argv[i + 1][0]))
+				dataNodes = strtoull(argv[++i], nullptr, 10);
+			if (i + 1 < argc && isdigit(argv[i + 1][0]))
+				dataSeed = strtoull(argv[++i], nullptr, 10);
+		}
+		if (strcmp(argv[i], "-book") == 0 && i + 2 < argc) {
+			mode = 5;
+			bookFile = argv[++i];
+			while (i + 1 < argc && argv[i + 1][0] != '-')
+				pgnFiles.push_back(argv[++i]);
+		}
+		if (strcmp(argv[i], "-tbgen") == 0 && i + 1 < argc) {
+			mode = 6;
+			tbDirectory = argv[++i];
+			while (i + 1 < argc && argv[i + 1][0] != '-')
+				tbNames.push_back(argv[++i]);
+		}
+		if (strcmp(argv[i], "-epd") == 0 && i + 1 < argc) {
+			mode = 7;
+			epdFile = argv[++i];
+			if (i + 1 < argc && isdigit(argv[i + 1][0]))
+				epdNodes = strtoull(argv[++i], nullptr, 10);
+			if (i + 1 < argc && isdigit(argv[i + 1][0]))
+				epdThreads = atoi(argv[++i]);
+		}
+		if (strcmp(argv[i], "-skill") == 0 && i + 1 < argc) {
+			mode = 8;
+			skillFile = argv[++i];
+			if (i + 1 < argc && isdigit(argv[i + 1][0]))
+				skillMillis = atoi(argv[++i]);
+			if (i + 1 < argc && isdigit(argv[i + 1][0]))
+				epdThreads = atoi(argv[++i]);
+		}
+		if (strcmp(argv[i], "-bench") == 0) {
+			mode = 9;
+			if (i + 1 < argc && isdigit(argv[i + 1][0]))
+				benchDepth = std::max(1, atoi(argv[++i]));
+		}
 	}
 
 	if (mode == 0) {
@@ -45,6 +126,92 @@ int main(int argc, char** argv)
 		mnc::Tournament tournament(tournamentFile, std::cout);
 		tournament.run();
 #endif
+	} else if (mode == 3) {
+		// Tune piece-square tables from labeled positions.
+		mnc::StdOutLogger logger;
+		mnc::Tuner tuner(logger);
+		auto hasExtension = [&tuneInputFile](const char* ext) {
+			return tuneInputFile.size() > 4
+					&& tuneInputFile.compare(tuneInputFile.size() - 4, 4, ext) == 0;
+		};
+		std::ifstream ifs(tuneInputFile, hasExtension(".bin") ? std::ios::binary : std::ios::in);
+		if (hasExtension(".bin"))
+			tuner.loadPacked(ifs);
+		else if (hasExtension(".pgn"))
+			tuner.loadPgn(ifs);
+		else
+			tuner.load(ifs);
+		tuner.optimizeK();
+		tuner.tune(tuneIterations);
+		std::ofstream ofs(tuneOutputFile);
+		tuner.write(ofs);
+	} else if (mode == 4) {
+#ifdef __unix__
+		// Generate training data with self-play games.
+		mnc::StdOutLogger logger;
+		try {
+			mnc::DataGenerator generator(logger, dataFile, dataNodes,
+					std::thread::hardware_concurrency(), dataSeed);
+			generator.run(dataPositions);
+		} catch (const std::exception& e) {
+			logger.logMessage(e.what());
+		}
+#endif
+	} else if (mode == 5) {
+		// Build opening book from PGN files.
+		mnc::StdOutLogger logger;
+		mnc::BookBuilder builder(logger);
+		std::ofstream ofs(bookFile, std::ios::binary);
+		builder.build(pgnFiles, ofs);
+	} else if (mode == 6) {
+		// Generate endgame tablebases (names or piece counts) and measure probe latency.
+		mnc::StdOutLogger logger;
+		mnc::Tablebases tablebases;
+		auto start = std::chrono::steady_clock::now();
+		unsigned loaded = tablebases.load(tbDirectory);
+		std::chrono::duration<double> loadTime = std::chrono::steady_clock::now() - start;
+		logger.logMessage(mnc::strFormat(200, "Loaded %u tables in %.2fs.", loaded,
+				loadTime.count()));
+		mnc::TablebaseGenerator generator(logger, tablebases, tbDirectory);
+		try {
+			for (const std::string& name : tbNames) {
+				if (isdigit(name[0])) {
+					for (const std::string& n : mnc::Tablebase::names(atoi(name.c_str())))
+						generator.generate(n);
+				} else {
+					generator.generate(name);
+				}
+			}
+		} catch (const std::exception& e) {
+			logger.logMessage(e.what());
+		}
+		mnc::TablebaseBenchmark(logger, tablebases, 2)();
+	} else if (mode == 7) {
+		// Analyze EPD positions in parallel and write results as JSON lines.
+		mnc::StdErrLogger logger;
+		std::ifstream ifs(epdFile);
+		if (!ifs) {
+			logger.logMessage("Cannot open " + epdFile + ".");
+			return 1;
+		}
+		mnc::TimeConstraint tc(0u, 0.0, epdNodes);
+		mnc::EpdAnalyzer analyzer(logger, std::cout, tc,
+				mnc::EpdSuite::DEFAULT_HASH_BYTES, epdThreads);
+		analyzer.run(ifs);
+	} else if (mode == 8) {
+		// Run a skill test from an EPD file, e.g. WAC or ECM.
+		mnc::StdOutLogger logger;
+		std::ifstream ifs(skillFile);
+		if (!ifs) {
+			logger.logMessage("Cannot open " + skillFile + ".");
+			return 1;
+		}
+		mnc::SkillTest skillTest(ifs);
+		skillTest.run(mnc::TimeConstraint(0u, skillMillis * 1e-3), logger, epdThreads);
+	} else if (mode == 9) {
+		// Search benchmark. The node count is a signature of the search.
+		mnc::StdOutLogger logger;
+		mnc::SearchBenchmark(logger, benchDepth)();
 	}
 
 	return 0;
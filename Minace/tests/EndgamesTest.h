@@ -0,0 +1,114 @@
+#pragma once
+
+#include "../src/Endgames.h"
+#include "../src/Tablebase.h"
+#include "../src/TablebaseGenerator.h"
+#include "../src/MinMaxAI.h"
+#include "../src/GameState.h"
+#include "../src/Scores.h"
+#include "../src/NullLogger.h"
+#include "../ttest/ttest.h"
+
+namespace mnc {
+
+class EndgamesTest : public ttest::TestBase
+{
+private:
+
+	int evaluate(const std::string& fen, bool& exact)
+	{
+		GameState state(fen);
+		int score = -Scores::INF;
+		TTEST_EQUAL(Endgames::evaluate(state.board(), state.activePlayer(), score, exact), true);
+		return score;
+	}
+
+	int evaluate(const std::string& fen)
+	{
+		bool exact;
+		return evaluate(fen, exact);
+	}
+
+	TTEST_CASE("KPK bitbase matches the generated tablebase.")
+	{
+		Tablebases tablebases;
+		NullLogger logger;
+		TablebaseGenerator(logger, tablebases, "", 1).generate("KPvK");
+		uint64_t positions = 0, errors = 0;
+		for (unsigned strongKing = 0; strongKing < Sqr::COUNT; ++strongKing) {
+			for (unsigned pawn = 8; pawn < 56; ++pawn) {
+				for (unsigned weakKing = 0; weakKing < Sqr::COUNT; ++weakKing) {
+					if (strongKing == pawn || weakKing == pawn || weakKing == strongKing)
+						continue;
+					BitBoard board;
+					board.addPiece(Player::WHITE, Piece::KING, Sqr(strongKing));
+					board.addPiece(Player::WHITE, Piece::PAWN, Sqr(pawn));
+					board.addPiece(Player::BLACK, Piece::KING, Sqr(weakKing));
+					for (unsigned player = 0; player < Player::COUNT; ++player) {
+						GameState state(board, Player(player), Mask(), Sqr::NONE, 0);
+						int tbScore, score;
+						bool exact;
+						if (!tablebases.probe(state, tbScore))
+							continue; // Illegal position.
+						++positions;
+						Endgames::evaluate(board, Player(player), score, exact);
+						errors += (tbScore == Scores::DRAW) != (score == Scores::DRAW)
+								|| (tbScore == Scores::DRAW) != exact;
+					}
+				}
+			}
+		}
+		TTEST_EQUAL(positions > 300000, true);
+		TTEST_EQUAL(errors, 0u);
+	}
+
+	TTEST_CASE("King and pawn against king.")
+	{
+		TTEST_EQUAL(evaluate("4k3/8/4K3/4P3/8/8/8/8 w - - 0 1") > Scores::KNOWN_WIN, true);
+		TTEST_EQUAL(evaluate("4k3/8/4K3/4P3/8/8/8/8 b - - 0 1") < -Scores::KNOWN_WIN, true);
+		TTEST_EQUAL(evaluate("8/8/8/8/4p3/4k3/8/4K3 b - - 0 1") > Scores::KNOWN_WIN, true);
+		bool exact;
+		TTEST_EQUAL(evaluate("4k3/4P3/4K3/8/8/8/8/8 b - - 0 1", exact), (int) Scores::DRAW);
+		TTEST_EQUAL(exact, true);
+		TTEST_EQUAL(evaluate("8/8/8/8/p7/k7/8/K7 b - - 0 1", exact), (int) Scores::DRAW);
+		TTEST_EQUAL(exact, true);
+	}
+
+	TTEST_CASE("Draws and known wins.")
+	{
+		bool exact;
+		TTEST_EQUAL(evaluate("8/8/3k4/8/8/2B5/8/4K3 w - - 0 1", exact), (int) Scores::DRAW);
+		TTEST_EQUAL(exact, true);
+		TTEST_EQUAL(evaluate("8/8/3k4/8/8/2B1B3/8/4K3 w - - 0 1", exact), (int) Scores::DRAW);
+		TTEST_EQUAL(exact, true);
+		TTEST_EQUAL(evaluate("8/8/3k4/8/8/2N1N3/8/4K3 w - - 0 1", exact), (int) Scores::DRAW);
+		TTEST_EQUAL(exact, false);
+		TTEST_EQUAL(evaluate("8/8/3k4/8/8/2B2B2/8/4K3 w - - 0 1") > Scores::KNOWN_WIN, true);
+
+		// Rook drives the king to the edge, bishop and knight to a corner of the bishop's color.
+		TTEST_EQUAL(evaluate("3k4/8/8/8/8/8/8/R3K3 w - - 0 1")
+				> evaluate("8/8/8/3k4/8/8/8/R3K3 w - - 0 1"), true);
+		TTEST_EQUAL(evaluate("8/8/8/8/8/2K5/8/k1B1N3 w - - 0 1")
+				> evaluate("k7/8/8/8/8/2K5/8/2B1N3 w - - 0 1"), true);
+	}
+
+	TTEST_CASE("Rook pawn with the wrong bishop is drawn.")
+	{
+		bool exact;
+		TTEST_EQUAL(evaluate("7k/8/7P/6K1/8/8/8/3B4 w - - 0 1", exact), (int) Scores::DRAW);
+		TTEST_EQUAL(exact, false);
+		int score;
+		GameState state("7k/8/7P/6K1/8/8/8/2B5 w - - 0 1");
+		TTEST_EQUAL(Endgames::evaluate(state.board(), state.activePlayer(), score, exact), false);
+	}
+
+	TTEST_CASE("Search stops in known draws.")
+	{
+		GameState state("k7/8/K7/P7/8/8/8/8 w - - 0 1");
+		MinMaxAI ai;
+		ai.getMove(state, 12);
+		TTEST_EQUAL(ai.getScore(), (int) Scores::DRAW);
+	}
+};
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "../src/EpdAnalyzer.h"
+#include "../src/TimeConstraint.h"
+#include "../src/NullLogger.h"
+#include "../ttest/ttest.h"
+#include <sstream>
+#include <string>
+
+namespace mnc {
+
+class EpdAnalyzerTest : public ttest::TestBase
+{
+private:
+
+	TTEST_CASE("Writes JSON results in input order.")
+	{
+		std::stringstream in, out;
+		in << "r5rk/5p1p/5R2/4B3/8/8/7P/7K w - - bm Ra6+; id \"mate\";\n"
+				<< "# comment\n\n"
+				<< "6r1/1k6/N1b5/2P4r/4n3/7R/7K/1N6 b - - am Nf2;\n"
+				<< "8/8/8/8 w - -\n"
+				<< "8/8/8/8/8/k7/p7/K7 w - - 0 1\n"
+				<< "r5rk/5p1p/5R2/4B3/8/8/7P/7K w - - bm Qh5;\n";
+		NullLogger logger;
+		EpdAnalyzer analyzer(logger, out, TimeConstraint(0u, 0.0, 20000), 1 << 20, 2);
+		TTEST_EQUAL(analyzer.run(in), 1u);
+
+		std::string line;
+		std::getline(out, line);
+		TTEST_EQUAL(line.find("{\"index\":0,\"id\":\"mate\",\"bestmove\":\"f6a6\",\"san\":\"Ra6+\""),
+				0u);
+		TTEST_EQUAL(line.find("\"solved\":true}") != std::string::npos, true);
+		std::getline(out, line);
+		TTEST_EQUAL(line.find("{\"index\":1,\"bestmove\":\"e4f2\""), 0u);
+		TTEST_EQUAL(line.find("\"solved\":false}") != std::string::npos, true);
+		std::getline(out, line);
+		TTEST_EQUAL(line.find("{\"index\":2,\"error\":"), 0u);
+		std::getline(out, line);
+		TTEST_EQUAL(line.find("{\"index\":3,\"bestmove\":\"0000\""), 0u);
+		std::getline(out, line);
+		TTEST_EQUAL(line.find("{\"index\":4,\"error\":"), 0u);
+		TTEST_EQUAL(std::getline(out, line).fail(), true);
+	}
+
+	TTEST_CASE("Results don't depend on the thread count.")
+	{
+		const char* positions = "r5rk/5p1p/5R2/4B3/8/8/7P/7K w - -\n"
+				"6r1/1k6/N1b5/2P4r/4n3/7R/7K/1N6 b - -\n"
+				"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -\n"
+				"6r1/1k6/N1b5/2P4r/4n3/7R/7K/1N6 b - -\n";
+		std::string results[2];
+		for (unsigned i = 0; i < 2; ++i) {
+			std::stringstream in(positions), out;
+			NullLogger logger;
+			EpdAnalyzer(logger, out, TimeConstraint(5), 1 << 20, 1 + 2 * i).run(in);
+			for (std::string line; std::getline(out, line);) {
+				size_t time = line.find(",\"time\":");
+				results[i] += line.erase(time, line.find(',', time + 1) - time) + "\n";
+			}
+		}
+		TTEST_EQUAL(results[1], results[0]);
+	}
+
+	TTEST_CASE("Escapes JSON strings.")
+	{
+		TTEST_EQUAL(EpdAnalyzer::jsonString("a\"b\\c\n"), "\"a\\\"b\\\\c\\u000a\"");
+	}
+};
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "../src/EpdSuite.h"
+#include "../src/GameState.h"
+#include "../ttest/ttest.h"
+#include <sstream>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <stdexcept>
+
+namespace mnc {
+
+class EpdSuiteTest : public ttest::TestBase
+{
+private:
+
+	TTEST_CASE("Lines are read without comments and carriage returns.")
+	{
+		std::stringstream in("a\r\n# comment\n\nb\n#\nc");
+		EpdSuite suite(in);
+		TTEST_EQUAL(suite.size(), 3u);
+		TTEST_EQUAL(suite[0], "a");
+		TTEST_EQUAL(suite[1], "b");
+		TTEST_EQUAL(suite[2], "c");
+	}
+
+	TTEST_CASE("Each position is searched once with a new AI.")
+	{
+		EpdSuite suite({"a", "b", "c", "d", "e"});
+		std::mutex mutex;
+		std::vector<unsigned> visits(suite.size(), 0);
+		bool empty = true;
+		unsigned threadCount = suite.run<InfoCallback>(3, 1 << 20,
+				[&](size_t i, MinMaxAI& ai, InfoCallback& info) {
+			std::lock_guard<std::mutex> lock(mutex);
+			++visits[i];
+			empty &= ai.totalNodeCount() == 0;
+		});
+		TTEST_EQUAL(threadCount, 3u);
+		TTEST_EQUAL(visits == std::vector<unsigned>(suite.size(), 1), true);
+		TTEST_EQUAL(empty, true);
+		TTEST_EQUAL(EpdSuite({"a"}).run<InfoCallback>(8, 1 << 20,
+				[](size_t, MinMaxAI&, InfoCallback&) {}), 1u);
+	}
+
+	TTEST_CASE("Solutions are parsed from SAN.")
+	{
+		GameState state("r5rk/5p1p/5R2/4B3/8/8/7P/7K w - - 0 1");
+		std::vector<Move> bestMoves = EpdSuite::parseSanMoves(state, "Ra6+ Rxf7");
+		TTEST_EQUAL(bestMoves.size(), 2u);
+		TTEST_EQUAL(bestMoves[0].toStr(true), "f6a6");
+		TTEST_EQUAL(EpdSuite::parseSanMoves(state, StringView()).empty(), true);
+		bool thrown = false;
+		try {
+			EpdSuite::parseSanMoves(state, "Ra6 Qh5");
+		} catch (const std::invalid_argument&) {
+			thrown = true;
+		}
+		TTEST_EQUAL(thrown, true);
+
+		TTEST_EQUAL(EpdSuite::isSolution(bestMoves, {}, bestMoves[1]), true);
+		TTEST_EQUAL(EpdSuite::isSolution({}, bestMoves, bestMoves[1]), false);
+		TTEST_EQUAL(EpdSuite::isSolution({bestMoves[0]}, {}, bestMoves[1]), false);
+	}
+};
+
+}
@@ -62,6 +62,42 @@ private:
 		TTEST_EQUAL(Epd("8/8/8/8/1P6/8/8/3K4 b - b3 7 22").halfMoveClock(), 7);
 		TTEST_EQUAL(Epd("8/8/8/8/1P6/8/8/3K4 b - b3 7 22").fullMoveNumber(), 22);
 	}
+
+	TTEST_CASE("Reads EPD operations.")
+	{
+		Epd epd("4r3/4P1p1/4k3/2B3pp/1R2K3/r6P/1p4P1/8 b - - bm Ra4 Rb3;  id \"easy 002\"; c0;");
+		TTEST_EQUAL(epd.operationCount(), 3u);
+		TTEST_EQUAL(epd.opcode(1), "id");
+		TTEST_EQUAL(epd.operand(1), "\"easy 002\"");
+		TTEST_EQUAL(epd.operation("bm"), "Ra4 Rb3");
+		TTEST_EQUAL(epd.operation("id"), "easy 002");
+		TTEST_EQUAL(epd.hasOperation("c0"), true);
+		TTEST_EQUAL(epd.operation("c0"), "");
+		TTEST_EQUAL(epd.hasOperation("am"), false);
+
+		epd = Epd("8/8/8/8/1P6/8/8/3K4 b - b3 7 22 hmvc 7; pv b3");
+		TTEST_EQUAL(epd.fullMoveNumber(), 22);
+		TTEST_EQUAL(epd.operation("hmvc"), "7");
+		TTEST_EQUAL(epd.operation("pv"), "b3");
+	}
+
+	TTEST_CASE("Reads numeric operands and quoted semicolons.")
+	{
+		Epd epd("4k3/8/8/8/8/8/8/R3K3 w - - dm 2; acd 12; ce -350; c0 \"a; b\"; c1 x; bm Ra8+;");
+		int value = 0;
+		TTEST_EQUAL(epd.intOperation("dm", value), true);
+		TTEST_EQUAL(value, 2);
+		TTEST_EQUAL(epd.intOperation("acd", value), true);
+		TTEST_EQUAL(value, 12);
+		TTEST_EQUAL(epd.intOperation("ce", value), true);
+		TTEST_EQUAL(value, -350);
+		TTEST_EQUAL(epd.intOperation("c1", value), false);
+		TTEST_EQUAL(epd.intOperation("pm", value), false);
+		TTEST_EQUAL(value, -350);
+		TTEST_EQUAL(epd.operation("c0"), "a; b");
+		TTEST_EQUAL(epd.operation("bm"), "Ra8+");
+		TTEST_EQUAL(epd.operationCount(), 6u);
+	}
 };
 
 }
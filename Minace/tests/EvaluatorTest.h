@@ -15,6 +15,29 @@ private:
 	Evaluator e{2};
 	GameState state{"Kf1 Nd2 b7", "Ke8 Qd8 Re4 Bf8 Ng8 g2 h2", Player::WHITE};
 	std::unique_ptr<MinMaxAI> ai;
+	std::vector<Move> moves[4];
+
+	/* Walks the game tree like perft and returns the number of leaf nodes where the incrementally
+	 * updated score doesn't match the score calculated from scratch. */
+	uint64_t checkedPerft(GameState& state, Evaluator& evaluator, unsigned depth)
+	{
+		if (!evaluator.isConsistent(state))
+			return 1;
+		if (depth == 0)
+			return 0;
+		uint64_t errors = 0;
+		moves[depth].clear();
+		state.getLegalMoves(moves[depth]);
+		for (Move m : moves[depth]) {
+			Sqr enPassantSqr = state.enPassantSqr();
+			state.makeMove(m);
+			evaluator.makeMove(m, enPassantSqr);
+			errors += checkedPerft(state, evaluator, depth - 1);
+			evaluator.undoMove();
+			state.undoMove(m);
+		}
+		return errors;
+	}
 
 	TTEST_BEFORE()
 	{
@@ -23,30 +46,177 @@ private:
 
 	TTEST_CASE("New state score is correct.")
 	{
-		TTEST_EQUAL(e.getScore(), -100000005 - 904 - 502 - 301 - 301 - 108 - 107
-				+ 100000004 + 305 + 108);
+		int middlegame = 3 + 305 + 108 - 904 - 502 - 301 - 301 - 108 - 107;
+		int endgame = 4 + 305 + 120 - 5 - 904 - 502 - 301 - 301 - 120 - 120;
+		TTEST_EQUAL(e.getPhase(), 4 + 2 + 1 + 1 + 1);
+		TTEST_EQUAL(e.getScore(), (middlegame * 9 + endgame * 15) / 24);
+	}
+
+	TTEST_CASE("Pawn structure evaluation.")
+	{
+		// Passed pawn on 5th rank.
+		TTEST_EQUAL(Evaluator::evaluatePawns(BitBoard("Ke1 d5", "Ke8")),
+				Scores::PASSED_PAWN_VALUES[4] - Scores::ISOLATED_PAWN_PENALTY);
+		// Black doubled and isolated pawns, a2 is passed.
+		TTEST_EQUAL(Evaluator::evaluatePawns(BitBoard("Ke1 a2 b2", "Ke8 c6 c7")),
+				Scores::DOUBLED_PAWN_PENALTY + 2 * Scores::ISOLATED_PAWN_PENALTY
+				+ Scores::PASSED_PAWN_VALUES[1]);
+		// Backward pawn on d3 and black isolated pawns.
+		TTEST_EQUAL(Evaluator::evaluatePawns(BitBoard("Ke1 c4 d3", "Ke8 c6 e5")),
+				2 * Scores::ISOLATED_PAWN_PENALTY - Scores::BACKWARD_PAWN_PENALTY);
+	}
+
+	TTEST_CASE("Incremental score matches score calculated from scratch.")
+	{
+		// Positions with castling, en passant and promotions.
+		const char* fens[] = {
+			"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",
+			"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -",
+			"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+			"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+			"4k3/8/8/2pP4/8/8/8/4K3 w - c6 0 1"
+		};
+		for (const char* fen : fens) {
+			GameState s(fen);
+			Evaluator evaluator(3);
+			evaluator.reset(s);
+			TTEST_EQUAL(checkedPerft(s, evaluator, 3), 0ull);
+			TTEST_EQUAL(s, GameState(fen));
+		}
+	}
+
+	TTEST_CASE("Material table caches phase, imbalance and scale factors.")
+	{
+		Evaluator evaluator(2);
+		evaluator.reset(GameState());
+		TTEST_EQUAL(evaluator.material().phase, (int) Scores::MAX_PHASE);
+		TTEST_EQUAL(evaluator.material().imbalance, 0);
+		TTEST_EQUAL(evaluator.material().endgame, (int) Endgames::NONE);
+
+		// Bishop pair, and a knight with 7 pawns against a rook with 6 pawns.
+		MaterialTable::Entry entry;
+		MaterialTable::calculate(GameState("Ke1 Bc1 Bf1 Nb1 a2 b2 c2 d2 e2 f2 g2",
+				"Ke8 Bc8 Ra8 a7 b7 c7 d7 e7 f7").board().materialKey(), entry);
+		TTEST_EQUAL(entry.imbalance, Scores::BISHOP_PAIR_BONUS + 2 * Scores::KNIGHT_PAWN_BONUS
+				+ Scores::ROOK_PAWN_PENALTY);
+		TTEST_EQUAL(entry.phase, 1 + 1 + 1 + 1 + 2);
+		TTEST_EQUAL(entry.scales[Player::WHITE], (int) MaterialTable::SCALE_NORMAL);
+
+		// Rook against minor piece without pawns is drawish, a lone minor piece can't win.
+		MaterialTable::calculate(GameState("Ke1 Ra1", "Ke8 Nb8").board().materialKey(), entry);
+		TTEST_EQUAL(entry.scales[Player::WHITE], 4);
+		TTEST_EQUAL(entry.scales[Player::BLACK], 0);
+		TTEST_EQUAL(entry.endgame, (int) Endgames::NONE);
+		MaterialTable::calculate(GameState("Ke1 a2", "Ke8").board().materialKey(), entry);
+		TTEST_EQUAL(entry.endgame != Endgames::NONE, true);
+
+		GameState s("Ke1 Ra1", "Ke8 Nb8");
+		evaluator.reset(s);
+		int score = evaluator.evaluateUncached(s);
+		TTEST_EQUAL(score > 0 && score < Scores::PIECE_VALUES[Piece::PAWN], true);
+	}
+
+	TTEST_CASE("En passant and castling.")
+	{
+		GameState s("r3k2r/8/8/8/3pP3/8/8/R3K2R b KQkq e3 0 1");
+		Evaluator evaluator(2);
+		evaluator.reset(s);
+		Sqr enPassantSqr = s.enPassantSqr();
+		s.makeMove("d4xe3");
+		evaluator.makeMove("d4xe3", enPassantSqr);
+		TTEST_EQUAL(evaluator.isConsistent(s), true);
+		s.makeMove("Ke1-g1");
+		evaluator.makeMove("Ke1-g1");
+		TTEST_EQUAL(evaluator.isConsistent(s), true);
+	}
+
+	TTEST_CASE("Mobility and king attacks.")
+	{
+		// Knight on b1 attacks a3, c3 and d2.
+		TTEST_EQUAL(Evaluator::evaluateActivity(BitBoard("Ke1 Nb1", "Ke8")),
+				3 * Scores::MOBILITY_VALUES[Piece::KNIGHT]);
+		// Squares attacked by enemy pawns are not counted.
+		TTEST_EQUAL(Evaluator::evaluateActivity(BitBoard("Ke1 Nb1", "Ke8 b4")),
+				Scores::MOBILITY_VALUES[Piece::KNIGHT]);
+		TTEST_EQUAL(Evaluator::evaluateActivity(BitBoard("Ke1 b5", "Ke8 Nb8")),
+				-Scores::MOBILITY_VALUES[Piece::KNIGHT]);
+		// Two knights attack one square next to the king each.
+		TTEST_EQUAL(Evaluator::evaluateActivity(BitBoard("Ka1 Nf5 Ng5", "Kh8")),
+				14 * Scores::MOBILITY_VALUES[Piece::KNIGHT] + Scores::KING_ATTACK_VALUES[
+				2 * Scores::KING_ATTACK_WEIGHTS[Piece::KNIGHT]]);
+		TTEST_EQUAL(Evaluator::evaluateActivity(GameState().board()), 0);
+	}
+
+	TTEST_CASE("Lazy evaluation outside the window.")
+	{
+		int score = e.evaluateUncached(state);
+		TTEST_EQUAL(e.evaluate(state, score + 1000, score + 1001) < score + 1000, true);
+		TTEST_EQUAL(e.lazyEvaluations(), 1ull);
+		TTEST_EQUAL(e.evaluate(state, score - 1, score + 1), score);
+		TTEST_EQUAL(e.lazyEvaluations(), 1ull);
+		TTEST_EQUAL(e.evaluations(), 2ull);
+	}
+
+	TTEST_CASE("Evaluation is cached for transposed positions.")
+	{
+		GameState s;
+		Evaluator evaluator(4);
+		evaluator.reset(s);
+		const char* moves[2][4] = {
+			{"Ng1-f3", "Ng8-f6", "Nb1-c3", "Nb8-c6"},
+			{"Nb1-c3", "Nb8-c6", "Ng1-f3", "Ng8-f6"}
+		};
+		int scores[2];
+		for (unsigned i = 0; i < 2; ++i) {
+			for (const char* move : moves[i]) {
+				s.makeMove(move);
+				evaluator.makeMove(move);
+			}
+			scores[i] = evaluator.evaluate(s);
+			for (int j = 3; j >= 0; --j) {
+				s.undoMove(moves[i][j]);
+				evaluator.undoMove();
+			}
+		}
+		TTEST_EQUAL(evaluator.evalCache().lookups(), 2ull);
+		TTEST_EQUAL(evaluator.evalCache().hits(), 1ull);
+		TTEST_EQUAL(scores[1], scores[0]);
+	}
+
+	/* Checks the score, phase and relative score against an evaluator reset to the state, whose
+	 * ply is given. The relative score is compared to the score of the root state. */
+	void checkScores(Evaluator& evaluator, const GameState& state, unsigned ply, int rootScore)
+	{
+		Evaluator fresh(0);
+		fresh.reset(state);
+		int sign = ply & 1 ? -1 : 1;
+		TTEST_EQUAL(evaluator.getScore(), fresh.getScore());
+		TTEST_EQUAL(evaluator.getPhase(), fresh.getPhase());
+		TTEST_EQUAL(evaluator.getRelativeScore(), Scores::taperedScore(
+				Evaluator::calculate(state) - sign * rootScore, fresh.getPhase()));
 	}
 
 	TTEST_CASE("Multiple moves.")
 	{
-		int s = e.getScore();
+		int s0 = e.getScore();
+		int root = Evaluator::calculate(state);
 
-		e.makeMove("Bc6xa4");
-		int d1 = 1 - 4 + 105;
-		TTEST_EQUAL(e.getScore(), -(s + d1));
-		TTEST_EQUAL(e.getRelativeScore(), -d1);
+		state.makeMove("Nd2xRe4");
+		e.makeMove("Nd2xRe4");
+		checkScores(e, state, 1, root);
 
-		e.makeMove("b2xQc1B");
-		int d2 = 301 - 108 + 903;
-		TTEST_EQUAL(e.getScore(), s + d1 - d2);
-		TTEST_EQUAL(e.getRelativeScore(), d1 - d2);
+		state.makeMove("g2-g1Q");
+		e.makeMove("g2-g1Q");
+		checkScores(e, state, 2, root);
 
+		state.undoMove("g2-g1Q");
 		e.undoMove();
-		TTEST_EQUAL(e.getScore(), -(s + d1));
-		TTEST_EQUAL(e.getRelativeScore(), -d1);
+		checkScores(e, state, 1, root);
 
+		state.undoMove("Nd2xRe4");
 		e.undoMove();
-		TTEST_EQUAL(e.getScore(), s);
+		checkScores(e, state, 0, root);
+		TTEST_EQUAL(e.getScore(), s0);
 		TTEST_EQUAL(e.getRelativeScore(), 0);
 	}
 };
@@ -2,6 +2,8 @@
 
 #include "../src/MinMaxAI.h"
 #include "../src/GameState.h"
+#include "../src/MoveList.h"
+#include "../src/PackedMove.h"
 #include "../ttest/ttest.h"
 #include <memory>
 #include <cstdint>
@@ -138,6 +140,107 @@ private:
 		TTEST_EQUAL(s.enPassantSqr(), Sqr::NONE);
 	}
 
+	TTEST_CASE("Pawn zobrist code depends only on pawns.")
+	{
+		GameState s("b2 Kh1 Qd1", "c4 Ka8", Player::WHITE);
+		uint64_t pawnId = s.pawnId();
+		s.makeMove("Qd1-d3");
+		TTEST_EQUAL(s.pawnId(), pawnId);
+		s.makeMove("Ka8-b8");
+		s.makeMove("b2-b4");
+		s.makeMove("c4xb3");
+		TTEST_EQUAL(s.pawnId(), GameState("Kh1 Qd3", "b3 Kb8", Player::WHITE).pawnId());
+		s.makeMove("Qd3xb3");
+		TTEST_EQUAL(s.pawnId(), GameState("Kh1", "Kb8").pawnId());
+	}
+
+	TTEST_CASE("Material key is updated by captures and promotions.")
+	{
+		GameState s("r3k2r/1P6/8/8/3pP3/8/8/R3K2R b KQkq e3 0 1");
+		uint64_t materialId = s.materialId();
+		TTEST_EQUAL(materialId, s.board().materialKey());
+		const char* moves[] = {"d4xe3", "b7xRa8Q", "Ke8-f7", "Ke1-g1"};
+		for (const char* move : moves) {
+			s.makeMove(move);
+			TTEST_EQUAL(s.materialId(), s.board().materialKey());
+		}
+		TTEST_EQUAL(BitBoard::pieceCount(s.materialId(), Player::WHITE, Piece::QUEEN), 1u);
+		TTEST_EQUAL(BitBoard::pieceCount(s.materialId(), Player::WHITE, Piece::PAWN), 0u);
+		TTEST_EQUAL(BitBoard::pieceCount(s.materialId(), Player::BLACK, Piece::ROOK), 1u);
+		for (int i = 3; i >= 0; --i)
+			s.undoMove(moves[i]);
+		TTEST_EQUAL(s.materialId(), materialId);
+	}
+
+	TTEST_CASE("Packed moves are restored with piece types from the board.")
+	{
+		GameState s("r3k2r/1P6/8/8/3pP3/8/8/R3K2R b KQkq e3 0 1");
+		MoveList moves;
+		moves.populate(s, false);
+		unsigned count = 0;
+		for (unsigned pri = 0; pri < MoveList::PRIORITIES; ++pri) {
+			for (unsigned i = 0; i < moves.getCount(pri); ++i, ++count) {
+				Move move = moves.getMove(pri, i);
+				TTEST_EQUAL(s.unpackMove(PackedMove(move)).toStr(), move.toStr());
+			}
+		}
+		TTEST_EQUAL(count > 20, true);
+		TTEST_EQUAL(s.unpackMove(PackedMove(Move("d4xe3"))).toStr(), "d4xe3");
+		TTEST_EQUAL(s.unpackMove(PackedMove(Move("Ke8-c8"))).toStr(), "Ke8-c8");
+		s.makeMove("Ke8-f8");
+		TTEST_EQUAL(s.unpackMove(PackedMove(Move("b7xRa8N"))).toStr(), "b7xRa8N");
+		TTEST_EQUAL(s.unpackMove(PackedMove(Move("b7-b8Q"))).toStr(), "b7-b8Q");
+		TTEST_EQUAL(!s.unpackMove(PackedMove()), true);
+		TTEST_EQUAL(s.getPieceType(Sqr("f8")), Piece::KING);
+		TTEST_EQUAL(s.getPieceType(Sqr("e8")), Piece::NONE);
+	}
+
+	TTEST_CASE("Repeated states are detected within reversible moves.")
+	{
+		GameState s;
+		const char* moves[] = {"Ng1-f3", "Ng8-f6", "Nf3-g1", "Nf6-g8"};
+		for (const char* move : moves) {
+			TTEST_EQUAL(s.isRepeatedState(), false);
+			s.makeMove(move);
+		}
+		TTEST_EQUAL(s.isRepeatedState(), true);
+		s.makeMove("e2-e4");
+		s.makeMove("Ng8-f6");
+		s.makeMove("Ng1-f3");
+		s.makeMove("Nf6-g8");
+		TTEST_EQUAL(s.isRepeatedState(), false);
+	}
+
+	TTEST_CASE("Cuckoo table finds moves that repeat a position.")
+	{
+		unsigned count = 0;
+		for (unsigned i = 0; i < Zobrist::CUCKOO_SIZE; ++i)
+			count += !!Zobrist::CUCKOO_MOVES[i];
+		TTEST_EQUAL(count, 3668u);
+
+		GameState s;
+		s.makeMove("Ng1-f3");
+		s.makeMove("Ng8-f6");
+		TTEST_EQUAL(s.hasUpcomingRepetition(), false);
+		s.makeMove("Nf3-g1");
+		TTEST_EQUAL(s.hasUpcomingRepetition(), true);
+		s.makeNullMove();
+		TTEST_EQUAL(s.hasUpcomingRepetition(), false);
+
+		// The rook can't return directly to a1 when b1 is occupied.
+		const char* moves[] = {
+			"Ke8-f8", "Ra1-a2", "Kf8-g8", "Ra2-c2", "Kg8-f8", "Rc2-c1", "Kf8-e8"
+		};
+		s = GameState("Ke1 Ra1", "Ke8 Nh8", Player::BLACK);
+		for (const char* move : moves)
+			s.makeMove(move);
+		TTEST_EQUAL(s.hasUpcomingRepetition(), true);
+		s = GameState("Ke1 Ra1", "Ke8 Nb1", Player::BLACK);
+		for (const char* move : moves)
+			s.makeMove(move);
+		TTEST_EQUAL(s.hasUpcomingRepetition(), false);
+	}
+
 	TTEST_CASE("MakeMove() updates rook position when castling.")
 	{
 		GameState s("Ra1 Ke1 Rh1", "Ra8 Ke8 Rh8", Player::WHITE);
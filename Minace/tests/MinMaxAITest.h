@@ -12,6 +12,23 @@ class MinMaxAITest : public ttest::TestBase
 {
 private:
 
+	/* Stores the latest PV of each line. */
+	class PvCollector : public InfoCallback
+	{
+	public:
+		std::vector<std::vector<Move>> pvs;
+		std::vector<int> scores;
+
+		virtual void notifyPv(unsigned multiPv, unsigned depth, unsigned selDepth, int score,
+				uint64_t nodes, double time, const std::vector<Move>& pv) override
+		{
+			pvs.resize(std::max<size_t>(pvs.size(), multiPv));
+			scores.resize(pvs.size());
+			pvs[multiPv - 1] = pv;
+			scores[multiPv - 1] = score;
+		}
+	};
+
 	std::unique_ptr<MinMaxAI> ai;
 	TimeConstraint tc;
 
@@ -45,6 +62,15 @@ private:
 		TTEST_EQUAL(ai->getMove(s, tc).toStr(), "Rb4-b8");
 	}
 
+	TTEST_CASE("Mate search finds the shortest mate.")
+	{
+		GameState s(Epd("r5rk/5p1p/5R2/4B3/8/8/7P/7K w - - 0 1"));
+		TimeConstraint mateTc;
+		mateTc.mate = 5;
+		TTEST_EQUAL(ai->getMove(s, mateTc).toStr(), "Rf6-a6");
+		TTEST_EQUAL(ai->getScore(), Scores::getCheckMateScore(3));
+	}
+
 	TTEST_CASE("Can fork.")
 	{
 		GameState s("Ka1 Qc1", "Kf8 Rb8", Player::WHITE);
@@ -88,6 +114,89 @@ private:
 		TTEST_EQUAL(ai->getMove(s, tc).toStr(), "e4xd3");
 	}
 
+	TTEST_CASE("MultiPV searches distinct root moves in score order.")
+	{
+		PvCollector pvc;
+		MinMaxAI mpvAi(&pvc);
+		mpvAi.setMultiPv(3);
+		GameState s("Ka1 Qc1", "Kf8 Rb8", Player::WHITE);
+		Move move = mpvAi.getMove(s, 4);
+		TTEST_EQUAL(pvc.pvs.size(), 3u);
+		TTEST_EQUAL(pvc.pvs[0][0].toStr(), move.toStr());
+		TTEST_EQUAL(pvc.pvs[0][0] != pvc.pvs[1][0], true);
+		TTEST_EQUAL(pvc.pvs[0][0] != pvc.pvs[2][0], true);
+		TTEST_EQUAL(pvc.pvs[1][0] != pvc.pvs[2][0], true);
+		TTEST_EQUAL(pvc.scores[0] >= pvc.scores[1] && pvc.scores[1] >= pvc.scores[2], true);
+	}
+
+	TTEST_CASE("MultiPV is limited by the number of legal moves.")
+	{
+		PvCollector pvc;
+		MinMaxAI mpvAi(&pvc);
+		mpvAi.setMultiPv(5);
+		GameState s("Ka8", "Kb6 Bc6", Player::WHITE);
+		TTEST_EQUAL(mpvAi.getMove(s, 3).toStr(), "Ka8-b8");
+		TTEST_EQUAL(pvc.pvs.size(), 1u);
+	}
+
+	TTEST_CASE("Principal variation consists of legal moves.")
+	{
+		PvCollector pvc;
+		MinMaxAI pvAi(&pvc);
+		GameState s("r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10");
+		Move move = pvAi.getMove(s, 5);
+		TTEST_EQUAL(pvc.pvs[0][0].toStr(), move.toStr());
+		TTEST_EQUAL(pvc.pvs[0].size() >= 5, true);
+		for (Move m : pvc.pvs[0]) {
+			TTEST_EQUAL(s.isLegalMove(m), true);
+			s.makeMove(m);
+		}
+	}
+
+	TTEST_CASE("Search can be restricted to given root moves.")
+	{
+		GameState s("Ka1 Qc1", "Kf8 Rb8", Player::WHITE);
+		std::vector<Move> searchMoves{"Qc1-b2", "Qc1-c2"};
+		TTEST_EQUAL(ai->getMove(s, tc, searchMoves).toStr(), "Qc1-c2");
+	}
+
+	TTEST_CASE("Search is limited by node count.")
+	{
+		class NodeCollector : public InfoCallback
+		{
+		public:
+			uint64_t nodes = 0;
+
+			virtual void notifyIterDone(unsigned depth, int score, uint64_t nodes,
+					size_t hashEntries, size_t hashCapacity) override
+			{
+				this->nodes = nodes;
+			}
+		} nc;
+		MinMaxAI nodeAi(&nc);
+		GameState s("r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10");
+		Move move = nodeAi.getMove(s, TimeConstraint(0u, 0.0, 20000));
+		TTEST_EQUAL(s.isLegalMove(move), true);
+		// Limit is checked every 4096 nodes.
+		TTEST_EQUAL(nc.nodes > 0 && nc.nodes < 20000 + 4096, true);
+	}
+
+	TTEST_CASE("Game repetitions are found after earlier searches.")
+	{
+		// A stopped search leaves its path in the repetition table.
+		GameState s("r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10");
+		ai->getMove(s, TimeConstraint(0u, 0.0, 5000));
+
+		// Black has only Ka7, which repeats the position after the first Ka7.
+		GameState game("Kc6 Qh4 Bh2", "Ka8", Player::BLACK);
+		for (const char* move : {"Ka8-a7", "Qh4-h3", "Ka7-a8", "Qh3-h4"}) {
+			ai->getMove(game, tc);
+			game.makeMove(Move(move));
+		}
+		TTEST_EQUAL(ai->getMove(game, tc).toStr(), "Ka8-a7");
+		TTEST_EQUAL(ai->getScore(), (int) Scores::DRAW);
+	}
+
 	TTEST_CASE("Bugfix test #1.")
 	{
 		GameState s("Ka7 Qg8 Qc5", "Kd7 Qd3", Player::BLACK);
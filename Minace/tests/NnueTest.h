@@ -0,0 +1,118 @@
+#pragma once
+
+#include "../src/Nnue.h"
+#include "../src/Evaluator.h"
+#include "../src/GameState.h"
+#include "../ttest/ttest.h"
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+namespace mnc {
+
+class NnueTest : public ttest::TestBase
+{
+private:
+
+	std::shared_ptr<NnueWeights> weights = NnueWeights::random(1);
+	std::vector<Move> moves[4];
+
+	/* Walks the game tree like perft and returns the number of nodes where the incrementally
+	 * updated NNUE score doesn't match the score of a fresh evaluator. */
+	uint64_t checkedPerft(GameState& state, Evaluator& evaluator, unsigned depth)
+	{
+		Nnue fresh(weights, 0);
+		fresh.reset(state.board());
+		uint64_t errors = evaluator.nnue()->evaluate(state.board(), state.activePlayer())
+				!= fresh.evaluate(state.board(), state.activePlayer())
+				|| !evaluator.isConsistent(state);
+		if (depth == 0)
+			return errors;
+		moves[depth].clear();
+		state.getLegalMoves(moves[depth]);
+		for (Move m : moves[depth]) {
+			Sqr enPassantSqr = state.enPassantSqr();
+			state.makeMove(m);
+			evaluator.makeMove(m, enPassantSqr);
+			errors += checkedPerft(state, evaluator, depth - 1);
+			evaluator.undoMove();
+			state.undoMove(m);
+		}
+		return errors;
+	}
+
+	TTEST_CASE("Incremental accumulators match accumulators calculated from scratch.")
+	{
+		// Positions with castling, en passant and promotions.
+		const char* fens[] = {
+			"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",
+			"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+			"4k3/8/8/2pP4/8/8/8/4K3 w - c6 0 1"
+		};
+		for (const char* fen : fens) {
+			GameState s(fen);
+			Evaluator evaluator(3);
+			evaluator.setNnue(weights);
+			evaluator.reset(s);
+			TTEST_EQUAL(checkedPerft(s, evaluator, 2), 0ull);
+		}
+	}
+
+	TTEST_CASE("SIMD and scalar evaluation give the same score.")
+	{
+		Nnue simd(weights, 1), scalar(weights, 1);
+		scalar.setSimd(false);
+		for (uint64_t seed = 0; seed < 50; ++seed) {
+			GameState s = GameGenerator::createGame(seed);
+			std::vector<Move> legalMoves;
+			s.getLegalMoves(legalMoves);
+			simd.reset(s.board());
+			scalar.reset(s.board());
+			TTEST_EQUAL(simd.evaluate(s.board(), s.activePlayer()),
+					scalar.evaluate(s.board(), s.activePlayer()));
+			for (Move m : legalMoves) {
+				Sqr enPassantSqr = s.enPassantSqr();
+				simd.makeMove(s.activePlayer(), m, enPassantSqr);
+				scalar.makeMove(s.activePlayer(), m, enPassantSqr);
+				s.makeMove(m);
+				TTEST_EQUAL(simd.evaluate(s.board(), s.activePlayer()),
+						scalar.evaluate(s.board(), s.activePlayer()));
+				s.undoMove(m);
+				simd.undoMove();
+				scalar.undoMove();
+			}
+		}
+	}
+
+	TTEST_CASE("Score is symmetric for mirrored positions.")
+	{
+		GameState s1("Kf1 Nd2 b7", "Ke8 Qd8 Re4 Bf8 Ng8 g2 h2", Player::WHITE);
+		GameState s2("Ke1 Qd1 Re5 Bf1 Ng1 g7 h7", "Kf8 Nd7 b2", Player::BLACK);
+		Nnue nnue(weights, 0);
+		nnue.reset(s1.board());
+		int score = nnue.evaluate(s1.board(), s1.activePlayer());
+		nnue.reset(s2.board());
+		TTEST_EQUAL(nnue.evaluate(s2.board(), s2.activePlayer()), score);
+	}
+
+	TTEST_CASE("Weights can be saved and loaded.")
+	{
+		std::stringstream ss;
+		weights->save(ss);
+		std::shared_ptr<const NnueWeights> loaded = NnueWeights::load(ss);
+		TTEST_EQUAL(loaded->featureWeights == weights->featureWeights, true);
+		TTEST_EQUAL(loaded->hiddenWeights == weights->hiddenWeights, true);
+		TTEST_EQUAL(loaded->outputBias, weights->outputBias);
+
+		std::stringstream truncated(ss.str().substr(0, 1000));
+		bool thrown = false;
+		try {
+			NnueWeights::load(truncated);
+		} catch (const std::runtime_error&) {
+			thrown = true;
+		}
+		TTEST_EQUAL(thrown, true);
+	}
+};
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "../src/PackedPosition.h"
+#include "../src/GameState.h"
+#include "../ttest/ttest.h"
+#include <cstring>
+
+namespace mnc {
+
+class PackedPositionTest : public ttest::TestBase
+{
+private:
+
+	TTEST_CASE("Unpacked position equals the packed one.")
+	{
+		const char* fens[] = {
+			"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+			"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R b Kq - 3 1",
+			"4k3/8/8/2pP4/8/8/8/4K3 w - c6 0 1",
+			"8/5k2/3p4/1p1P4/1P6/4K3/8/8 b - - 17 1"
+		};
+		for (const char* fen : fens) {
+			GameState s(fen);
+			PackedPosition p = PackedPosition::pack(s, -123, 2);
+			GameState u = p.unpack();
+			TTEST_EQUAL(u == s, true);
+			TTEST_EQUAL(u.halfMoveClock(), s.halfMoveClock());
+			TTEST_EQUAL(u.id(), s.id());
+			TTEST_EQUAL(p.score, -123);
+			TTEST_EQUAL(p.result, 2);
+			PackedPosition repacked = PackedPosition::pack(u, -123, 2);
+			TTEST_EQUAL(std::memcmp(&repacked, &p, sizeof p), 0);
+		}
+	}
+
+	TTEST_CASE("Position after moves is packed the same way after unpacking.")
+	{
+		GameState s;
+		s.makeMove("e2-e4");
+		s.makeMove("c7-c5");
+		PackedPosition p = PackedPosition::pack(s, 35, 1);
+		PackedPosition repacked = PackedPosition::pack(p.unpack(), 35, 1);
+		TTEST_EQUAL(std::memcmp(&repacked, &p, sizeof p), 0);
+	}
+
+	TTEST_CASE("Score is clamped to 16 bits.")
+	{
+		GameState s;
+		TTEST_EQUAL(PackedPosition::pack(s, 100000, 1).score, 32767);
+		TTEST_EQUAL(PackedPosition::pack(s, -100000, 1).score, -32767);
+	}
+};
+
+}
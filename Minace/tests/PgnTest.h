@@ -0,0 +1,182 @@
+#pragma once
+
+#include "../src/Pgn.h"
+#include "../src/BookBuilder.h"
+#include "../src/PolyglotBook.h"
+#include "../src/GameState.h"
+#include "../src/NullLogger.h"
+#include "../ttest/ttest.h"
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+
+namespace mnc {
+
+class PgnTest : public ttest::TestBase
+{
+private:
+
+	static bool isValidSan(GameState& state, const std::string& san)
+	{
+		try {
+			PgnReader::parseSan(state, san);
+			return true;
+		} catch (const std::invalid_argument&) {
+			return false;
+		}
+	}
+
+	TTEST_CASE("SAN moves are parsed.")
+	{
+		GameState s("r3k2r/1P6/8/3pP3/8/2N3N1/8/R3K2R w KQkq d6 0 1");
+		TTEST_EQUAL(PgnReader::parseSan(s, "Nce4").toStr(), "Nc3-e4");
+		TTEST_EQUAL(PgnReader::parseSan(s, "Nge4+").toStr(), "Ng3-e4");
+		TTEST_EQUAL(PgnReader::parseSan(s, "exd6").toStr(), "e5xd6");
+		TTEST_EQUAL(PgnReader::parseSan(s, "bxa8=N").toStr(), "b7xRa8N");
+		TTEST_EQUAL(PgnReader::parseSan(s, "b8Q").toStr(), "b7-b8Q");
+		TTEST_EQUAL(PgnReader::parseSan(s, "O-O").toStr(), "Ke1-g1");
+		TTEST_EQUAL(PgnReader::parseSan(s, "0-0-0").toStr(), "Ke1-c1");
+		TTEST_EQUAL(isValidSan(s, "Ne4"), false);
+		TTEST_EQUAL(isValidSan(s, "Nd4"), false);
+		TTEST_EQUAL(isValidSan(s, "Kf9"), false);
+	}
+
+	TTEST_CASE("Moves are written in SAN.")
+	{
+		GameState s("r3k2r/1P6/8/3pP3/8/2N3N1/8/R3K2R w KQkq d6 0 1");
+		TTEST_EQUAL(PgnWriter::toSan(s, PgnReader::parseSan(s, "Nce4")), "Nce4");
+		TTEST_EQUAL(PgnWriter::toSan(s, PgnReader::parseSan(s, "Nge4")), "Nge4");
+		TTEST_EQUAL(PgnWriter::toSan(s, PgnReader::parseSan(s, "exd6")), "exd6");
+		TTEST_EQUAL(PgnWriter::toSan(s, PgnReader::parseSan(s, "bxa8Q")), "bxa8=Q+");
+		TTEST_EQUAL(PgnWriter::toSan(s, PgnReader::parseSan(s, "O-O-O")), "O-O-O");
+
+		GameState m("6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1");
+		TTEST_EQUAL(PgnWriter::toSan(m, PgnReader::parseSan(m, "Ra8")), "Ra8#");
+	}
+
+	TTEST_CASE("Games are read with comments, variations and annotations.")
+	{
+		std::stringstream ss(
+				"[Event \"Test\"]\n"
+				"[Result \"1-0\"]\n"
+				"\n"
+				"1. e4 {best by test} e5 2. Nf3 (2. f4 exf4 (2... d5)) Nc6 $1 3. Bb5 ; Ruy Lopez\n"
+				"3... a6 1-0\n"
+				"\n"
+				"[Event \"Second\"]\n"
+				"[SetUp \"1\"]\n"
+				"[FEN \"4k3/8/8/8/8/8/4P3/4K3 b - - 0 1\"]\n"
+				"\n"
+				"1... Kd7 2. e4 *\n");
+		PgnReader reader(ss);
+		PgnGame game;
+		TTEST_EQUAL(reader.next(game), true);
+		TTEST_EQUAL(game.tag("Event"), "Test");
+		TTEST_EQUAL(game.result, "1-0");
+		TTEST_EQUAL(game.moves.size(), 6u);
+		TTEST_EQUAL(game.moves[5].toStr(), "a7-a6");
+
+		TTEST_EQUAL(reader.next(game), true);
+		TTEST_EQUAL(game.tag("Event"), "Second");
+		TTEST_EQUAL(game.startState.activePlayer(), Player::BLACK);
+		TTEST_EQUAL(game.moves.size(), 2u);
+		TTEST_EQUAL(game.result, "*");
+		TTEST_EQUAL(reader.next(game), false);
+	}
+
+	TTEST_CASE("Castling written with zeros is read.")
+	{
+		std::stringstream ss(
+				"1. e4 e5 2. Nf3 Nc6 3. Bc4 Bc5 4. 0-0 Nf6 5. d3 d6 6. Be3 Be6 7. Nc3 Qd7 "
+				"8. a3 0-0-0 9.Qe2 *\n");
+		PgnReader reader(ss);
+		PgnGame game;
+		TTEST_EQUAL(reader.next(game), true);
+		TTEST_EQUAL(game.moves.size(), 17u);
+		TTEST_EQUAL(game.moves[6].toStr(), "Ke1-g1");
+		TTEST_EQUAL(game.moves[15].toStr(), "Ke8-c8");
+		TTEST_EQUAL(game.moves[16].toStr(), "Qd1-e2");
+	}
+
+	TTEST_CASE("Invalid game is reported and the next game is read.")
+	{
+		std::stringstream ss(
+				"[Event \"Bad\"]\n\n1. e4 e5 2. Ke3 Nc6 0-1\n\n"
+				"[Event \"Good\"]\n\n1. d4 1/2-1/2\n");
+		PgnReader reader(ss);
+		PgnGame game;
+		bool thrown = false;
+		try {
+			reader.next(game);
+		} catch (const std::invalid_argument&) {
+			thrown = true;
+		}
+		TTEST_EQUAL(thrown, true);
+		TTEST_EQUAL(reader.next(game), true);
+		TTEST_EQUAL(game.tag("Event"), "Good");
+		TTEST_EQUAL(game.moves.size(), 1u);
+	}
+
+	TTEST_CASE("Written games are read back.")
+	{
+		PgnGame game;
+		game.tags = {{"Event", "Round trip"}, {"SetUp", "1"},
+			{"FEN", "r3k2r/1P6/8/3pP3/8/2N3N1/8/R3K2R b KQkq - 0 20"}};
+		game.startState = GameState(game.tags[2].second);
+		game.result = "0-1";
+		GameState s = game.startState;
+		for (const char* san : {"O-O", "Nce4", "Kg7", "bxa8=Q", "Rxa8", "Ng5", "Rxa1+"}) {
+			game.moves.push_back(PgnReader::parseSan(s, san));
+			s.makeMove(game.moves.back());
+		}
+
+		std::stringstream ss;
+		PgnWriter::write(ss, game);
+		TTEST_EQUAL(ss.str().find("20... O-O 21. Nce4 Kg7 22. bxa8=Q Rxa8") != std::string::npos,
+				true);
+		PgnReader reader(ss);
+		PgnGame read;
+		TTEST_EQUAL(reader.next(read), true);
+		TTEST_EQUAL(read.tags.size(), 3u);
+		TTEST_EQUAL(read.result, "0-1");
+		TTEST_EQUAL(read.moves.size(), game.moves.size());
+		for (size_t i = 0; i < game.moves.size(); ++i)
+			TTEST_EQUAL(read.moves[i].toStr(), game.moves[i].toStr());
+	}
+
+	TTEST_CASE("Opening book is built from games.")
+	{
+		const char* pgnFile = "PgnTest.pgn";
+		const char* bookFile = "PgnTest.bin";
+		{
+			std::ofstream ofs(pgnFile);
+			ofs << "1. e4 e5 2. Nf3 1-0\n\n1. e4 c5 1/2-1/2\n\n1. d4 d5 0-1\n\n1. e4 e5 *\n";
+		}
+		NullLogger logger;
+		{
+			std::ofstream ofs(bookFile, std::ios::binary);
+			BookBuilder(logger, 2, 1, 2).build({pgnFile}, ofs);
+		}
+
+		PolyglotBook book(bookFile);
+		GameState s;
+		std::vector<PolyglotBook::Entry> entries = book.find(PolyglotBook::key(s));
+		// e4 won once and drew once, d4 lost.
+		TTEST_EQUAL(entries.size(), 1u);
+		TTEST_EQUAL(PolyglotBook::decodeMove(s, entries[0].move).toStr(), "e2-e4");
+		TTEST_EQUAL(entries[0].weight, 3u);
+
+		s.makeMove(PgnReader::parseSan(s, "d4"));
+		entries = book.find(PolyglotBook::key(s));
+		TTEST_EQUAL(entries.size(), 1u);
+		TTEST_EQUAL(PolyglotBook::decodeMove(s, entries[0].move).toStr(), "d7-d5");
+		TTEST_EQUAL(entries[0].weight, 2u);
+
+		// e4 (3), c5 (1) and d5 (2); moves after maxPly and moves without wins or draws are dropped.
+		TTEST_EQUAL(book.size(), 3u);
+		std::remove(pgnFile);
+		std::remove(bookFile);
+	}
+};
+
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "../src/PolyglotBook.h"
+#include "../src/GameState.h"
+#include "../ttest/ttest.h"
+#include <fstream>
+#include <random>
+#include <cstdio>
+
+namespace mnc {
+
+class PolyglotBookTest : public ttest::TestBase
+{
+private:
+
+	const char* filename = "PolyglotBookTest.bin";
+
+	static uint16_t bookMove(unsigned fromFile, unsigned fromRank, unsigned toFile, unsigned toRank)
+	{
+		return (fromRank * 8 + fromFile) << 6 | (toRank * 8 + toFile);
+	}
+
+	/* Writes a book with given entries (must be sorted by key). */
+	void writeBook(const std::vector<PolyglotBook::Entry>& entries)
+	{
+		std::ofstream ofs(filename, std::ios::binary);
+		for (const PolyglotBook::Entry& e : entries) {
+			uint64_t values[4] = {e.key, e.move, e.weight, e.learn};
+			unsigned sizes[4] = {8, 2, 2, 4};
+			for (unsigned i = 0; i < 4; ++i) {
+				for (unsigned j = sizes[i]; j-- > 0;)
+					ofs.put((char) (values[i] >> 8 * j));
+			}
+		}
+	}
+
+	TTEST_CASE("Keys match the Polyglot specification.")
+	{
+		// Test positions from the Polyglot book format description.
+		std::pair<const char*, uint64_t> positions[] = {
+			{"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 0x463b96181691fc9cull},
+			{"rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1", 0x823c9b50fd114196ull},
+			{"rnbqkbnr/ppp1pppp/8/3p4/4P3/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 2", 0x0756b94461c50fb0ull},
+			{"rnbqkbnr/ppp1pppp/8/3pP3/8/8/PPPP1PPP/RNBQKBNR b KQkq - 0 2", 0x662fafb965db29d4ull},
+			{"rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3", 0x22a48b5a8e47ff78ull},
+			{"rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR b kq - 0 3", 0x652a607ca3f242c1ull},
+			{"rnbq1bnr/ppp1pkpp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR w - - 0 4", 0x00fdd303c946bdd9ull},
+			{"rnbqkbnr/p1pppppp/8/8/PpP4P/8/1P1PPPP1/RNBQKBNR b KQkq c3 0 3", 0x3c8123ea7b067637ull},
+			{"rnbqkbnr/p1pppppp/8/8/P6P/R1p5/1P1PPPP1/1NBQKBNR b Kkq - 0 4", 0x5c3f9b829b279560ull}
+		};
+		for (auto& p : positions)
+			TTEST_EQUAL(PolyglotBook::key(GameState(p.first)), p.second);
+	}
+
+	TTEST_CASE("Book moves are decoded to legal moves.")
+	{
+		GameState s("r3k2r/8/8/8/8/8/4P3/R3K2R w KQkq - 0 1");
+		TTEST_EQUAL(PolyglotBook::decodeMove(s, bookMove(4, 1, 4, 3)).toStr(), "e2-e4");
+		TTEST_EQUAL(PolyglotBook::decodeMove(s, bookMove(4, 0, 7, 0)).toStr(), "Ke1-g1");
+		TTEST_EQUAL(PolyglotBook::decodeMove(s, bookMove(4, 0, 0, 0)).toStr(), "Ke1-c1");
+		TTEST_EQUAL((bool) PolyglotBook::decodeMove(s, bookMove(4, 1, 4, 4)), false);
+
+		GameState p("4k3/1P6/8/8/8/8/8/4K3 w - - 0 1");
+		TTEST_EQUAL(PolyglotBook::decodeMove(p, bookMove(1, 6, 1, 7) | 1 << 12).toStr(), "b7-b8N");
+		TTEST_EQUAL(PolyglotBook::decodeMove(p, bookMove(1, 6, 1, 7) | 4 << 12).toStr(), "b7-b8Q");
+	}
+
+	TTEST_CASE("Probing picks moves by weight.")
+	{
+		GameState s;
+		uint64_t key = PolyglotBook::key(s);
+		writeBook({
+			{key - 1, bookMove(3, 1, 3, 3), 100, 0},
+			{key, bookMove(4, 1, 4, 3), 3, 0},
+			{key, bookMove(3, 1, 3, 3), 1, 0},
+			{key, bookMove(6, 0, 5, 2), 0, 0},
+			{key + 1, bookMove(2, 1, 2, 3), 100, 0}
+		});
+		PolyglotBook book(filename);
+		TTEST_EQUAL(book.size(), 5u);
+		TTEST_EQUAL(book.find(key).size(), 3u);
+		TTEST_EQUAL(book.find(key + 2).size(), 0u);
+
+		std::mt19937_64 rng(1);
+		unsigned e4 = 0, d4 = 0;
+		for (unsigned i = 0; i < 1000; ++i) {
+			std::string move = book.probe(s, rng).toStr();
+			e4 += move == "e2-e4";
+			d4 += move == "d2-d4";
+		}
+		TTEST_EQUAL(e4 + d4, 1000u);
+		TTEST_EQUAL(e4 > 650 && e4 < 850, true);
+
+		GameState notInBook("4k3/8/8/8/8/8/8/4K3 w - - 0 1");
+		TTEST_EQUAL((bool) book.probe(notInBook, rng), false);
+		std::remove(filename);
+	}
+};
+
+}
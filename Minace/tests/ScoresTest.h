@@ -25,9 +25,29 @@ private:
 	TTEST_CASE("Positional value is increased by piece value.")
 	{
 		TTEST_EQUAL(Scores::POSITIONAL_PIECE_VALUES[Player::BLACK][Piece::KING][0 * 8 + 4],
+				100000000);
+		TTEST_EQUAL(Scores::ENDGAME_POSITIONAL_PIECE_VALUES[Player::BLACK][Piece::KING][0 * 8 + 4],
 				100000005);
 	}
 
+	TTEST_CASE("Packed scores can be added and unpacked.")
+	{
+		int score = Scores::makeScore(-350, 1200) + Scores::makeScore(100, -1500);
+		TTEST_EQUAL(Scores::middlegameScore(score), -250);
+		TTEST_EQUAL(Scores::endgameScore(score), -300);
+		TTEST_EQUAL(Scores::middlegameScore(-score), 250);
+		TTEST_EQUAL(Scores::endgameScore(-score), 300);
+		TTEST_EQUAL(Scores::taperedScore(score, Scores::MAX_PHASE), -250);
+		TTEST_EQUAL(Scores::taperedScore(score, 0), -300);
+	}
+
+	TTEST_CASE("Packed king values don't include the king value.")
+	{
+		int score = Scores::PACKED_POSITIONAL_PIECE_VALUES[Player::WHITE][Piece::KING][7 * 8 + 4];
+		TTEST_EQUAL(Scores::middlegameScore(score), 0);
+		TTEST_EQUAL(Scores::endgameScore(score), 5);
+	}
+
 	TTEST_CASE("getCheckMateScore()")
 	{
 		TTEST_EQUAL(Scores::getCheckMateScore(1), MATE - 1);
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "../src/SearchBenchmark.h"
+#include "../src/NullLogger.h"
+#include "../ttest/ttest.h"
+#include <string>
+
+namespace mnc {
+
+class SearchBenchmarkTest : public ttest::TestBase
+{
+private:
+
+	TTEST_CASE("Node count is the same in every run.")
+	{
+		NullLogger logger;
+		SearchBenchmark benchmark(logger, 3);
+		TTEST_EQUAL(benchmark.size(), 40u);
+		SearchBenchmark::Result r1 = benchmark();
+		SearchBenchmark::Result r2 = SearchBenchmark(logger, 3)();
+		TTEST_EQUAL(r1.nodes > 0, true);
+		TTEST_EQUAL(r1.nodes, r2.nodes);
+	}
+};
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "../src/SkillTest.h"
+#include "../src/TimeConstraint.h"
+#include "../src/NullLogger.h"
+#include "../ttest/ttest.h"
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace mnc {
+
+class SkillTestTest : public ttest::TestBase
+{
+private:
+
+	TTEST_CASE("Runs positions from EPD lines in parallel.")
+	{
+		std::stringstream in;
+		in << "r5rk/5p1p/5R2/4B3/8/8/7P/7K w - - bm Ra6+; id \"mate\";\n"
+				<< "# comment\n\n"
+				<< "6r1/1k6/N1b5/2P4r/4n3/7R/7K/1N6 b - - am Nf2;\n"
+				<< "8/8/5p2/4r2k/5K1P/6QP/8/8 w - - bm Qg7;\r\n"
+				<< "8/8/8/8/8/k7/p7/K7 w - - 0 1\n";
+		SkillTest skillTest(in);
+		TTEST_EQUAL(skillTest.size(), 4u);
+
+		NullLogger logger;
+		SkillTest::Result result = skillTest.run(TimeConstraint(0u, 0.0, 20000), logger, 2, 1 << 20);
+		TTEST_EQUAL(result.total, 4u);
+		TTEST_EQUAL(result.solved, 2u);
+		TTEST_EQUAL(result.solveTimes.size(), 2u);
+		TTEST_EQUAL(result.solveNodes.size(), 2u);
+		for (uint64_t nodes : result.solveNodes)
+			TTEST_EQUAL(nodes > 0 && nodes <= 30000, true);
+	}
+
+	TTEST_CASE("Reports distributions.")
+	{
+		std::vector<double> values = {4, 1, 3, 2};
+		TTEST_EQUAL(SkillTest::distribution(values, "%.1f"),
+				"mean 2.5, 25% 1.0, 50% 2.0, 75% 3.0, 90% 4.0, max 4.0");
+		TTEST_EQUAL(SkillTest::distribution(std::vector<uint64_t>(), "%.0f"), "-");
+	}
+};
+
+}
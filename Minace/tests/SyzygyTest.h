@@ -0,0 +1,441 @@
+#pragma once
+
+#include "../src/Syzygy.h"
+#include "../src/SyzygyEncoding.h"
+#include "../src/Tablebase.h"
+#include "../src/TablebaseGenerator.h"
+#include "../src/MinMaxAI.h"
+#include "../src/GameState.h"
+#include "../src/NullLogger.h"
+#include "../ttest/ttest.h"
+#include <set>
+#include <map>
+#include <vector>
+#include <string>
+#include <memory>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+namespace mnc {
+
+class SyzygyTest : public ttest::TestBase
+{
+private:
+
+	/* Compressed values of one part of a file. */
+	struct Part
+	{
+		std::vector<uint8_t> header, spans, blockSizes, blocks;
+	};
+
+	static constexpr unsigned BLOCK_BITS = 6, SPAN_BITS = 5;
+
+	static constexpr int PAIR = 256;
+
+	std::shared_ptr<Tablebases> tablebases;
+
+	TTEST_BEFORE()
+	{
+		if (!tablebases) {
+			tablebases.reset(new Tablebases());
+			NullLogger logger;
+			TablebaseGenerator generator(logger, *tablebases, "", 1);
+			generator.generate("KQvK");
+			generator.generate("KRvK");
+		}
+	}
+
+	static void append(std::vector<uint8_t>& data, uint64_t value, unsigned bytes)
+	{
+		for (unsigned i = 0; i < bytes; ++i)
+			data.push_back(value >> 8 * i & 0xff);
+	}
+
+	/* Compresses the values like the Syzygy files, with a canonical Huffman code of the values and
+	 * of one pair of the most common value. */
+	static Part compress(const std::vector<int>& values, uint8_t flags)
+	{
+		Part part;
+		std::map<int, uint64_t> valueCounts;
+		for (int value : values)
+			++valueCounts[value];
+		if (valueCounts.size() == 1) {
+			part.header = {(uint8_t) (flags | 128), (uint8_t) values[0]};
+			return part;
+		}
+		int common = valueCounts.begin()->first;
+		for (const auto& vc : valueCounts) {
+			if (vc.second > valueCounts[common])
+				common = vc.first;
+		}
+
+		std::vector<int> tokens;
+		for (size_t i = 0; i < values.size(); ++i) {
+			bool pair = values[i] == common && i + 1 < values.size() && values[i + 1] == common;
+			tokens.push_back(pair ? int(PAIR) : values[i]);
+			i += pair;
+		}
+
+		// Code lengths from a Huffman tree.
+		std::map<int, uint64_t> counts;
+		for (int token : tokens)
+			++counts[token];
+		std::vector<std::pair<uint64_t, std::vector<int>>> nodes;
+		for (const auto& tc : counts)
+			nodes.push_back({tc.second, {tc.first}});
+		std::map<int, unsigned> lengths;
+		while (nodes.size() > 1) {
+			std::sort(nodes.begin(), nodes.end());
+			for (size_t i = 0; i < 2; ++i) {
+				for (int token : nodes[i].second)
+					++lengths[token];
+			}
+			nodes[1].first += nodes[0].first;
+			nodes[1].second.insert(nodes[1].second.end(), nodes[0].second.begin(),
+					nodes[0].second.end());
+			nodes.erase(nodes.begin());
+		}
+
+		// Symbols are numbered from the longest code, and the pair comes after the values of the
+		// same length.
+		std::vector<int> symbols;
+		for (const auto& tl : lengths)
+			symbols.push_back(tl.first);
+		std::stable_sort(symbols.begin(), symbols.end(), [&](int a, int b) {
+			return lengths[a] > lengths[b];
+		});
+		unsigned minLength = lengths[symbols.back()], maxLength = lengths[symbols[0]];
+		std::vector<unsigned> firstSymbol(maxLength + 2, 0);
+		for (unsigned length = minLength; length <= maxLength; ++length) {
+			for (int symbol : symbols)
+				firstSymbol[length] += lengths[symbol] > length;
+		}
+		std::vector<uint64_t> lowestCode(maxLength + 2, 0);
+		for (unsigned length = maxLength; length-- > minLength;)
+			lowestCode[length] = (lowestCode[length + 1] + firstSymbol[length]
+					- firstSymbol[length + 1]) / 2;
+		std::map<int, unsigned> ids;
+		for (size_t i = 0; i < symbols.size(); ++i)
+			ids[symbols[i]] = i;
+
+		// Blocks of codes, starting a new block when the next code doesn't fit.
+		const unsigned blockBytes = 1 << BLOCK_BITS;
+		std::vector<uint64_t> blockStarts;
+		unsigned bit = 8 * blockBytes, blockValues = 0;
+		uint64_t valueIdx = 0;
+		for (int token : tokens) {
+			unsigned length = lengths[token];
+			if (bit + length > 8 * blockBytes) {
+				if (!blockStarts.empty())
+					append(part.blockSizes, blockValues - 1, 2);
+				blockStarts.push_back(valueIdx);
+				part.blocks.resize(part.blocks.size() + blockBytes);
+				bit = 0;
+				blockValues = 0;
+			}
+			uint64_t code = lowestCode[length] + ids[token] - firstSymbol[length];
+			for (unsigned i = length; i-- > 0; ++bit) {
+				if (code >> i & 1)
+					part.blocks[part.blocks.size() - blockBytes + bit / 8] |= 0x80 >> bit % 8;
+			}
+			unsigned count = token == PAIR ? 2 : 1;
+			blockValues += count;
+			valueIdx += count;
+		}
+		append(part.blockSizes, blockValues - 1, 2);
+
+		// Block and offset of the middle value of each span.
+		for (uint64_t span = 0; span << SPAN_BITS < values.size(); ++span) {
+			uint64_t middle = (span << SPAN_BITS) + (1 << (SPAN_BITS - 1));
+			size_t block = std::upper_bound(blockStarts.begin(), blockStarts.end(), middle)
+					- blockStarts.begin() - 1;
+			append(part.spans, block, 4);
+			append(part.spans, middle - blockStarts[block], 2);
+		}
+
+		part.header = {flags, BLOCK_BITS, SPAN_BITS, 0};
+		append(part.header, blockStarts.size(), 4);
+		part.header.push_back(maxLength);
+		part.header.push_back(minLength);
+		for (unsigned length = minLength; length <= maxLength; ++length)
+			append(part.header, firstSymbol[length], 2);
+		append(part.header, symbols.size(), 2);
+		for (int symbol : symbols) {
+			unsigned first = symbol == PAIR ? ids[common] : symbol;
+			unsigned second = symbol == PAIR ? ids[common] : 0xfff;
+			append(part.header, first | second << 12, 3);
+		}
+		if (symbols.size() & 1)
+			part.header.push_back(0);
+		return part;
+	}
+
+	/* Writes a Syzygy file of a table with a white piece against the lone king. */
+	static void writeFile(const std::string& name, bool dtz, const int* pieces,
+			const std::vector<Part>& parts, const std::vector<uint8_t>& map)
+	{
+		std::vector<uint8_t> data;
+		append(data, dtz ? 0xa50c66d7 : 0x5d23e871, 4);
+		data.push_back(1);
+		data.push_back(0);
+		for (unsigned i = 0; i < 3; ++i)
+			data.push_back(pieces[i] | pieces[i] << 4);
+		data.resize(data.size() + (data.size() & 1));
+		for (const Part& part : parts)
+			data.insert(data.end(), part.header.begin(), part.header.end());
+		data.insert(data.end(), map.begin(), map.end());
+		data.resize(data.size() + (data.size() & 1));
+		for (const Part& part : parts)
+			data.insert(data.end(), part.spans.begin(), part.spans.end());
+		for (const Part& part : parts)
+			data.insert(data.end(), part.blockSizes.begin(), part.blockSizes.end());
+		for (const Part& part : parts) {
+			data.resize((data.size() + 63) / 64 * 64);
+			data.insert(data.end(), part.blocks.begin(), part.blocks.end());
+		}
+		data.resize((data.size() + 63) / 64 * 64 + 16);
+		std::ofstream ofs(name + (dtz ? ".rtbz" : ".rtbw"), std::ios::binary);
+		ofs.write((const char*) data.data(), data.size());
+	}
+
+	/* Writes the WDL (both sides to move) and DTZ files (white to move, in plies and mapped if
+	 * mapDtz) of a table with a white piece against the lone king, with the values of the DTM table.
+	 * Positions with the same index must have the same value. */
+	void writeTable(const std::string& name, bool mapDtz)
+	{
+		const Tablebase& tb = *tablebases->find(name);
+		int pieces[] = {6 - (int) tb.piece(2), 6, 14};
+		SyzygyEncoding encoding;
+		TTEST_EQUAL(encoding.init(pieces, 3, false, true, 0, 0, 15), true);
+		TTEST_EQUAL(encoding.size(), (uint64_t) SyzygyEncoding::THREE_PIECES_SIZE);
+		std::vector<int> wdl[Player::COUNT], dtz(encoding.size(), -1);
+		for (std::vector<int>& values : wdl)
+			values.assign(encoding.size(), -1);
+
+		bool consistent = true;
+		for (unsigned piece = 0; piece < Sqr::COUNT; ++piece) {
+			for (unsigned king = 0; king < Sqr::COUNT; ++king) {
+				for (unsigned otherKing = 0; otherKing < Sqr::COUNT; ++otherKing) {
+					Sqr sqrs[] = {Sqr(king), Sqr(otherKing), Sqr(piece)};
+					if (piece == king || piece == otherKing || king == otherKing)
+						continue;
+					int syzygySqrs[] = {(int) piece ^ 56, (int) king ^ 56, (int) otherKing ^ 56};
+					uint64_t idx = encoding.index(syzygySqrs), tbIdx = tb.index(sqrs);
+					if (tbIdx == tb.size())
+						continue; // Adjacent kings.
+					for (unsigned player = 0; player < Player::COUNT; ++player) {
+						uint8_t value = tb.value(Player(player), tbIdx);
+						if (value == Tablebase::INVALID)
+							continue;
+						int result = value == Tablebase::DRAW ? 2 : value < Tablebase::LOSS ? 4 : 0;
+						consistent &= wdl[player][idx] == -1 || wdl[player][idx] == result;
+						wdl[player][idx] = result;
+						if (player == Player::WHITE && result == 4)
+							dtz[idx] = 2 * value - 2;
+					}
+				}
+			}
+		}
+		TTEST_EQUAL(consistent, true);
+
+		// Values of invalid positions don't matter.
+		std::replace(wdl[Player::WHITE].begin(), wdl[Player::WHITE].end(), -1, 4);
+		std::replace(wdl[Player::BLACK].begin(), wdl[Player::BLACK].end(), -1, 0);
+		std::replace(dtz.begin(), dtz.end(), -1, 0);
+
+		std::vector<uint8_t> map;
+		if (mapDtz) {
+			std::set<int> distinct(dtz.begin(), dtz.end());
+			map.push_back(distinct.size());
+			map.insert(map.end(), distinct.begin(), distinct.end());
+			map.insert(map.end(), 3, 0);
+			for (int& value : dtz)
+				value = std::distance(distinct.begin(), distinct.find(value));
+		}
+		writeFile(name, false, pieces, {compress(wdl[Player::WHITE], 0),
+			compress(wdl[Player::BLACK], 0)}, {});
+		writeFile(name, true, pieces, {compress(dtz, mapDtz ? 4 | 2 : 4)}, map);
+	}
+
+	void writeTables()
+	{
+		writeTable("KQvK", false);
+		writeTable("KRvK", true);
+	}
+
+	static void removeTables()
+	{
+		for (const char* name : {"KQvK.rtbw", "KQvK.rtbz", "KRvK.rtbw", "KRvK.rtbz"})
+			std::remove(name);
+	}
+
+	static int wdl(const Syzygy& syzygy, const std::string& fen)
+	{
+		GameState state(fen);
+		int value = -100;
+		TTEST_EQUAL(syzygy.probeWdl(state, value), true);
+		return value;
+	}
+
+	static int dtz(const Syzygy& syzygy, const std::string& fen)
+	{
+		GameState state(fen);
+		int value = -1000;
+		TTEST_EQUAL(syzygy.probeDtz(state, value), true);
+		return value;
+	}
+
+	/* Number of KQvK and KRvK positions whose WDL and DTZ don't agree with the distance to mate
+	 * (DTZ is DTM without captures). DTZ may be one ply longer if inMoves, because files that store
+	 * it in moves are read as an even number of plies. */
+	size_t countErrors(const Syzygy& syzygy, bool inMoves)
+	{
+		size_t errors = 0;
+		for (const char* name : {"KQvK", "KRvK"}) {
+			const Tablebase& tb = *tablebases->find(name);
+			for (uint64_t idx = 0; idx < tb.size(); ++idx) {
+				Sqr sqrs[3];
+				tb.decode(idx, sqrs);
+				if (sqrs[0] == sqrs[1] || sqrs[0] == sqrs[2] || sqrs[1] == sqrs[2])
+					continue;
+				for (unsigned player = 0; player < Player::COUNT; ++player) {
+					uint8_t value = tb.value(Player(player), idx);
+					if (value == Tablebase::INVALID)
+						continue;
+					BitBoard board;
+					board.addPiece(Player::WHITE, Piece::KING, sqrs[0]);
+					board.addPiece(Player::BLACK, Piece::KING, sqrs[1]);
+					board.addPiece(Player::WHITE, tb.piece(2), sqrs[2]);
+					GameState state(board, Player(player));
+					int expectedWdl = value == Tablebase::DRAW ? Syzygy::DRAW
+							: value < Tablebase::LOSS ? Syzygy::WIN : Syzygy::LOSS;
+					int expectedDtz = value == Tablebase::DRAW ? 0 : value < Tablebase::LOSS
+							? 2 * value - 1 : value == Tablebase::LOSS ? -1 : -2 * (value - Tablebase::LOSS);
+					int w = 0, d = 0;
+					errors += !syzygy.probeWdl(state, w) || w != expectedWdl
+							|| !syzygy.probeDtz(state, d) || (d != expectedDtz && (!inMoves
+							|| d != expectedDtz + (expectedDtz > 0) - (expectedDtz < 0)));
+				}
+			}
+		}
+		return errors;
+	}
+
+	TTEST_CASE("Index tables match the table layout.")
+	{
+		std::set<int> codes;
+		for (int i = 0; i < 10; ++i) {
+			for (int sqr = 0; sqr < 64; ++sqr) {
+				if (SyzygySquares::KINGS[i][sqr] >= 0)
+					codes.insert(SyzygySquares::KINGS[i][sqr]);
+			}
+		}
+		TTEST_EQUAL(codes.size(), (size_t) SyzygyEncoding::KINGS_SIZE);
+		TTEST_EQUAL(*codes.rbegin(), 461);
+		TTEST_EQUAL(SyzygySquares::CHOOSE[3][10], (uint64_t) 120);
+		TTEST_EQUAL(SyzygySquares::PAWN_RANGE[1][0], (uint64_t) 6);
+		TTEST_EQUAL(SyzygySquares::PAWN_ORDER[8], 47);
+
+		// KRPvKR: positions mirrored left to right have the same index.
+		int pieces[] = {1, 6, 14, 4, 12};
+		SyzygyEncoding encoding;
+		TTEST_EQUAL(encoding.init(pieces, 5, true, true, 0, 1, 15), true);
+		TTEST_EQUAL(encoding.size(), (uint64_t) 6 * 63 * 62 * 61 * 60);
+		int sqrs[] = {8, 0, 63, 1, 2}, mirrored[] = {15, 7, 56, 6, 5};
+		TTEST_EQUAL(encoding.index(sqrs) < encoding.size(), true);
+		TTEST_EQUAL(encoding.index(mirrored), encoding.index(sqrs));
+	}
+
+	TTEST_CASE("Positions are not probed without tables.")
+	{
+		Syzygy syzygy("/nonexistent:");
+		TTEST_EQUAL(syzygy.size(), 0u);
+		TTEST_EQUAL(syzygy.maxPieces(), 0u);
+		GameState state("8/8/8/3k4/8/8/8/Q6K w - - 0 1");
+		int wdl;
+		TTEST_EQUAL(syzygy.probeWdl(state, wdl), false);
+		TTEST_EQUAL(syzygy.probeDtz(state, wdl), false);
+		std::vector<Move> moves;
+		std::vector<int> ranks;
+		state.getLegalMoves(moves);
+		TTEST_EQUAL(syzygy.rankRootMoves(state, moves, ranks), false);
+	}
+
+	TTEST_CASE("WDL and DTZ values are read from the files.")
+	{
+		writeTables();
+		Syzygy syzygy(".");
+		TTEST_EQUAL(syzygy.size(), 2u);
+		TTEST_EQUAL(syzygy.maxPieces(), 3u);
+
+		TTEST_EQUAL(wdl(syzygy, "7k/8/5K2/8/8/8/8/1Q6 w - - 0 1"), (int) Syzygy::WIN);
+		TTEST_EQUAL(dtz(syzygy, "7k/8/5K2/8/8/8/8/1Q6 w - - 0 1"), 3);
+		TTEST_EQUAL(dtz(syzygy, "7k/8/6K1/8/8/8/8/1Q6 w - - 0 1"), 1);
+		TTEST_EQUAL(wdl(syzygy, "1Q5k/8/6K1/8/8/8/8/8 b - - 0 1"), (int) Syzygy::LOSS);
+		TTEST_EQUAL(dtz(syzygy, "1Q5k/8/6K1/8/8/8/8/8 b - - 0 1"), -1);
+		TTEST_EQUAL(wdl(syzygy, "8/8/8/8/8/7K/1kQ5/8 b - - 0 1"), (int) Syzygy::DRAW);
+		TTEST_EQUAL(dtz(syzygy, "8/8/8/8/8/7K/1kQ5/8 b - - 0 1"), 0);
+		TTEST_EQUAL(wdl(syzygy, "1q6/8/8/8/8/5k2/8/7K b - - 0 1"), (int) Syzygy::WIN);
+		TTEST_EQUAL(dtz(syzygy, "1q6/8/8/8/8/5k2/8/7K b - - 0 1"), 3);
+		TTEST_EQUAL(dtz(syzygy, "k7/8/1K6/8/8/8/8/7R w - - 0 1"), 1);
+		TTEST_EQUAL(wdl(syzygy, "k7/8/1K6/8/8/8/8/7R b - - 0 1"), (int) Syzygy::LOSS);
+		TTEST_EQUAL(dtz(syzygy, "k7/8/1K6/8/8/8/8/7R b - - 0 1"), -2);
+
+		TTEST_EQUAL(countErrors(syzygy, false), 0u);
+		removeTables();
+	}
+
+	TTEST_CASE("Real tables agree with the generated tables.")
+	{
+		// KQvK and KRvK files from the Syzygy distribution can be put in tests/syzygy.
+		Syzygy syzygy("tests/syzygy");
+		if (syzygy.size() < 2)
+			return;
+
+		TTEST_EQUAL(wdl(syzygy, "7k/8/5K2/8/8/8/8/1Q6 w - - 0 1"), (int) Syzygy::WIN);
+		TTEST_EQUAL(wdl(syzygy, "1Q5k/8/6K1/8/8/8/8/8 b - - 0 1"), (int) Syzygy::LOSS);
+		TTEST_EQUAL(dtz(syzygy, "1Q5k/8/6K1/8/8/8/8/8 b - - 0 1"), -1);
+		TTEST_EQUAL(wdl(syzygy, "8/8/8/8/8/7K/1kQ5/8 b - - 0 1"), (int) Syzygy::DRAW);
+		TTEST_EQUAL(wdl(syzygy, "1q6/8/8/8/8/5k2/8/7K b - - 0 1"), (int) Syzygy::WIN);
+		TTEST_EQUAL(wdl(syzygy, "k7/8/1K6/8/8/8/8/7R b - - 0 1"), (int) Syzygy::LOSS);
+		TTEST_EQUAL(wdl(syzygy, "8/8/8/8/8/8/8/Rk5K b - - 0 1"), (int) Syzygy::DRAW);
+		TTEST_EQUAL(countErrors(syzygy, true), 0u);
+	}
+
+	TTEST_CASE("Search keeps the tablebase result.")
+	{
+		writeTables();
+		std::shared_ptr<const Syzygy> syzygy(new Syzygy("."));
+
+		// Root moves that mate fastest rank highest.
+		GameState state("7k/8/5K2/8/8/8/8/1Q6 w - - 0 1");
+		std::vector<Move> moves;
+		std::vector<int> ranks;
+		state.getLegalMoves(moves);
+		TTEST_EQUAL(syzygy->rankRootMoves(state, moves, ranks), true);
+		int bestRank = *std::max_element(ranks.begin(), ranks.end());
+		bool ranked = true;
+		for (size_t i = 0; i < moves.size(); ++i) {
+			state.makeMove(moves[i]);
+			int score = 0;
+			tablebases->probe(state, score);
+			state.undoMove(moves[i]);
+			ranked &= (ranks[i] == bestRank) == (score == Scores::getCheckMateScore(-1));
+		}
+		TTEST_EQUAL(ranked, true);
+
+		MinMaxAI ai;
+		ai.setSyzygy(syzygy);
+		Move move = ai.getMove(state, 2);
+		TTEST_EQUAL(ranks[std::find(moves.begin(), moves.end(), move) - moves.begin()], bestRank);
+
+		// Capturing the knight leads to a won table position.
+		ai.getMove(GameState("8/8/8/3k4/8/8/3n4/R3K3 w - - 0 1"), 2);
+		TTEST_EQUAL(ai.getScore(), (int) Scores::TABLEBASE_WIN);
+		removeTables();
+	}
+};
+
+}
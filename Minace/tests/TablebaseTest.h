@@ -0,0 +1,165 @@
+#pragma once
+
+#include "../src/Tablebase.h"
+#include "../src/TablebaseGenerator.h"
+#include "../src/MinMaxAI.h"
+#include "../src/GameState.h"
+#include "../src/Scores.h"
+#include "../src/NullLogger.h"
+#include "../ttest/ttest.h"
+#include <sstream>
+#include <memory>
+#include <algorithm>
+
+namespace mnc {
+
+class TablebaseTest : public ttest::TestBase
+{
+private:
+
+	std::shared_ptr<Tablebases> tablebases;
+
+	TTEST_BEFORE()
+	{
+		if (!tablebases) {
+			tablebases.reset(new Tablebases());
+			NullLogger logger;
+			TablebaseGenerator generator(logger, *tablebases, "", 1);
+			generator.generate("KQvK");
+			generator.generate("KRvK");
+			generator.generate("KPvK");
+		}
+	}
+
+	static unsigned longestMate(const Tablebase& tb)
+	{
+		unsigned moves = 0;
+		for (uint64_t i = 0; i < tb.size(); ++i) {
+			uint8_t value = tb.value(Player::WHITE, i);
+			if (value != Tablebase::INVALID && value < Tablebase::LOSS)
+				moves = std::max<unsigned>(moves, value);
+		}
+		return moves;
+	}
+
+	int probe(const std::string& fen)
+	{
+		int score = -1;
+		TTEST_EQUAL(tablebases->probe(GameState(fen), score), true);
+		return score;
+	}
+
+	TTEST_CASE("Table names are canonical.")
+	{
+		TTEST_EQUAL(Tablebase::names(3).size(), 5u);
+		TTEST_EQUAL(Tablebase::names(4).size(), 30u);
+		bool flip;
+		TTEST_EQUAL(Tablebase::canonicalName({Player::WHITE, Player::BLACK, Player::BLACK},
+				{Piece::KING, Piece::KING, Piece::QUEEN}, flip), "KQvK");
+		TTEST_EQUAL(flip, true);
+		TTEST_EQUAL(Tablebase::canonicalName({Player::WHITE, Player::BLACK, Player::WHITE,
+				Player::BLACK}, {Piece::KING, Piece::KING, Piece::KNIGHT, Piece::ROOK}, flip),
+				"KRvKN");
+		TTEST_EQUAL(flip, true);
+	}
+
+	TTEST_CASE("Symmetric positions have the same index.")
+	{
+		Tablebase tb("KRRvK");
+		Sqr a[] = {Sqr("b2"), Sqr("e5"), Sqr("a7"), Sqr("h3")};
+		Sqr b[] = {Sqr("g2"), Sqr("d5"), Sqr("h7"), Sqr("a3")}; // files mirrored
+		Sqr c[] = {Sqr("b7"), Sqr("e4"), Sqr("a2"), Sqr("h6")}; // ranks mirrored
+		Sqr d[] = {Sqr("b2"), Sqr("e5"), Sqr("h3"), Sqr("a7")}; // rooks swapped
+		Sqr e[] = {Sqr("b2"), Sqr("e5"), Sqr("g1"), Sqr("c8")}; // reflected along a1-h8
+		uint64_t idx = tb.index(a);
+		TTEST_EQUAL(tb.index(b), idx);
+		TTEST_EQUAL(tb.index(c), idx);
+		TTEST_EQUAL(tb.index(d), idx);
+		TTEST_EQUAL(tb.index(e), idx);
+		Sqr decoded[4];
+		tb.decode(idx, decoded);
+		TTEST_EQUAL(tb.index(decoded), idx);
+	}
+
+	TTEST_CASE("Indexes are compact and decode back.")
+	{
+		TTEST_EQUAL(Tablebase("KQvK").size(), 564u * 64);
+		TTEST_EQUAL(Tablebase("KPvK").size(), 1806u * 48);
+		TTEST_EQUAL(Tablebase("KRRvK").size(), 564u * 2016);
+		TTEST_EQUAL(Tablebase("KPPvKP").size(), 1806u * 1128 * 48);
+		// Without pawns, a position with the white king on the diagonal may have a smaller index.
+		Tablebase pawnless("KRRvK"), pawns("KPPvKP");
+		bool equal = true;
+		Sqr sqrs[Tablebase::MAX_PIECES];
+		for (uint64_t idx = 0; idx < pawnless.size(); idx += 97) {
+			pawnless.decode(idx, sqrs);
+			equal &= pawnless.index(sqrs) <= idx;
+		}
+		for (uint64_t idx = 0; idx < pawns.size(); idx += 97) {
+			pawns.decode(idx, sqrs);
+			equal &= pawns.index(sqrs) == idx;
+		}
+		TTEST_EQUAL(equal, true);
+		Sqr adjacent[] = {Sqr("b2"), Sqr("c3"), Sqr("a7")};
+		TTEST_EQUAL(Tablebase("KQvK").index(adjacent), Tablebase("KQvK").size());
+		Sqr firstRank[] = {Sqr("b2"), Sqr("e5"), Sqr("a1")};
+		TTEST_EQUAL(Tablebase("KPvK").index(firstRank), Tablebase("KPvK").size());
+	}
+
+	TTEST_CASE("Generated tables have correct distances to mate.")
+	{
+		TTEST_EQUAL(longestMate(*tablebases->find("KQvK")), 10u);
+		TTEST_EQUAL(longestMate(*tablebases->find("KRvK")), 16u);
+		TTEST_EQUAL(longestMate(*tablebases->find("KPvK")), 28u);
+		TTEST_EQUAL(probe("7k/8/6K1/8/8/8/Q7/8 w - - 0 1"), Scores::getCheckMateScore(1));
+		TTEST_EQUAL(probe("7k/8/5K2/8/8/8/8/1Q6 w - - 0 1"), Scores::getCheckMateScore(2));
+		TTEST_EQUAL(probe("7k/8/6K1/8/8/8/8/1Q6 b - - 0 1"), Scores::getCheckMateScore(-1));
+		TTEST_EQUAL(probe("8/8/8/8/8/1k6/7q/K7 w - - 0 1"), Scores::getCheckMateScore(-1));
+		TTEST_EQUAL(probe("k7/8/K7/P7/8/8/8/8 w - - 0 1"), (int) Scores::DRAW);
+		TTEST_EQUAL(probe("4k3/8/4K3/4P3/8/8/8/8 w - - 0 1") > Scores::CHECK_MATE_THRESHOLD, true);
+		TTEST_EQUAL(probe("4k3/4P3/4K3/8/8/8/8/8 b - - 0 1"), (int) Scores::DRAW);
+	}
+
+	TTEST_CASE("Tables are written and read back.")
+	{
+		const Tablebase& tb = *tablebases->find("KPvK");
+		std::stringstream ss;
+		tb.write(ss);
+		TTEST_EQUAL(ss.str().size() < Player::COUNT * tb.size(), true);
+		std::unique_ptr<Tablebase> read = Tablebase::read(ss);
+		TTEST_EQUAL(read->name(), "KPvK");
+		bool equal = true;
+		for (unsigned player = 0; player < Player::COUNT; ++player) {
+			for (uint64_t i = 0; i < tb.size(); ++i) {
+				uint8_t value = tb.value(Player(player), i);
+				equal &= value == Tablebase::INVALID || read->value(Player(player), i) == value;
+			}
+		}
+		TTEST_EQUAL(equal, true);
+	}
+
+	TTEST_CASE("Search uses tablebase scores.")
+	{
+		GameState s("8/8/8/3k4/8/8/8/R6K w - - 0 1");
+		MinMaxAI ai;
+		ai.setTablebases(tablebases);
+		ai.getMove(s, 3);
+		TTEST_EQUAL(ai.getScore(), probe("8/8/8/3k4/8/8/8/R6K w - - 0 1"));
+		TTEST_EQUAL(ai.getScore() > Scores::CHECK_MATE_THRESHOLD, true);
+
+		s = GameState("8/8/8/3k4/8/8/8/Q6K w - - 0 1");
+		ai.getMove(s, 3);
+		TTEST_EQUAL(ai.getScore() >= Scores::getCheckMateScore(10), true);
+	}
+
+	TTEST_CASE("Tablebase and search mate scores are in the same units.")
+	{
+		MinMaxAI ai;
+		ai.getMove(GameState("7k/8/5K2/8/8/8/8/1Q6 w - - 0 1"), 5);
+		TTEST_EQUAL(ai.getScore(), probe("7k/8/5K2/8/8/8/8/1Q6 w - - 0 1"));
+		ai.getMove(GameState("7k/8/6K1/8/8/8/8/1Q6 b - - 0 1"), 5);
+		TTEST_EQUAL(ai.getScore(), probe("7k/8/6K1/8/8/8/8/1Q6 b - - 0 1"));
+	}
+};
+
+}
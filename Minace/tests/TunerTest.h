@@ -0,0 +1,95 @@
+#pragma once
+
+#include "../src/Tuner.h"
+#include "../src/Evaluator.h"
+#include "../src/GameState.h"
+#include "../src/GameGenerator.h"
+#include "../src/NullLogger.h"
+#include "../ttest/ttest.h"
+#include <sstream>
+#include <cmath>
+
+namespace mnc {
+
+class TunerTest : public ttest::TestBase
+{
+private:
+
+	NullLogger logger;
+
+	TTEST_CASE("Game result is parsed from EPD and bracket formats.")
+	{
+		double result = -1;
+		TTEST_EQUAL(Tuner::parseResult("8/8/8/8/8/8/8/K1k5 w - - c9 \"1-0\";", result), true);
+		TTEST_EQUAL(result, 1.0);
+		TTEST_EQUAL(Tuner::parseResult("8/8/8/8/8/8/8/K1k5 w - - c9 \"1/2-1/2\";", result), true);
+		TTEST_EQUAL(result, 0.5);
+		TTEST_EQUAL(Tuner::parseResult("8/8/8/8/8/8/8/K1k5 b - - 0 1 [0.0]", result), true);
+		TTEST_EQUAL(result, 0.0);
+		TTEST_EQUAL(Tuner::parseResult("8/8/8/8/8/8/8/K1k5 b - - 0 1", result), false);
+	}
+
+	TTEST_CASE("Evaluation with initial parameters matches the evaluator.")
+	{
+		Tuner tuner(logger, 2);
+		const char* fens[] = {
+			"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+			"r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+			"8/5k2/3p4/1p1P4/1P6/4K3/8/8 b - - 0 1"
+		};
+		for (const char* fen : fens)
+			tuner.addPosition(GameState(fen), 0.5);
+		TTEST_EQUAL(tuner.set().size(), 3u);
+
+		for (size_t i = 0; i < 3; ++i) {
+			GameState state(fens[i]);
+			Evaluator evaluator(0);
+			evaluator.reset(state);
+			int score = evaluator.evaluateUncached(state);
+			if (state.activePlayer() == Player::BLACK)
+				score = -score;
+			TTEST_EQUAL(std::abs(tuner.evaluate(i) - score) < 1.0, true);
+		}
+	}
+
+	TTEST_CASE("Positions are resolved with quiescence search.")
+	{
+		Tuner tuner(logger, 1);
+		// White wins a queen with Rxa8 before the position is stored.
+		tuner.addPosition(GameState("q6k/8/8/8/8/8/8/R3K3 w - - 0 1"), 1.0);
+		TTEST_EQUAL(tuner.set().pieces[Piece::QUEEN][0], 0ull);
+		TTEST_EQUAL(tuner.set().whitePieces[0] & tuner.set().pieces[Piece::ROOK][0], 1ull);
+	}
+
+	TTEST_CASE("Tuning reduces error.")
+	{
+		Tuner tuner(logger, 2);
+		for (uint64_t seed = 0; seed < 200; ++seed) {
+			GameState state = GameGenerator::createGame(seed);
+			Evaluator evaluator(0);
+			evaluator.reset(state);
+			int score = evaluator.getScore();
+			if (state.activePlayer() == Player::BLACK)
+				score = -score;
+			tuner.addPosition(state, score > 100 ? 1.0 : score < -100 ? 0.0 : 0.5);
+		}
+		double error = tuner.error();
+		tuner.tune(20);
+		TTEST_EQUAL(tuner.error() < error, true);
+	}
+
+	TTEST_CASE("Initial parameters are written in Scores.h format.")
+	{
+		Tuner tuner(logger, 1);
+		std::stringstream ss;
+		tuner.write(ss);
+		std::string s = ss.str();
+		TTEST_EQUAL(s.find("\t\t// King\n\t\t{\n\t\t\t0, 2, 3, 4, 4, 3, 2, 0,\n") != std::string::npos,
+				true);
+		TTEST_EQUAL(s.find("\t\t\t4, 6, 3, 0, 0, 3, 6, 4\n\t\t},\n\t\t// Queen") != std::string::npos,
+				true);
+		TTEST_EQUAL(s.find("\t\t\t20, 20, 20, 20, 20, 20, 20, 20,\n") != std::string::npos, true);
+	}
+};
+
+}